@@ -8,12 +8,14 @@ https://opensource.org/licenses/MIT.
 
 #pragma once
 #include "endpoint_impl/common_funcs.h"
+#include "endpoint_impl/debug_funcs.h"
 #include "endpoint_impl/logbook_funcs.h"
 #include "endpoint_impl/map_or_query_funcs.h"
 #include "endpoint_impl/message_funcs.h"
 #include "endpoint_impl/object_and_component_funcs.h"
 #include "endpoint_impl/player_funcs.h"
 #include "endpoint_impl/multiplayer_funcs.h"
+#include "endpoint_impl/watch_funcs.h"
 
 class FFIInvoke;
 
@@ -27,6 +29,8 @@ public:
         RegisterObjectAndComponentFunctions(ffi_invoke);
         RegisterMapOrQueryFunctions(ffi_invoke);
         RegisterMultiplayerFunctions(ffi_invoke);
+        RegisterWatchFunctions(ffi_invoke);
+        RegisterDebugFunctions(ffi_invoke);
     }
 };
 
@@ -1,7 +1,18 @@
 #pragma once
 #include <subhook.h>
 
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
 #include "lua_scripts/json.h"
+#include "httpserver/WatchHub.h"
+#include "metrics/FlightRecorder.h"
+#include "metrics/FrameMonitor.h"
+#include "metrics/Metrics.h"
+#include "metrics/Trace.h"
 
 #define LUA_OK 0
 #define LUA_YIELD 1
@@ -54,6 +65,25 @@ _lua_gettop lua_gettop;
 
 std::atomic<const char*> toExecuteLuaString{};
 std::atomic<const char*> lua_result{};
+// time the game thread spent running the last script, stored before lua_result
+std::atomic<int64_t> lua_execute_ns{0};
+
+metrics::Gauge& lua_queue_depth = metrics::Registry::instance().gauge(
+    "x4_lua_queue_depth", "Requests waiting for or executing lua on the game thread");
+metrics::Histogram& lua_lock_wait = metrics::Registry::instance().histogram(
+    "x4_lua_lock_wait_seconds", "Time spent waiting for the lua execution lock");
+metrics::Histogram& lua_frame_wait = metrics::Registry::instance().histogram(
+    "x4_lua_frame_wait_seconds", "Time from handing lua to the game thread until its result");
+
+inline metrics::Counter& LuaErrors(std::string_view reason) {
+    return metrics::Registry::instance().counter("x4_lua_errors_total",
+        "Failed lua executions by reason", metrics::Labels({{"reason", reason}}));
+}
+metrics::Counter& lua_errors_lock_timeout = LuaErrors("lock_timeout");
+metrics::Counter& lua_errors_timeout = LuaErrors("timeout");
+metrics::Counter& lua_errors_no_state = LuaErrors("no_state");
+metrics::Counter& lua_errors_execute = LuaErrors("execute");
+metrics::Counter& lua_errors_load = LuaErrors("load");
 
 
 subhook::Hook LuaSetFieldHook;
@@ -88,22 +118,56 @@ void lua_close_hook(lua_State* L) {
     lua_close(L);
 }
 
+/**
+ * runs `code` on `L` and copies the resulting string into `result`.
+ * Only call from the game thread (see lua_getfield_hook).
+ */
+inline bool runLuaInGameThread(lua_State* L, const char* code, std::string& result) {
+    const auto top = lua_gettop(L);
+    bool ok = false;
+    if (luaL_loadstring(L, code) == LUA_OK) {
+        if (lua_pcall(L, 0, -1, 0) == LUA_OK) {
+            size_t len = 0;
+            const char* str = lua_tolstring(L, -1, &len);
+            if (str != nullptr) {
+                result.assign(str, len);
+                ok = true;
+            }
+        }
+    }
+    lua_settop(L, top);
+    return ok;
+}
+
 void lua_getfield_hook(lua_State* L, int idx, const char* k) {
     subhook::ScopedHookRemove remove(&LuaGetFieldHook);
     lua_getfield(L, idx, k);
     // "onUpdate" is called every frame; this makes sure we're in the correct game-thread
     if (L == ui_lua_state && std::string(k) == "onUpdate") {
+        trace::NameThread("game (onUpdate)");
+        auto& frames = metrics::FrameMonitor::instance();
+        frames.beginFrame();
+        // over the overhead target, hold back injected work for a few frames
+        const bool defer = frames.shouldDefer();
         // OutputDebugStringA(
         //     (std::string("lua_getfield_hook: ") + k + "  idx: " + std::to_string(idx) + "\n")
         //         .c_str());
 
-        const auto lua_str = toExecuteLuaString.load();
+        const auto lua_str = defer ? nullptr : toExecuteLuaString.load();
         if (lua_str != nullptr) {
+            const trace::Span span("lua.execute", "game");
+            const auto execute_start = std::chrono::steady_clock::now();
+            const auto store_execute_time = [ & ]() {
+                lua_execute_ns.store(
+                    std::chrono::nanoseconds(std::chrono::steady_clock::now() - execute_start)
+                        .count());
+            };
             const auto top = lua_gettop(L);
             if (luaL_loadstring(L, lua_str) == LUA_OK) {
                 // OutputDebugStringA("Calling lua_string from http: calling lua\n");
                 if (lua_pcall(L, 0, -1, 0) == LUA_OK) {
                     const char* result = lua_tolstring(L, -1, nullptr);
+                    store_execute_time();
 
                     if (result == nullptr) {
                         // OutputDebugStringA("Calling lua_string from http: storing
@@ -119,6 +183,8 @@ void lua_getfield_hook(lua_State* L, int idx, const char* k) {
                 else {
                     // OutputDebugStringA("Calling lua_string from http: storing res
                     // 3\n");
+                    lua_errors_execute.inc();
+                    store_execute_time();
                     lua_result.store("error executing lua");
                 }
                 auto newTop = lua_gettop(L);
@@ -130,16 +196,28 @@ void lua_getfield_hook(lua_State* L, int idx, const char* k) {
             else {
                 // OutputDebugStringA("Calling lua_string from http: storing res
                 // 4\n");
+                lua_errors_load.inc();
                 lua_result.store("error loading lua");
             }
             // OutputDebugStringA("Calling lua_string from http: resetting
             // lua_string\n");
             toExecuteLuaString.store(nullptr);
         }
+
+        if (const auto sample_script =
+                defer ? nullptr : WatchHub::instance().dueSampleScript()) {
+            const trace::Span span("watch.sample", "game");
+            std::string sample;
+            if (runLuaInGameThread(L, sample_script->c_str(), sample)) {
+                WatchHub::instance().publishSample(sample);
+            }
+        }
+        frames.endFrame();
     }
 }
 
 inline void loadLuaLib() {
+#ifdef _WIN32
     if (const auto lua_module = GetModuleHandle(L"lua51_64.dll")) {
         lua_setfield = (_lua_setfield)(GetProcAddress(lua_module, "lua_setfield"));
         lua_getfield = (_lua_getfield)(GetProcAddress(lua_module, "lua_getfield"));
@@ -165,6 +243,7 @@ inline void loadLuaLib() {
         LuaGetFieldHook.Install(GetProcAddress(lua_module, "lua_getfield"), &lua_getfield_hook,
             subhook::HookFlags::HookFlag64BitOffset);
     }
+#endif
 }
 
 inline std::string executeLua(
@@ -178,31 +257,58 @@ inline std::string executeLua(
     (std::string("queuing lua execution: locking lua_state_mtx; threadId: ") +
         threadIdStrStr.str() + "\n")
         .c_str();
-    if (!lua_state_mtx.try_lock_for(std::chrono::seconds(3))) {
-        throw std::exception("Error: Timeout acquiring lua execution lock");
+    const metrics::GaugeGuard queued(lua_queue_depth);
+    const auto ctx = metrics::RequestContext::current();
+    if (ctx != nullptr) {
+        ctx->noteLua(lua_code);
+    }
+    {
+        const trace::Span wait_span("lua.lock_wait", "lua");
+        const metrics::PhaseTimer lock_timer(metrics::Phase::LOCK_WAIT);
+        if (!lua_state_mtx.try_lock_for(std::chrono::seconds(3))) {
+            lua_errors_lock_timeout.inc();
+            throw std::runtime_error("Error: Timeout acquiring lua execution lock");
+        }
     }
     const std::lock_guard<std::timed_mutex> lock(lua_state_mtx, std::adopt_lock);
+    const auto locked = std::chrono::high_resolution_clock::now();
+    lua_lock_wait.observe(locked - start);
     if (ui_lua_state != nullptr) {
         // OutputDebugStringA("queuing lua execution: resetting lua result\n");
         lua_result.store(nullptr);
+        lua_execute_ns.store(0);
         std::string lua_str =
             include_json ? (GetJsonLua(encode_userdata) + "\n" + lua_code) : lua_code;
         // OutputDebugStringA("queuing lua execution: storing lua string\n");
+        const trace::Span wait_span("lua.frame_wait", "lua");
         toExecuteLuaString.store(lua_str.c_str());
         // OutputDebugStringA("queuing lua execution: loading lua string\n");
         auto res = lua_result.load();
         while (res == nullptr) {
-            Sleep(10);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
             if (std::chrono::duration_cast<std::chrono::milliseconds>(
                     std::chrono::high_resolution_clock::now() - start)
                     .count() > 3000) {
-                throw std::exception("Lua error: Timeout executing lua");
+                lua_errors_timeout.inc();
+                if (ctx != nullptr) {
+                    ctx->addPhase(metrics::Phase::FRAME_WAIT,
+                        std::chrono::high_resolution_clock::now() - locked);
+                }
+                throw std::runtime_error("Lua error: Timeout executing lua");
             }
             // // OutputDebugStringA("queuing lua execution: loading lua string in loop\n");
             res = lua_result.load();
         }
+        const auto handoff = std::chrono::high_resolution_clock::now() - locked;
+        lua_frame_wait.observe(handoff);
+        if (ctx != nullptr) {
+            const auto execute = std::chrono::nanoseconds(lua_execute_ns.load());
+            ctx->addPhase(metrics::Phase::EXECUTE, execute);
+            ctx->addPhase(metrics::Phase::FRAME_WAIT, handoff - execute);
+        }
         // OutputDebugStringA("queuing lua execution: returning\n");
         return res;
     }
-    throw std::exception("Lua error: Lua_State not loaded");
+    lua_errors_no_state.inc();
+    throw std::runtime_error("Lua error: Lua_State not loaded");
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ https://opensource.org/licenses/MIT.
 #pragma once
 
 #include "../httpserver/HttpServer.h"
+#include "../httpserver/TypedEndpoint.h"
 #include "../ffi/FFIInvoke.h"
 
 #include "../_lua_.h"
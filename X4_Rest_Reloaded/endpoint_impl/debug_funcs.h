@@ -0,0 +1,118 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+
+#include "../httpserver/HttpServer.h"
+#include "../ffi/FFIInvoke.h"
+
+#include "../metrics/FlightRecorder.h"
+#include "../metrics/FrameMonitor.h"
+#include "../metrics/Trace.h"
+
+#include <algorithm>
+#include <limits>
+
+constexpr uint32_t TRACE_MAX_SECONDS = 60;
+
+inline void RegisterDebugFunctions(INIT_PARAMS()) {
+    HttpServer::AddEndpoint({"/debug/trace", HttpServer::Method::GET,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            QueryParams params(req);
+            const auto seconds = params.optional<uint32_t>("seconds", 5);
+            if (seconds == 0 || seconds > TRACE_MAX_SECONDS) {
+                params.error("seconds",
+                    "seconds must be between 1 and " + std::to_string(TRACE_MAX_SECONDS));
+            }
+            if (!params.ok()) {
+                return params.reject(res);
+            }
+
+            const auto trace =
+                trace::Recorder::instance().capture(std::chrono::seconds(seconds));
+            res.set_header("Content-Disposition", "attachment; filename=\"x4-trace.json\"");
+            res.set_content(trace.dump(), "application/json");
+        },
+        "chrome trace json (chrome://tracing, ui.perfetto.dev)",
+        "query: seconds=<capture duration, default 5, max 60>"});
+
+    HttpServer::AddEndpoint({"/debug/slow", HttpServer::Method::GET,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            QueryParams params(req);
+            const auto min_ms = params.optional<uint32_t>("min_ms", 0);
+            const auto limit = params.optional<uint32_t>(
+                "limit", static_cast<uint32_t>(metrics::FlightRecorder::CAPACITY));
+            if (!params.ok()) {
+                return params.reject(res);
+            }
+            SET_CONTENT((metrics::FlightRecorder::instance().entries(
+                std::chrono::milliseconds(min_ms), limit)));
+        },
+        {{"thresholdMs", "number"}, {"recorded", "number"},
+            {"entries",
+                "[{startedAt, method, route, params, status, durationMs, phasesMs: {lock_wait, "
+                "frame_wait, execute, serialize, handler}, responseBytes, luaCalls, luaHash, "
+                "error}]"}},
+        "query: min_ms=<only entries at least this slow>&limit=<max entries, newest first>"});
+
+    HttpServer::AddEndpoint({"/debug/slow", HttpServer::Method::PUT,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            const auto body = nlohmann::json::parse(req.body, nullptr, false);
+            if (!body.is_object() || !body.contains("thresholdMs") ||
+                !body[ "thresholdMs" ].is_number_unsigned()) {
+                return BadRequest(res, "expected {\"thresholdMs\": <unsigned number>}");
+            }
+            const auto threshold = static_cast<uint32_t>(std::min<uint64_t>(
+                body[ "thresholdMs" ].get<uint64_t>(), std::numeric_limits<uint32_t>::max()));
+            metrics::FlightRecorder::instance().setThreshold(std::chrono::milliseconds(threshold));
+            SET_CONTENT(({{"thresholdMs", threshold}}));
+        },
+        {{"thresholdMs", "number"}}, {{"thresholdMs", "number"}}});
+
+    HttpServer::AddEndpoint({"/debug/frames", HttpServer::Method::GET,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            SET_CONTENT((metrics::FrameMonitor::instance().snapshot()));
+        },
+        {{"frames", "number"}, {"window", "number"}, {"fps", "number"},
+            {"overheadPercent", "number"}, {"frameIntervalMs", "{p50, p90, p99, max}"},
+            {"injectedWorkMs", "{p50, p90, p99, max}"},
+            {"throttle", "{enabled, targetPercent, maxDeferredFrames, deferredFrames}"}}});
+
+    HttpServer::AddEndpoint({"/debug/frames/throttle", HttpServer::Method::PUT,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            const auto body = nlohmann::json::parse(req.body, nullptr, false);
+            if (!body.is_object()) {
+                return BadRequest(res, "expected a json object");
+            }
+            auto& frames = metrics::FrameMonitor::instance();
+            auto config = frames.throttle();
+            if (body.contains("maxDeferredFrames") && !body[ "maxDeferredFrames" ].is_number_unsigned()) {
+                return BadRequest(res, "maxDeferredFrames must be an unsigned integer");
+            }
+            try {
+                config.enabled = body.value("enabled", config.enabled);
+                config.target_percent = body.value("targetPercent", config.target_percent);
+                if (body.contains("maxDeferredFrames")) {
+                    config.max_deferred_frames = static_cast<uint32_t>(
+                        std::min<uint64_t>(body[ "maxDeferredFrames" ].get<uint64_t>(),
+                            metrics::FrameMonitor::MAX_DEFERRED_FRAMES));
+                }
+            }
+            catch (const nlohmann::json::exception& e) {
+                return BadRequest(res, e.what());
+            }
+            if (config.target_percent <= 0 || config.target_percent >= 100) {
+                return BadRequest(res, "targetPercent must be between 0 and 100");
+            }
+            frames.setThrottle(config);
+            SET_CONTENT(({{"enabled", config.enabled}, {"targetPercent", config.target_percent},
+                {"maxDeferredFrames", config.max_deferred_frames}}));
+        },
+        {{"enabled", "boolean"}, {"targetPercent", "number"}, {"maxDeferredFrames", "number"}},
+        {{"enabled", "boolean"}, {"targetPercent", "number"}, {"maxDeferredFrames", "number"}}});
+}
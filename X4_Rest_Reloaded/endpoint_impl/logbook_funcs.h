@@ -14,6 +14,50 @@ https://opensource.org/licenses/MIT.
 #include "../ffi/ffi_enum_helper.h"
 
 #include "../_lua_.h"
+#include "../lua_scripts/projection_lua.h"
+#include "../httpserver/LongPoll.h"
+
+#include <cmath>
+#include <optional>
+#include <string_view>
+
+/**
+ * defines `logbookCursor()`: "<entry count>:<time of newest entry>".
+ * The logbook is trimmed at the front, so the count alone doesn't identify a position.
+ */
+inline std::string LogbookCursorLua(const std::string& category) {
+    return R"(
+local function logbookCursor()
+    local numEntries = GetNumLogbook(")" +
+           category + R"(")
+    local newestTime = 0
+    if numEntries > 0 then
+        local newest = GetLogbook(numEntries, 1, ")" +
+           category + R"(")
+        if newest[1] then
+            newestTime = newest[1].time
+        end
+    end
+    return numEntries, newestTime, string.format("%d:%.3f", numEntries, newestTime)
+end
+)";
+}
+
+/**
+ * parses "<count>:<time>" (the time is optional). Compared by value, not text, so
+ * "12:3" and "12:3.000" are the same cursor.
+ */
+inline bool ParseLogbookCursor(std::string_view cursor, size_t& count, double& time) {
+    // a lua string result may come back quoted
+    if (cursor.size() >= 2 && cursor.front() == '"' && cursor.back() == '"') {
+        cursor = cursor.substr(1, cursor.size() - 2);
+    }
+    const auto separator = cursor.find(':');
+    time = 0;
+    return query::Parse(cursor.substr(0, separator), count) &&
+           (separator == std::string_view::npos ||
+               query::Parse(cursor.substr(separator + 1), time));
+}
 
 inline void RegisterLogbookFunctions(INIT_PARAMS()) {
 
@@ -54,14 +98,101 @@ inline void RegisterLogbookFunctions(INIT_PARAMS()) {
                                        "'alerts', 'upkeep', 'tips'");
             }
 
-            size_t page = 1;
-
-            try {
-                page = std::stoul(req.get_param_value("page"));
+            FieldList fields;
+            if (!ParseFieldsParam(req, res, fields)) {
+                return;
             }
-            catch (...) {
-                // ignore
+
+            // delta mode: only entries added after the `since` cursor
+            QueryParams params(req);
+            if (params.has("since")) {
+                size_t since_count = 0;
+                double since_time = 0;
+                if (!ParseLogbookCursor(*params.find("since"), since_count, since_time)) {
+                    params.error("since", "since is invalid; expected <count>:<time>");
+                }
+                const auto wait = params.optional<uint32_t>("wait", 0);
+                const auto limit = params.optional<uint32_t>("limit", 500);
+                if (!params.ok()) {
+                    return params.reject(res);
+                }
+
+                if (ui_lua_state == nullptr) {
+                    SET_CONTENT(({}));
+                    return;
+                }
+
+                std::optional<LongPollSlot> slot;
+                if (wait > 0 && !slot.emplace()) {
+                    return TooManyWaiters(res);
+                }
+                if (wait > 0) {
+                    // every probe costs a frame; share one per interval between all pollers
+                    static WatermarkSet<std::string> watermarks(std::chrono::milliseconds(500));
+                    auto& watermark = watermarks[ category ];
+                    const auto probe = [ & ]() {
+                        return executeLua(LogbookCursorLua(category) +
+                                              "return select(3, logbookCursor())",
+                            false, false);
+                    };
+                    const auto moved = [ & ]() {
+                        size_t count = 0;
+                        double time = 0;
+                        // an unreadable probe (no game loaded) keeps waiting
+                        return ParseLogbookCursor(watermark.get(probe), count, time) &&
+                               (count != since_count || std::abs(time - since_time) >= 0.0015);
+                    };
+                    LongPoll(moved, std::chrono::milliseconds(wait), std::chrono::milliseconds(500));
+                }
+
+                const auto lua = GetProjectionLua(fields) + LogbookCursorLua(category) + R"(
+local category = ")" + category + R"("
+local sinceCount, sinceTime, limit = )" +
+                                 std::to_string(since_count) + ", " +
+                                 std::to_string(since_time) + ", " + std::to_string(limit) + R"(
+local numEntries, newestTime, cursor = logbookCursor()
+local first = nil -- index of the first entry after the cursor
+if sinceCount > 0 and sinceCount <= numEntries then
+    local probe = GetLogbook(sinceCount, 1, category)
+    if probe[1] and math.abs(probe[1].time - sinceTime) < 0.0015 then
+        first = sinceCount + 1
+    end
+end
+if first == nil then
+    -- cursor position got trimmed away (or is unknown): entries are in time order, so
+    -- binary search for the first one newer than the cursor's time
+    local lo, hi = 1, numEntries + 1
+    while lo < hi do
+        local mid = math.floor((lo + hi) / 2)
+        local entry = GetLogbook(mid, 1, category)[1]
+        if entry and entry.time <= sinceTime then
+            lo = mid + 1
+        else
+            hi = mid
+        end
+    end
+    first = lo
+end
+-- the oldest entries after the cursor; the cursor returned points at the last one sent,
+-- so whatever is past the limit comes with the next call
+local entries = {}
+local count = math.min(numEntries - first + 1, limit)
+if count > 0 then
+    entries = GetLogbook(first, count, category)
+end
+if #entries > 0 then
+    cursor = string.format("%d:%.3f", first + #entries - 1, entries[#entries].time)
+elseif first <= numEntries then
+    cursor = string.format("%d:%.3f", sinceCount, sinceTime)
+end
+return json.encode({entries = project(entries), cursor = cursor, more = first + #entries <= numEntries})
+)";
+                const auto result = executeLua(lua, true, true);
+                res.set_content(result, "application/json");
+                return;
             }
+
+            const auto page = HttpServer::ParseQueryParam<size_t>(req, "page", 1);
             //if (page <= 0) {
             //    page = 1;
             //}
@@ -71,13 +202,13 @@ inline void RegisterLogbookFunctions(INIT_PARAMS()) {
 
                 if (page == 0)
                 {
-                    std::string lua = R"(local logbook = {}
+                    std::string lua = GetProjectionLua(fields) + R"(local logbook = {}
 local numEntries = GetNumLogbook(")" + category +
                                       R"(")
 local queries = math.ceil(numEntries / 500)
 for i=0,queries do
-table.insert(logbook, GetLogbook(i*500+1, 500, ")" +
-                                      category + R"("))
+table.insert(logbook, project(GetLogbook(i*500+1, 500, ")" +
+                                      category + R"(")))
 end
 return json.encode(logbook))";
                     const auto result = executeLua(lua, true, true);
@@ -85,7 +216,7 @@ return json.encode(logbook))";
                     return;
                 }
 
-                std::string lua = R"(
+                std::string lua = GetProjectionLua(fields) + R"(
                     local numEntries = GetNumLogbook( ")" +
                                   category + R"(" )
                     local logbook = {}
@@ -102,8 +233,8 @@ return json.encode(logbook))";
                             startIndex = 1
                         end
                     end
-                    logbook = GetLogbook(startIndex, numQuery, ")" +
-                                  category + R"(")
+                    logbook = project(GetLogbook(startIndex, numQuery, ")" +
+                                  category + R"("))
                     return json.encode(logbook)
                 )";
 
@@ -7,12 +7,15 @@ https://opensource.org/licenses/MIT.
 */
 
 #include "../httpserver/HttpServer.h"
+#include "../httpserver/TypedEndpoint.h"
 #include "../ffi/FFIInvoke.h"
 
 #include "../ffi/ffi_enum_helper.h"
 
 #include "../ffi/json_converters.h"
 
+static const std::vector<std::string> sector_ship_fields = {
+    "id", "name", "sectorid", "owner", "shiptype"};
 
 inline void RegisterMapOrQueryFunctions(INIT_PARAMS()) {
     HttpServer::AddEndpoint(SIMPLE_GET_HANDLER(GetNumAllRaces));
@@ -35,11 +38,15 @@ inline void RegisterMapOrQueryFunctions(INIT_PARAMS()) {
 
     HttpServer::AddEndpoint({"/GetAllRaces", HttpServer::Method::GET,
         [ & ](const httplib::Request& req, httplib::Response& res) {
+            FieldProjection<X4FFI::RaceInfo> projection;
+            if (!ParseFieldsParam(req, res, projection)) {
+                return;
+            }
             const auto numRaces = invoke(GetNumAllRaces);
             std::vector<X4FFI::RaceInfo> result;
             result.resize(numRaces);
             const auto callResult = invoke(GetAllRaces, result.data(), result.size());
-            SET_CONTENT((result));
+            SET_CONTENT((projection.applyAll(result)));
         }});
 
     HttpServer::AddEndpoint({"/GetAllFactions", HttpServer::Method::GET,
@@ -121,10 +128,36 @@ inline void RegisterMapOrQueryFunctions(INIT_PARAMS()) {
 
     HttpServer::AddEndpoint({"/GetSectorShips", HttpServer::Method::GET,
         [ & ](const httplib::Request& req, httplib::Response& res) {
-            const X4FFI::UniverseID sectorId = HttpServer::ParseQueryParam(req, "sectorId", 0);
+            QueryParams params(req);
+            const auto sectorId = params.required<X4FFI::UniverseID>("sectorId");
+            if (!params.ok()) {
+                return params.reject(res);
+            }
             if (sectorId == 0) {
                 return BadRequest(res, "sectorId is invalid");
             }
+            FieldList fields;
+            if (!ParseFieldsParam(req, res, fields, sector_ship_fields)) {
+                return;
+            }
+            // sectorid is always queried for filtering; everything else only if requested
+            std::string lua_attribs = "\"sectorid\"";
+            std::string lua_entry = "";
+            if (fields.includes("id")) {
+                lua_entry += "entry[\"id\"] = ship\n";
+            }
+            if (fields.includes("sectorid")) {
+                lua_entry += "entry[\"sectorid\"] = data[1]\n";
+            }
+            int data_index = 2;
+            for (const auto attrib : {"name", "owner", "shiptype"}) {
+                if (fields.includes(attrib)) {
+                    lua_attribs += std::string(",\"") + attrib + "\"";
+                    lua_entry += std::string("entry[\"") + attrib + "\"] = data[" +
+                                 std::to_string(data_index++) + "]\n";
+                }
+            }
+
             const bool includeHidden = HttpServer::ParseQueryParam(req, "hidden", false);
             const auto numFactions = invoke(GetNumAllFactions, includeHidden);
             std::vector<char*> allFactions;
@@ -151,15 +184,12 @@ local shipIds = {)" + shipIdsString +
                                  R"(}
 
 for i, ship in ipairs(shipIds) do
-	local data = {GetComponentData(ship, "name","sectorid","owner","shiptype")}
-	if tostring(data[2]) == sectorId then 
-        table.insert(resultTable, {
-   		    ["id"] = ship,
-   		    ["name"] = data[1],
-      	    ["sectorid"] = data[2],
-      	    ["owner"] = data[3],
-      	    ["shiptype"] = data[4]
-       })
+	local data = {GetComponentData(ship, )" + lua_attribs +
+                                 R"()}
+	if tostring(data[1]) == sectorId then 
+        local entry = {}
+        )" + lua_entry + R"(
+        table.insert(resultTable, entry)
     end
 end
 
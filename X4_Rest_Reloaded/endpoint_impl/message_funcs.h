@@ -14,6 +14,7 @@ https://opensource.org/licenses/MIT.
 #include "../ffi/ffi_enum_helper.h"
 
 #include "../ffi/json_converters.h"
+#include "../httpserver/LongPoll.h"
 
 inline void RegisterMessageFunctions(INIT_PARAMS()) {
 
@@ -55,22 +56,128 @@ inline void RegisterMessageFunctions(INIT_PARAMS()) {
                  return BadRequest(res, "category is invalid; Valid categories: 'all', 'highprio', 'lowprio'");
              }
 
-             size_t from = 0;
-             size_t count = 0;
-
-             try {
-                 from = std::stoul(req.get_param_value("from"));
-             }
-             catch (...) {
-                 // ignore
-             }
-             try {
-                 count = std::stoul(req.get_param_value("count"));
+             FieldProjection<X4FFI::MessageInfo> projection;
+             if (!ParseFieldsParam(req, res, projection)) {
+                 return;
              }
-             catch (...) {
-                 // ignore
+
+             // delta mode: only messages newer than the `since` cursor, "<newest id>:<unread count>"
+             // (a bare id, the first form of the cursor, is still accepted)
+             QueryParams params(req);
+             if (params.has("since")) {
+                 const std::string_view since = *params.find("since");
+                 const auto separator = since.find(':');
+                 X4FFI::MessageID since_id = 0;
+                 std::optional<uint32_t> since_unread;
+                 if (!query::Parse(since.substr(0, separator), since_id)) {
+                     params.error("since", "since is invalid; expected <id>:<unread>");
+                 } else if (separator != std::string_view::npos) {
+                     uint32_t unread = 0;
+                     if (query::Parse(since.substr(separator + 1), unread)) {
+                         since_unread = unread;
+                     } else {
+                         params.error("since", "since is invalid; expected <id>:<unread>");
+                     }
+                 }
+                 const auto wait = params.optional<uint32_t>("wait", 0);
+                 if (!params.ok()) {
+                     return params.reject(res);
+                 }
+
+                 // total + unread count is a cheap high-water mark shared by all pollers
+                 static WatermarkSet<std::pair<uint32_t, uint32_t>> watermarks(std::chrono::milliseconds(100));
+                 auto& watermark = watermarks[ category ];
+                 const auto probe = [ & ]() {
+                     return std::make_pair(invoke(GetNumMessages, category.c_str(), false),
+                         invoke(GetNumMessages, category.c_str(), true));
+                 };
+
+                 std::vector<X4FFI::MessageInfo> newer;
+                 std::vector<X4FFI::MessageInfo> changed;
+                 X4FFI::MessageID cursor = since_id;
+                 uint32_t unread = 0;
+                 const auto collect = [ & ]() {
+                     newer.clear();
+                     changed.clear();
+                     cursor = since_id;
+                     unread = invoke(GetNumMessages, category.c_str(), true);
+                     const auto numMessages = invoke(GetNumMessages, category.c_str(), false);
+                     if (numMessages == 0) {
+                         return;
+                     }
+                     const auto read = [ & ](size_t from, size_t count) {
+                         std::vector<X4FFI::MessageInfo> chunk(count);
+                         chunk.resize(invoke(GetMessages, chunk.data(), chunk.size(), from, count,
+                             category.c_str()));
+                         return chunk;
+                     };
+
+                     // ids grow with age, so the new messages sit at one end of the list; walk
+                     // in from that end until reaching the cursor
+                     const auto front = read(0, 1);
+                     const auto back = read(numMessages - 1, 1);
+                     const bool newestFirst =
+                         front.empty() || back.empty() || front.front().id >= back.front().id;
+                     constexpr size_t CHUNK = 50;
+                     for (size_t done = 0; done < numMessages;) {
+                         const auto count = std::min(CHUNK, numMessages - done);
+                         const auto from = newestFirst ? done : numMessages - done - count;
+                         const auto chunk = read(from, count);
+                         bool reachedCursor = chunk.size() < count;
+                         for (const auto& m : chunk) {
+                             if (m.id > since_id) {
+                                 newer.push_back(m);
+                                 cursor = std::max(cursor, m.id);
+                             } else {
+                                 reachedCursor = true;
+                             }
+                         }
+                         if (reachedCursor) {
+                             break;
+                         }
+                         done += count;
+                     }
+                     std::sort(newer.begin(), newer.end(),
+                         [](const auto& a, const auto& b) { return a.id < b.id; });
+
+                     // messages only ever get marked read, so an unread count other than the
+                     // cursor's plus the new unread ones means older messages changed. Which
+                     // ones isn't tracked anywhere; send all older messages once so the
+                     // client can update their read state
+                     const auto newUnread = std::count_if(newer.begin(), newer.end(),
+                         [](const auto& m) { return !m.isread; });
+                     if (since_unread && unread != *since_unread + newUnread) {
+                         auto all = read(0, numMessages);
+                         std::copy_if(all.begin(), all.end(), std::back_inserter(changed),
+                             [ & ](const auto& m) { return m.id <= since_id; });
+                     }
+                 };
+
+                 // the baseline is taken before collecting so nothing arriving in between is
+                 // missed by the wait
+                 const auto baseline = watermark.get(probe);
+                 collect();
+                 if (newer.empty() && changed.empty() && wait > 0) {
+                     const LongPollSlot slot;
+                     if (!slot) {
+                         return TooManyWaiters(res);
+                     }
+                     if (LongPoll([ & ]() { return watermark.get(probe) != baseline; },
+                             std::chrono::milliseconds(wait), std::chrono::milliseconds(100))) {
+                         collect();
+                     }
+                 }
+
+                 SET_CONTENT(({{"messages", projection.applyAll(newer)},
+                     {"changed", projection.applyAll(changed)},
+                     {"cursor", std::to_string(cursor) + ":" + std::to_string(unread)}}));
+                 return;
              }
 
+             // paging parameters have always been lenient; malformed values mean "default"
+             auto from = HttpServer::ParseQueryParam<size_t>(req, "from", 0);
+             auto count = HttpServer::ParseQueryParam<size_t>(req, "count", 0);
+
 
              std::vector<X4FFI::MessageInfo> messages;
 
@@ -87,6 +194,6 @@ inline void RegisterMessageFunctions(INIT_PARAMS()) {
              messages.resize(count);
 
              const auto length = invoke(GetMessages, messages.data(), messages.size(), from, count, category.c_str());
-             SET_CONTENT(({{"length", length}, {"messages", messages}}));
+             SET_CONTENT(({{"length", length}, {"messages", projection.applyAll(messages)}}));
          }});
 }
@@ -645,6 +645,11 @@ inline void RegisterEnhancedMultiplayerFunctions(INIT_PARAMS()) {
         "/mp/sync/players", 
         HttpServer::Method::GET,
         [&ffi_invoke](const httplib::Request& req, httplib::Response& res) {
+            // Kept current by the client's WebSocket session, no request to the server
+            if (g_multiplayerClient && g_multiplayerClient->isSynced()) {
+                res.set_content(g_multiplayerClient->getSyncCache().players().dump(), "application/json");
+                return;
+            }
             nlohmann::json response = {
                 {"players", nlohmann::json::array()},
                 {"count", 0},
@@ -658,6 +663,18 @@ inline void RegisterEnhancedMultiplayerFunctions(INIT_PARAMS()) {
         "/mp/sync/universe", 
         HttpServer::Method::GET,
         [&ffi_invoke](const httplib::Request& req, httplib::Response& res) {
+            if (g_multiplayerClient && g_multiplayerClient->isSynced()) {
+                auto universe = g_multiplayerClient->getSyncCache().universe();
+                nlohmann::json response = {
+                    {"universeTime", universe["universeTime"]},
+                    {"activePlayers", universe["activePlayers"]},
+                    {"economyData", universe["globalEconomy"]},
+                    {"factionRelations", universe["factionRelations"]},
+                    {"lastUpdate", universe["lastUpdate"]}
+                };
+                res.set_content(response.dump(), "application/json");
+                return;
+            }
             nlohmann::json response = {
                 {"universeTime", 0},
                 {"activePlayers", 0},
@@ -702,6 +719,15 @@ inline void RegisterEnhancedMultiplayerFunctions(INIT_PARAMS()) {
         [&ffi_invoke](const httplib::Request& req, httplib::Response& res) {
             int limit = HttpServer::ParseQueryParam(req, "limit", 50);
             
+            if (g_multiplayerClient && g_multiplayerClient->isSynced() && limit >= 0) {
+                auto chat = g_multiplayerClient->getSyncCache().chat(static_cast<size_t>(limit));
+                nlohmann::json response = {
+                    {"messages", chat["messages"]},
+                    {"count", chat["count"]}
+                };
+                res.set_content(response.dump(), "application/json");
+                return;
+            }
             nlohmann::json response = {
                 {"messages", nlohmann::json::array()},
                 {"count", 0}
@@ -812,7 +838,8 @@ inline void RegisterEnhancedMultiplayerFunctions(INIT_PARAMS()) {
                 {"authRequired", true},
                 {"supportedEvents", nlohmann::json::array({
                     "player_join", "player_leave", "chat_message", 
-                    "economy_update", "server_message", "trade_offer"
+                    "economy_update", "server_message", "trade_offer",
+                    "player_state", "universe_update"
                 })}
             };
             res.set_content(response.dump(), "application/json");
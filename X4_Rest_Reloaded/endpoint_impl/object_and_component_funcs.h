@@ -9,6 +9,7 @@ https://opensource.org/licenses/MIT.
 #pragma once
 
 #include "../httpserver/HttpServer.h"
+#include "../httpserver/TypedEndpoint.h"
 #include "../ffi/FFIInvoke.h"
 
 #include "../_lua_.h"
@@ -28,12 +29,10 @@ inline void RegisterObjectAndComponentFunctions(INIT_PARAMS()) {
     HttpServer::AddEndpoint({"/IsComponentClass", HttpServer::Method::GET,
         [&](const httplib::Request& req, httplib::Response& res)
         {
-            uint64_t componentId;
-            try {
-                componentId = std::stoull(req.get_param_value("componentId"));
-            }
-            catch (...) {
-                return BadRequest(res, "componentId is invalid");
+            QueryParams params(req);
+            const auto componentId = params.required<uint64_t>("componentId");
+            if (!params.ok()) {
+                return params.reject(res);
             }
             if (componentId == 0) {
                 return BadRequest(res, "componentId is required");
@@ -59,12 +58,10 @@ inline void RegisterObjectAndComponentFunctions(INIT_PARAMS()) {
 
     HttpServer::AddEndpoint({"/GetComponentData", HttpServer::Method::GET,
         [](const httplib::Request& req, httplib::Response& res) {
-            uint64_t componentId;
-            try {
-                componentId = std::stoull(req.get_param_value("componentId"));
-            }
-            catch (...) {
-                return BadRequest(res, "componentId is invalid");
+            QueryParams params(req);
+            const auto componentId = params.required<uint64_t>("componentId");
+            if (!params.ok()) {
+                return params.reject(res);
             }
             if (componentId == 0)
             {
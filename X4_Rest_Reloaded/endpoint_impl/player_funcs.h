@@ -9,9 +9,11 @@ https://opensource.org/licenses/MIT.
 #pragma once
 
 #include "../httpserver/HttpServer.h"
+#include "../httpserver/TypedEndpoint.h"
 #include "../ffi/FFIInvoke.h"
 
 #include "../_lua_.h"
+#include "../lua_scripts/projection_lua.h"
 
 
 inline void RegisterPlayerFunctions(INIT_PARAMS()) {
@@ -56,12 +58,19 @@ inline void RegisterPlayerFunctions(INIT_PARAMS()) {
                 // ignore
             }
 
+            // fields are stat ids; unrequested stats are never queried
+            FieldList fields;
+            if (!ParseFieldsParam(req, res, fields)) {
+                return;
+            }
+
             if (ui_lua_state != nullptr) {
                 const auto get_stats_lua =
-                    R"(    
+                    GetProjectionLua(fields) + R"(    
 local statTable = {}
 local stats = GetAllStatIDs()
 for i = 1, #stats do
+  if projectedFields == nil or projectedFields[stats[i]] then
     local hidden, displayname = GetStatData(stats[i], "hidden", "displayname")
     if not hidden then
         statTable[stats[i]] = GetStatData(stats[i], "displayvalue")
@@ -69,6 +78,7 @@ for i = 1, #stats do
         )" + std::string{include_hidden ? "" : "-- "} +
                     R"(statTable["hidden:" .. stats[i]] = GetStatData(stats[i], "displayvalue")
     end
+  end
 end
 
 return json.encode(statTable)
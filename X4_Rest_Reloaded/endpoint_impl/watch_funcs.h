@@ -0,0 +1,205 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+
+#include "../httpserver/HttpServer.h"
+#include "../ffi/FFIInvoke.h"
+
+#include "../_lua_.h"
+#include "../httpserver/LongPoll.h"
+#include "../httpserver/WatchHub.h"
+#include "../lua_scripts/ComponentDataHelper.h"
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <ranges>
+
+// functions referenced by the sample expressions; prepended to every sample script
+static const std::string watch_lua_prelude = R"(
+local ffi = require("ffi")
+local C = ffi.C
+ffi.cdef[[
+    uint64_t GetPlayerID(void);
+    uint32_t GetNumMessages(const char* categoryname, bool unread);
+]]
+local function watchStats()
+    local statTable = {}
+    local stats = GetAllStatIDs()
+    for i = 1, #stats do
+        if not GetStatData(stats[i], "hidden") then
+            statTable[stats[i]] = GetStatData(stats[i], "displayvalue")
+        end
+    end
+    return statTable
+end
+)";
+
+static const std::map<std::string, std::string> watch_resources = {
+    {"money", "GetPlayerMoney()"},
+    {"sector", "tostring(GetComponentData(ConvertStringTo64Bit(tostring(C.GetPlayerID())), "
+               "\"sectorid\"))"},
+    {"messages",
+        "{total = C.GetNumMessages(\"all\", false), unread = C.GetNumMessages(\"all\", true)}"},
+    {"stats", "watchStats()"},
+};
+
+// every resource is sampled each SAMPLE_INTERVAL while watched; keep requests bounded
+constexpr size_t WATCH_MAX_RESOURCES = 32;
+
+/**
+ * resolves the `resources` query parameter into (name, lua expression) pairs.
+ * Accepts the names in watch_resources and `component:<id>:<attribute>`.
+ * Responds with 400 and returns false on invalid input.
+ */
+inline bool ParseWatchResources(const httplib::Request& req, httplib::Response& res,
+    std::vector<std::pair<std::string, std::string>>& resources) {
+    const auto param = req.get_param_value("resources");
+    if (param.empty()) {
+        BadRequest(res, "resources are required");
+        return false;
+    }
+
+    for (auto part : std::views::split(param, ',')) {
+        const auto name = std::string(part.begin(), part.end());
+        if (name.empty()) {
+            continue;
+        }
+        if (const auto it = watch_resources.find(name); it != watch_resources.end()) {
+            resources.emplace_back(name, it->second);
+            continue;
+        }
+
+        constexpr std::string_view component_prefix = "component:";
+        const auto separator = name.rfind(':');
+        if (name.starts_with(component_prefix) && separator > component_prefix.size()) {
+            const auto id = name.substr(
+                component_prefix.size(), separator - component_prefix.size());
+            const auto attribute = name.substr(separator + 1);
+            if (!std::ranges::all_of(id, [](char c) { return c >= '0' && c <= '9'; })) {
+                BadRequest(res, "resource \"" + name + "\" has an invalid component id");
+                return false;
+            }
+            if (!is_valid_component_data(attribute)) {
+                res.status = 400;
+                SET_CONTENT(({{"code", 400}, {"name", "Bad Request"},
+                    {"message", "attrib \"" + attribute + "\" is invalid"},
+                    {"valid_attributes", valid_component_data_attribs}}));
+                return false;
+            }
+            resources.emplace_back(name, "GetComponentData(" + id + ", \"" + attribute + "\")");
+            continue;
+        }
+
+        auto valid = nlohmann::json::array({"component:<id>:<attribute>"});
+        for (const auto& [ key, expression ] : watch_resources) {
+            valid.push_back(key);
+        }
+        res.status = 400;
+        SET_CONTENT(({{"code", 400}, {"name", "Bad Request"},
+            {"message", "resource \"" + name + "\" is invalid"}, {"valid_resources", valid}}));
+        return false;
+    }
+
+    if (resources.empty() || resources.size() > WATCH_MAX_RESOURCES) {
+        BadRequest(res, "between 1 and " + std::to_string(WATCH_MAX_RESOURCES) +
+                            " resources are required");
+        return false;
+    }
+    return true;
+}
+
+inline std::vector<std::string> AnnounceWatchResources(
+    const std::vector<std::pair<std::string, std::string>>& resources) {
+    std::vector<std::string> names;
+    for (const auto& [ name, expression ] : resources) {
+        WatchHub::instance().watch(name, expression);
+        names.push_back(name);
+    }
+    return names;
+}
+
+inline void RegisterWatchFunctions(INIT_PARAMS()) {
+    WatchHub::instance().setScriptPrelude(GetJsonLua(true) + watch_lua_prelude);
+
+    HttpServer::AddEndpoint({"/Watch", HttpServer::Method::GET,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            std::vector<std::pair<std::string, std::string>> resources;
+            if (!ParseWatchResources(req, res, resources)) {
+                return;
+            }
+
+            QueryParams params(req);
+            auto version = params.optional<uint64_t>("version", 0);
+            const auto wait = std::min(std::chrono::milliseconds(params.optional<uint32_t>(
+                                           "wait", LONG_POLL_MAX_WAIT.count())),
+                LONG_POLL_MAX_WAIT);
+            if (!params.ok()) {
+                return params.reject(res);
+            }
+            std::optional<LongPollSlot> slot;
+            if (wait.count() > 0 && !slot.emplace()) {
+                return TooManyWaiters(res);
+            }
+
+            nlohmann::json changes;
+            version = WatchHub::instance().waitForChanges(
+                AnnounceWatchResources(resources), version, wait, changes);
+            SET_CONTENT(({{"version", version}, {"changes", changes}}));
+        },
+        {{"version", "number"}, {"changes", "{[resource]: any}"}},
+        "query: resources=money,sector,messages,stats,component:<id>:<attribute>&version=<last "
+        "version, 0 for initial values>&wait=<ms>"});
+
+    HttpServer::AddEndpoint({"/WatchStream", HttpServer::Method::GET,
+        [ & ](const httplib::Request& req, httplib::Response& res) {
+            std::vector<std::pair<std::string, std::string>> resources;
+            if (!ParseWatchResources(req, res, resources)) {
+                return;
+            }
+
+            QueryParams params(req);
+            auto version = params.optional<uint64_t>("version", 0);
+            // EventSource resends the last seen id on reconnect
+            if (req.has_header("Last-Event-ID") &&
+                !query::Parse(req.get_header_value("Last-Event-ID"), version)) {
+                params.error("Last-Event-ID", "Last-Event-ID must be a version");
+            }
+            if (!params.ok()) {
+                return params.reject(res);
+            }
+            // held until httplib drops the provider, i.e. for as long as the stream is open
+            auto slot = std::make_shared<LongPollSlot>();
+            if (!*slot) {
+                return TooManyWaiters(res);
+            }
+
+            res.set_header("Cache-Control", "no-cache");
+            res.set_chunked_content_provider("text/event-stream",
+                [ resources = std::move(resources), version, slot ](
+                    size_t, httplib::DataSink& sink) mutable {
+                    // re-announcing keeps the resources alive for as long as the stream is
+                    nlohmann::json changes;
+                    version = WatchHub::instance().waitForChanges(
+                        AnnounceWatchResources(resources), version, std::chrono::seconds(15),
+                        changes);
+
+                    const auto event = changes.empty()
+                                           ? std::string(": keepalive\n\n")
+                                           : "id: " + std::to_string(version) + "\ndata: " +
+                                                 nlohmann::json{{"version", version},
+                                                     {"changes", changes}}
+                                                     .dump() +
+                                                 "\n\n";
+                    return sink.write(event.data(), event.size());
+                });
+        },
+        "text/event-stream of {version, changes}",
+        "query: resources=...&version=<last version>; same resources as /Watch"});
+}
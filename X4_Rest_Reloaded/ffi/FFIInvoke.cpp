@@ -13,7 +13,7 @@ FFIInvoke::FFIInvoke(const HMODULE x4_module) { x4_module_ = x4_module; }
 #include <dlfcn.h>
 #endif
 
-void FFIInvoke::loadFunction(const char* name)
+FFIInvoke::FunctionMap::iterator FFIInvoke::loadFunction(const char* name)
 {
 #ifdef _WIN32
     const auto addr = GetProcAddress(x4_module_, name);
@@ -27,5 +27,7 @@ void FFIInvoke::loadFunction(const char* name)
         throw std::exception(); // exception with message ctor is M$ extension
 #endif
     }
-    funcs_[name] = addr;
+    return funcs_
+        .insert_or_assign(name, LoadedFunction{reinterpret_cast<void*>(addr), FFICallMetrics(name)})
+        .first;
 }
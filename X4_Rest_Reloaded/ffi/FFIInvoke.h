@@ -14,6 +14,8 @@ https://opensource.org/licenses/MIT.
 #include <string>
 #include <unordered_map>
 
+#include "../metrics/Metrics.h"
+#include "../metrics/Trace.h"
 #include "x4ffi/ffi_funcs.h"
 
 #define Q(x) #x
@@ -23,6 +25,20 @@ https://opensource.org/licenses/MIT.
 
 #define invoke(FuncName, ...) ffi_invoke.invokeFn<X4FFI::FuncName>(QUOTE(FuncName), ##__VA_ARGS__)
 
+/**
+ * Call count and latency of a single FFI function
+ */
+struct FFICallMetrics {
+    explicit FFICallMetrics(const char* funcname)
+        : calls(&metrics::Registry::instance().counter("x4_ffi_calls_total",
+              "FFI calls into the game by function", metrics::Labels({{"function", funcname}}))),
+          duration(&metrics::Registry::instance().histogram("x4_ffi_call_duration_seconds",
+              "FFI call latency by function", metrics::Labels({{"function", funcname}}))) {}
+
+    metrics::Counter* calls;
+    metrics::Histogram* duration;
+};
+
 /**
  * Loads and invokes FFI functions from the game
  */
@@ -36,19 +52,41 @@ class FFIInvoke {
 
     template <typename Func, typename... Args> decltype(auto) invokeFn(const char* funcname, Args... args)
     {
-        if (!funcs_.contains(funcname)) {
-            loadFunction(funcname);
+        auto it = funcs_.find(funcname);
+        if (it == funcs_.end()) {
+            it = loadFunction(funcname);
         }
-        return reinterpret_cast<Func>(funcs_[funcname])(args...);
+        it->second.metrics.calls->inc();
+        const metrics::ScopedTimer timer(*it->second.metrics.duration);
+        const trace::Span span(it->first.c_str(), "ffi");
+        return reinterpret_cast<Func>(it->second.address)(args...);
     };
 
+    /**
+     * Resolves a FFI function once; callers cache the returned pointer
+     * instead of looking it up by name on every call.
+     */
+    template <typename Func> Func getFn(const char* funcname)
+    {
+        auto it = funcs_.find(funcname);
+        if (it == funcs_.end()) {
+            it = loadFunction(funcname);
+        }
+        return reinterpret_cast<Func>(it->second.address);
+    }
+
   private:
 #ifdef _WIN32
     HMODULE x4_module_;
 #endif
-    std::unordered_map<std::string, void*> funcs_; // map holding funcs by name
+    struct LoadedFunction {
+        void* address;
+        FFICallMetrics metrics;
+    };
+    using FunctionMap = std::unordered_map<std::string, LoadedFunction>;
+    FunctionMap funcs_; // map holding funcs by name
     /**
      * Actually loads a given FFI-function by name
      */
-    void loadFunction(const char* name);
+    FunctionMap::iterator loadFunction(const char* name);
 };
\ No newline at end of file
@@ -2,31 +2,51 @@
 #include <nlohmann/json.hpp>
 
 #include "x4ffi/ffi_typedef_struct.h"
+#include "json_projection.h"
 
 using json = nlohmann::json;
 
+template <> struct JsonFields<X4FFI::MessageInfo> {
+    using T = X4FFI::MessageInfo;
+    static inline const std::vector<JsonFieldDef<T>> fields = {
+        JSON_FIELD(T, id),
+        JSON_FIELD(T, time),
+        JSON_FIELD(T, category),
+        JSON_FIELD(T, title),
+        JSON_FIELD(T, text),
+        JSON_FIELD(T, source),
+        JSON_FIELD(T, sourcecomponent),
+        JSON_FIELD(T, interaction),
+        JSON_FIELD(T, interactioncomponent),
+        JSON_FIELD(T, interactiontext),
+        JSON_FIELD(T, interactionshorttext),
+        JSON_FIELD(T, cutscenekey),
+        JSON_FIELD(T, entityname),
+        JSON_FIELD(T, factionname),
+        JSON_FIELD(T, money),
+        JSON_FIELD(T, bonus),
+        JSON_FIELD(T, highlighted),
+        JSON_FIELD(T, isread),
+    };
+};
+
+template <> struct JsonFields<X4FFI::RaceInfo> {
+    using T = X4FFI::RaceInfo;
+    static inline const std::vector<JsonFieldDef<T>> fields = {
+        JSON_FIELD(T, id),
+        JSON_FIELD(T, name),
+        JSON_FIELD(T, shortname),
+        JSON_FIELD(T, description),
+        JSON_FIELD(T, icon),
+    };
+};
+
 namespace X4FFI {
     inline void to_json(json& j, const MessageInfo& m) {
-        j = nlohmann::json{
-            {"id", m.id},
-            {"time", m.time},
-            {"category", m.category},
-            {"title", m.title},
-            {"text", m.text},
-            {"source", m.source},
-            {"sourcecomponent", m.sourcecomponent},
-            {"interaction", m.interaction},
-            {"interactioncomponent", m.interactioncomponent},
-            {"interactiontext", m.interactiontext},
-            {"interactionshorttext", m.interactionshorttext},
-            {"cutscenekey", m.cutscenekey},
-            {"entityname", m.entityname},
-            {"factionname", m.factionname},
-            {"money", m.money},
-            {"bonus", m.bonus},
-            {"highlighted", m.highlighted},
-            {"isread", m.isread},
-        };
+        j = json::object();
+        for (const auto& field : JsonFields<MessageInfo>::fields) {
+            field.write(j, m);
+        }
     }
 
     inline void to_json(json& j, const UIPosRot& m) {
@@ -41,7 +61,9 @@ namespace X4FFI {
         };
     }
     inline void to_json(json& j, const RaceInfo& r) {
-        j = nlohmann::json{{"id", r.id}, {"name", r.name}, {"shortname", r.shortname},
-            {"description", r.description}, {"icon", r.icon}};
+        j = json::object();
+        for (const auto& field : JsonFields<RaceInfo>::fields) {
+            field.write(j, r);
+        }
     }
 }
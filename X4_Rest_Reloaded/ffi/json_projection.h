@@ -0,0 +1,162 @@
+#pragma once
+#include <nlohmann/json.hpp>
+
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Field projection for the `fields=` query parameter.
+ *
+ * Each serializable struct lists its fields once in a JsonFields<T> specialization; a
+ * projection resolves the requested names against that table a single time per request,
+ * so serializing N elements only touches the selected fields.
+ */
+
+template <typename T> struct JsonFieldDef {
+    const char* name;
+    void (*write)(nlohmann::json& j, const T& value);
+};
+
+#define JSON_FIELD(Type, field)                                                                \
+    JsonFieldDef<Type> {                                                                       \
+        #field, [](nlohmann::json& j, const Type& v) { j[ #field ] = v.field; }                 \
+    }
+
+// specialize with `static inline const std::vector<JsonFieldDef<T>> fields`
+template <typename T> struct JsonFields;
+
+/**
+ * Comma separated list of field names. Empty means "everything".
+ * Names are restricted to [A-Za-z0-9_] so they can be embedded into lua safely.
+ */
+class FieldList {
+public:
+    FieldList() = default;
+
+    static FieldList Parse(std::string_view csv) {
+        FieldList list;
+        while (!csv.empty()) {
+            const auto comma = csv.find(',');
+            const auto name = csv.substr(0, comma);
+            if (!name.empty()) {
+                list.names_.emplace_back(name);
+            }
+            if (comma == std::string_view::npos) {
+                break;
+            }
+            csv.remove_prefix(comma + 1);
+        }
+        return list;
+    }
+
+    bool all() const { return names_.empty(); }
+
+    bool includes(std::string_view name) const {
+        if (all()) {
+            return true;
+        }
+        for (const auto& n : names_) {
+            if (n == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<std::string>& names() const { return names_; }
+
+    /**
+     * returns the first name that is not a plain identifier, or "" if all are valid.
+     */
+    std::string firstMalformed() const {
+        for (const auto& n : names_) {
+            for (const auto c : n) {
+                if (!(std::isalnum(static_cast<unsigned char>(c)) || c == '_')) {
+                    return n;
+                }
+            }
+        }
+        return "";
+    }
+
+    /**
+     * lua table literal usable as a set, or "nil" if all fields are requested.
+     */
+    std::string toLuaSet() const {
+        if (all()) {
+            return "nil";
+        }
+        std::string set = "{";
+        for (const auto& n : names_) {
+            set += "[\"" + n + "\"]=true,";
+        }
+        set.back() = '}';
+        return set;
+    }
+
+private:
+    std::vector<std::string> names_;
+};
+
+template <typename T> class FieldProjection {
+public:
+    FieldProjection() {
+        for (const auto& def : JsonFields<T>::fields) {
+            selected_.push_back(&def);
+        }
+    }
+
+    /**
+     * resolves `list` against JsonFields<T>; `unknown` receives the first unresolvable name.
+     */
+    static bool Resolve(const FieldList& list, FieldProjection& out, std::string& unknown) {
+        if (list.all()) {
+            return true;
+        }
+        out.selected_.clear();
+        for (const auto& name : list.names()) {
+            const JsonFieldDef<T>* found = nullptr;
+            for (const auto& def : JsonFields<T>::fields) {
+                if (name == def.name) {
+                    found = &def;
+                    break;
+                }
+            }
+            if (found == nullptr) {
+                unknown = name;
+                return false;
+            }
+            out.selected_.push_back(found);
+        }
+        return true;
+    }
+
+    static nlohmann::json ValidFields() {
+        auto names = nlohmann::json::array();
+        for (const auto& def : JsonFields<T>::fields) {
+            names.push_back(def.name);
+        }
+        return names;
+    }
+
+    nlohmann::json apply(const T& value) const {
+        auto j = nlohmann::json::object();
+        for (const auto* def : selected_) {
+            def->write(j, value);
+        }
+        return j;
+    }
+
+    template <typename Container> nlohmann::json applyAll(const Container& values) const {
+        auto j = nlohmann::json::array();
+        for (const auto& v : values) {
+            j.push_back(apply(v));
+        }
+        return j;
+    }
+
+private:
+    std::vector<const JsonFieldDef<T>*> selected_;
+};
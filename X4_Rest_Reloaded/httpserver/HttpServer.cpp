@@ -7,6 +7,7 @@ https://opensource.org/licenses/MIT.
 */
 
 #include "HttpServer.h"
+#include "LongPoll.h"
 HttpServer::HttpServer(FFIInvoke& ffi_invoke) : ffi_invoke_(ffi_invoke) {}
 
 std::string HttpServer::ToString(Method m) {
@@ -24,6 +25,56 @@ std::string HttpServer::ToString(Method m) {
 
 void HttpServer::AddEndpoint(const Endpoint&& e) { endpoints_.push_back(e); }
 
+void HttpServer::dispatch(
+    const Route& route, const httplib::Request& req, httplib::Response& res) {
+    const auto& e = route.endpoint;
+    const trace::Span span(e.path.c_str(), "http");
+    metrics::RequestContext ctx;
+    const auto start = std::chrono::steady_clock::now();
+    res.status = 0;
+    res.content_length_ = 0;
+    try {
+        e.handler(req, res);
+    }
+    catch (std::exception& err) {
+        // spdlog::error("Exception in http handler: {}", err.what());
+        ctx.setError(err.what());
+        res.status = res.status == 0 ? 500 : res.status;
+        if (res.content_length_ == 0) {
+            res.set_content(
+                nlohmann::json{
+                    {"code", res.status},
+                    {"name", "HandlerError"},
+                    {"message", err.what()},
+                }
+                    .dump(),
+                "application/json");
+        }
+    }
+    catch (...) {
+        ctx.setError("Unknown Error");
+        res.status = 500;
+        res.set_content(
+            nlohmann::json{
+                {"code", res.status},
+                {"name", "Internal Server Error"},
+                {"message", "Unknown Error"},
+            }
+                .dump(),
+            "application/json");
+    }
+    if (res.status == 0) {
+        res.status = e.method == Method::POST ? 201 : 200;
+    }
+    route.metrics.record(res.status, std::chrono::steady_clock::now() - start);
+    metrics::FlightRecorder::instance().finish(
+        ctx, ToString(e.method), e.path, req.params, res.status, res.body.size());
+}
+
+bool HttpServer::IsLiteralPath(const std::string& path) {
+    return path.find_first_of("\\^$.|?*+()[]{}") == std::string::npos;
+}
+
 void HttpServer::run(int port) {
 
     server_.set_default_headers(httplib::Headers{{"Access-Control-Allow-Origin", "*"}});
@@ -40,6 +91,9 @@ void HttpServer::run(int port) {
             });
         }
 
+        content_json[ "endpoints" ].push_back(
+            nlohmann::json{{"path", "/metrics"}, {"method", "GET"},
+                {"response", "Prometheus text format"}});
         content_json[ "endpoints" ].push_back(
             nlohmann::json{{"path", "/stop"}, {"method", "POST"}});
 
@@ -63,44 +117,39 @@ void HttpServer::run(int port) {
                 }
             })();
 
+        const auto& route = *routes_.emplace_back(std::make_unique<Route>(
+            Route{e, metrics::RouteMetrics("x4", ToString(e.method), e.path)}));
+
         (server_.*fn)(
-            e.path, [ this, &e ](const httplib::Request& req, httplib::Response& res) {
-                res.status = 0;
-                res.content_length_ = 0;
-                try {
-                    e.handler(req, res);
-                }
-                catch (std::exception& err) {
-                    // spdlog::error("Exception in http handler: {}", err.what());
-                    res.status = res.status == 0 ? 500 : res.status;
-                    if (res.content_length_ == 0) {
-                        res.set_content(
-                            nlohmann::json{
-                                {"code", res.status},
-                                {"name", "HandlerError"},
-                                {"message", err.what()},
-                            }
-                                .dump(),
-                            "application/json");
-                    }
-                }
-                catch (...) {
-                    res.status = 500;
-                    res.set_content(
-                        nlohmann::json{
-                            {"code", res.status},
-                            {"name", "Internal Server Error"},
-                            {"message", "Unknown Error"},
-                        }
-                            .dump(),
-                        "application/json");
-                }
-                if (res.status == 0) {
-                    res.status = e.method == Method::POST ? 201 : 200;
-                }
+            e.path, [ &route ](const httplib::Request& req, httplib::Response& res) {
+                dispatch(route, req, res);
             });
+
+        if (e.method == Method::GET && IsLiteralPath(e.path)) {
+            get_routes_.emplace(e.path, &route);
+        }
     }
 
+    server_.Get("/metrics", [](const httplib::Request& req, httplib::Response& res) {
+        res.set_content(metrics::Registry::instance().render(), metrics::CONTENT_TYPE);
+    });
+
+    // httplib tries every registered regex in turn; with 100+ endpoints an exact lookup
+    // is considerably cheaper. Only GET: the pre-routing handler runs before httplib has
+    // read the request body, so POST/PUT/PATCH keep going through the regular router.
+    // Regex routes above stay registered as fallback (and for HEAD requests).
+    server_.set_pre_routing_handler(
+        [ this ](const httplib::Request& req, httplib::Response& res) {
+            if (req.method == "GET") {
+                const auto it = get_routes_.find(req.path);
+                if (it != get_routes_.end()) {
+                    dispatch(*it->second, req, res);
+                    return httplib::Server::HandlerResponse::Handled;
+                }
+            }
+            return httplib::Server::HandlerResponse::Unhandled;
+        });
+
     // --
 #ifdef _DEBUG
     server_.Post("/stop", [ & ](const httplib::Request& req, httplib::Response& res) {
@@ -108,7 +157,11 @@ void HttpServer::run(int port) {
         res.set_content(nlohmann::json{{"ejected", true}}.dump(), "application/json");
     });
 #endif
+    // long-polls and streams each hold a worker; they get their own share of the pool
+    server_.new_task_queue = [] {
+        return new httplib::ThreadPool(CPPHTTPLIB_THREAD_POOL_COUNT + LONG_POLL_MAX_WAITERS);
+    };
     // somehow got bad request every other request without an extra thread o.O
     // (The server_ already runs in it's own separate thread by default...
     std::thread([ & ]() { server_.listen("0.0.0.0", port); }).join();
-}
\ No newline at end of file
+}
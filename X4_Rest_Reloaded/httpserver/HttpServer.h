@@ -9,52 +9,96 @@ https://opensource.org/licenses/MIT.
 #pragma once
 #include <httplib.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-#define SET_CONTENT(content) res.set_content(nlohmann::json content.dump(), "application/json")
+#include "../ffi/json_projection.h"
+#include "../metrics/FlightRecorder.h"
+#include "../metrics/Metrics.h"
+#include "../metrics/Trace.h"
+#include "QueryParams.h"
+
+#define SET_CONTENT(content) SetJsonContent(res, nlohmann::json content)
 
 #define HAN_FN [ & ](const httplib::Request& req, httplib::Response& res)
 
-#define SIMPLE_GET_HANDLER(FuncName)                                                           \
-    {                                                                                          \
-        std::string("/") + QUOTE(FuncName), HttpServer::Method::GET, HAN_FN {                  \
-            const auto callResult = invoke(FuncName);                                          \
-            SET_CONTENT((callResult));                                                         \
-        }                                                                                      \
-    }
+/**
+ * dumps `content` as the response body; the time spent is reported as the serialize phase
+ */
+inline void SetJsonContent(httplib::Response& res, const nlohmann::json& content) {
+    const metrics::PhaseTimer timer(metrics::Phase::SERIALIZE);
+    res.set_content(content.dump(), "application/json");
+}
 
-#define INT_PARAM_GET_HANDLER(FuncName, paramName)                                             \
-    {                                                                                          \
-        std::string("/") + QUOTE(FuncName), HttpServer::Method::GET, HAN_FN {                  \
-            try {                                                                              \
-                const auto param = std::stoi(req.get_param_value(paramName));                  \
-                const auto callResult = invoke(FuncName, param);                               \
-                SET_CONTENT((callResult));                                                     \
-            }                                                                                  \
-            catch (...) {                                                                      \
-                return BadRequest(res, std::string(paramName) + " is invalid");                \
-            }                                                                                  \
-        }                                                                                      \
-    }
+inline void BadRequest(httplib::Response& res, std::string const& message) {
+    res.status = 400;
+    SET_CONTENT(({{"code", 400}, {"name", "Bad Request"}, {"message", message}}));
+}
+
+/**
+ * 503 for a request that would have to wait while all LongPollSlots are taken
+ */
+inline void TooManyWaiters(httplib::Response& res) {
+    res.status = 503;
+    res.set_header("Retry-After", "1");
+    SET_CONTENT(({{"code", 503}, {"name", "Service Unavailable"},
+        {"message", "too many requests waiting for changes; retry shortly"}}));
+}
 
-#define UINT64_PARAM_GET_HANDLER(FuncName, paramName)                                          \
-    {                                                                                          \
-        std::string("/") + QUOTE(FuncName), HttpServer::Method::GET, HAN_FN {                  \
-            try {                                                                              \
-                const uint64_t param = std::stoull(req.get_param_value(paramName));            \
-                const auto callResult = invoke(FuncName, param);                               \
-                SET_CONTENT((callResult));                                                     \
-            }                                                                                  \
-            catch (...) {                                                                      \
-                return BadRequest(res, std::string(paramName) + " is invalid");                \
-            }                                                                                  \
-        }                                                                                      \
+inline void InvalidField(httplib::Response& res, const std::string& field, const nlohmann::json& valid_fields) {
+    res.status = 400;
+    SET_CONTENT(({{"code", 400}, {"name", "Bad Request"},
+        {"message", "field \"" + field + "\" is invalid"},
+        {"valid_fields", valid_fields}}));
+}
+
+/**
+ * resolves the `fields` query parameter against JsonFields<T>.
+ * Responds with 400 and returns false if an unknown field was requested.
+ */
+template <typename T>
+inline bool ParseFieldsParam(
+    const httplib::Request& req, httplib::Response& res, FieldProjection<T>& projection) {
+    std::string unknown;
+    if (FieldProjection<T>::Resolve(
+            FieldList::Parse(req.get_param_value("fields")), projection, unknown)) {
+        return true;
     }
+    InvalidField(res, unknown, FieldProjection<T>::ValidFields());
+    return false;
+}
 
+/**
+ * `fields` query parameter for lua backed endpoints, where the valid names aren't known
+ * upfront. Only rejects names that aren't plain identifiers.
+ */
+inline bool ParseFieldsParam(
+    const httplib::Request& req, httplib::Response& res, FieldList& fields) {
+    fields = FieldList::Parse(req.get_param_value("fields"));
+    const auto malformed = fields.firstMalformed();
+    if (malformed.empty()) {
+        return true;
+    }
+    BadRequest(res, "field \"" + malformed + "\" is invalid");
+    return false;
+}
 
-inline void BadRequest(httplib::Response& res, std::string const& message) {
-    res.status = 400;
-    SET_CONTENT(({{"code", 400}, {"name", "Bad Request"}, {"message", message}}));
+/**
+ * `fields` query parameter for lua backed endpoints with a fixed set of names.
+ * Responds like the JsonFields<T> version if a name isn't one of `valid_fields`.
+ */
+inline bool ParseFieldsParam(const httplib::Request& req, httplib::Response& res, FieldList& fields,
+    const std::vector<std::string>& valid_fields) {
+    fields = FieldList::Parse(req.get_param_value("fields"));
+    for (const auto& field : fields.names()) {
+        if (std::find(valid_fields.begin(), valid_fields.end(), field) == valid_fields.end()) {
+            InvalidField(res, field, valid_fields);
+            return false;
+        }
+    }
+    return true;
 }
 
 class FFIInvoke;
@@ -83,57 +127,19 @@ public:
     };
 
     static void AddEndpoint(const Endpoint&& e);
+    /**
+     * value of query parameter `name`, or `defaultValue` if it is absent or malformed.
+     * Use QueryParams directly where malformed input should be reported.
+     */
     template <typename T>
-    static inline auto ParseQueryParam(const httplib::Request& req, const std::string& name, T defaultValue) -> T
-    {
-        T value = defaultValue;
-        try {
-            value = req.get_param_value(name);
-        }
-        catch (...) {
-            // ignore
-        }
-        return value;
-    }
-    template <>
     static inline auto ParseQueryParam(
-        const httplib::Request& req, const std::string& name, bool defaultValue) -> bool {
-        auto value = defaultValue;
-        try {
-            const auto value_str = req.get_param_value(name);
-            value = value_str == "true" || value_str == "1";
-        }
-        catch (...) {
-            // ignore
-        }
-        return value;
-    }
-    template <>
-    static inline auto ParseQueryParam(
-        const httplib::Request& req, const std::string& name, int defaultValue) -> int {
-        auto value = defaultValue;
-        try {
-            const auto value_str = req.get_param_value(name);
-            value = std::stoi(value_str);
-        }
-        catch (...) {
-            // ignore
-        }
-        return value;
-    }
-
-    template <>
-    static inline auto ParseQueryParam(const httplib::Request& req, const std::string& name,
-        unsigned long long defaultValue) -> unsigned long long {
-        auto value = defaultValue;
-        try {
-            const auto value_str = req.get_param_value(name);
-            value = std::stoll(value_str);
-        }
-        catch (...) {
-            // ignore
+        const httplib::Request& req, const std::string& name, T defaultValue) -> T {
+        const auto it = req.params.find(name);
+        if (it == req.params.end()) {
+            return defaultValue;
         }
-        return value;
+        T value = defaultValue;
+        return query::Parse(it->second, value) ? value : defaultValue;
     }
 
 
@@ -143,8 +149,26 @@ public:
     void run(int port);
 
 private:
+    struct Route {
+        const Endpoint& endpoint;
+        metrics::RouteMetrics metrics;
+    };
+
+    /**
+     * runs the handler of `route` and maps exceptions to json error responses.
+     */
+    static void dispatch(const Route& route, const httplib::Request& req, httplib::Response& res);
+
+    /**
+     * true if `path` contains no regex syntax and can be matched by plain string compare.
+     */
+    static bool IsLiteralPath(const std::string& path);
+
     httplib::Server server_;
     FFIInvoke& ffi_invoke_;
 
     static inline std::vector<Endpoint> endpoints_;
+    std::vector<std::unique_ptr<Route>> routes_;
+    // literal GET paths, looked up before httplib's regex router
+    std::unordered_map<std::string, const Route*> get_routes_;
 };
@@ -0,0 +1,123 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Caches the result of a "what's the newest entry" probe, so any number of concurrent
+ * long-pollers share a single probe per `maxAge` instead of each hitting the game.
+ */
+template <typename T> class Watermark {
+public:
+    explicit Watermark(std::chrono::milliseconds maxAge) : maxAge_(maxAge) {}
+
+    template <typename Probe> T get(Probe&& probe) {
+        const std::lock_guard<std::mutex> lock(mtx_);
+        const auto now = std::chrono::steady_clock::now();
+        if (!valid_ || now - probedAt_ >= maxAge_) {
+            value_ = probe();
+            probedAt_ = now;
+            valid_ = true;
+        }
+        return value_;
+    }
+
+private:
+    std::mutex mtx_;
+    std::chrono::milliseconds maxAge_;
+    std::chrono::steady_clock::time_point probedAt_;
+    T value_{};
+    bool valid_ = false;
+};
+
+/**
+ * One Watermark per key (e.g. message/logbook category), created on first use.
+ */
+template <typename T> class WatermarkSet {
+public:
+    explicit WatermarkSet(std::chrono::milliseconds maxAge) : maxAge_(maxAge) {}
+
+    Watermark<T>& operator[](const std::string& key) {
+        const std::lock_guard<std::mutex> lock(mtx_);
+        auto& mark = marks_[ key ];
+        if (!mark) {
+            mark = std::make_unique<Watermark<T>>(maxAge_);
+        }
+        return *mark;
+    }
+
+private:
+    std::mutex mtx_;
+    std::chrono::milliseconds maxAge_;
+    std::unordered_map<std::string, std::unique_ptr<Watermark<T>>> marks_;
+};
+
+// long-poll requests block a httplib worker thread; keep them bounded
+constexpr auto LONG_POLL_MAX_WAIT = std::chrono::milliseconds(25000);
+
+// requests blocked in a long-poll or stream at once, across all endpoints. The server's
+// pool gets this many workers on top of its regular ones, so waiters can't starve REST.
+constexpr size_t LONG_POLL_MAX_WAITERS = 16;
+
+/**
+ * One of the LONG_POLL_MAX_WAITERS slots, held for as long as a request blocks.
+ * False if all are taken; the request should then answer 503 instead of waiting.
+ */
+class LongPollSlot {
+public:
+    LongPollSlot() : held_(Active().fetch_add(1) < LONG_POLL_MAX_WAITERS) {
+        if (!held_) {
+            Active().fetch_sub(1);
+        }
+    }
+    ~LongPollSlot() {
+        if (held_) {
+            Active().fetch_sub(1);
+        }
+    }
+    LongPollSlot(const LongPollSlot&) = delete;
+    LongPollSlot& operator=(const LongPollSlot&) = delete;
+
+    explicit operator bool() const { return held_; }
+
+private:
+    static std::atomic<size_t>& Active() {
+        static std::atomic<size_t> active{0};
+        return active;
+    }
+
+    bool held_;
+};
+
+/**
+ * Blocks until `changed()` returns true or `timeout` elapsed, checking every `interval`.
+ */
+template <typename Pred>
+bool LongPoll(Pred&& changed, std::chrono::milliseconds timeout, std::chrono::milliseconds interval) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::min(timeout, LONG_POLL_MAX_WAIT);
+    while (true) {
+        if (changed()) {
+            return true;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            interval, deadline - now));
+    }
+}
@@ -0,0 +1,176 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace query {
+
+/**
+ * Parses `str` into `out` without throwing. Integers and floating point values go through
+ * std::from_chars and must consume the whole string; bools accept true/false/1/0.
+ */
+template <typename T> bool Parse(std::string_view str, T& out) {
+    if constexpr (std::is_same_v<T, bool>) {
+        if (str == "true" || str == "1") {
+            out = true;
+            return true;
+        }
+        if (str == "false" || str == "0") {
+            out = false;
+            return true;
+        }
+        return false;
+    }
+    else if constexpr (std::is_arithmetic_v<T>) {
+        T value{};
+        const auto [ end, ec ] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec != std::errc{} || end != str.data() + str.size()) {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+    else {
+        out = T(str);
+        return true;
+    }
+}
+
+template <typename T> constexpr const char* TypeName() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return "a boolean (true, false, 1, 0)";
+    }
+    else if constexpr (std::is_floating_point_v<T>) {
+        return "a number";
+    }
+    else if constexpr (std::is_unsigned_v<T>) {
+        return "a non-negative integer";
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        return "an integer";
+    }
+    else {
+        return "a string";
+    }
+}
+
+} // namespace query
+
+/**
+ * Typed, exception free binding of a request's query parameters.
+ *
+ * Every getter records a structured error instead of throwing; handlers bind everything
+ * they need and reject the request once:
+ *
+ *     QueryParams params(req);
+ *     const auto id = params.required<uint64_t>("componentId");
+ *     const auto count = params.optional<uint32_t>("count", 10);
+ *     if (!params.ok()) {
+ *         return params.reject(res);
+ *     }
+ */
+class QueryParams {
+public:
+    explicit QueryParams(const httplib::Request& req) : req_(req) {}
+
+    /**
+     * raw value, or nullptr if the parameter is absent.
+     */
+    const std::string* find(const char* name) const {
+        const auto it = req_.params.find(name);
+        return it == req_.params.end() ? nullptr : &it->second;
+    }
+
+    bool has(const char* name) const { return find(name) != nullptr; }
+
+    /**
+     * value of `name`, or `default_value` if absent. A malformed value is an error.
+     */
+    template <typename T> T optional(const char* name, T default_value) {
+        const auto* raw = find(name);
+        if (raw == nullptr) {
+            return default_value;
+        }
+        T value = default_value;
+        if (!query::Parse(*raw, value)) {
+            invalid<T>(name);
+            return default_value;
+        }
+        return value;
+    }
+
+    /**
+     * value of `name`; absent or malformed values are errors.
+     */
+    template <typename T> T required(const char* name) {
+        const auto* raw = find(name);
+        T value{};
+        if (raw == nullptr || raw->empty()) {
+            error(name, std::string(name) + " is required");
+        }
+        else if (!query::Parse(*raw, value)) {
+            invalid<T>(name);
+        }
+        return value;
+    }
+
+    /**
+     * value of `name` if present and well-formed; absence is not an error.
+     */
+    template <typename T> std::optional<T> get(const char* name) {
+        const auto* raw = find(name);
+        if (raw == nullptr) {
+            return std::nullopt;
+        }
+        T value{};
+        if (!query::Parse(*raw, value)) {
+            invalid<T>(name);
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    /**
+     * records a handler specific validation error.
+     */
+    void error(const char* name, std::string message) {
+        errors_.push_back({{"param", name}, {"message", std::move(message)}});
+    }
+
+    bool ok() const { return errors_.empty(); }
+
+    const nlohmann::json& errors() const { return errors_; }
+
+    /**
+     * 400 listing every parameter error.
+     */
+    void reject(httplib::Response& res) const {
+        const auto message = errors_.empty() ? nlohmann::json("") : errors_[ 0 ][ "message" ];
+        res.status = 400;
+        res.set_content(nlohmann::json{{"code", 400}, {"name", "Bad Request"},
+                            {"message", message}, {"errors", errors_}}
+                            .dump(),
+            "application/json");
+    }
+
+private:
+    template <typename T> void invalid(const char* name) {
+        error(name, std::string(name) + " must be " + query::TypeName<T>());
+    }
+
+    const httplib::Request& req_;
+    nlohmann::json errors_ = nlohmann::json::array();
+};
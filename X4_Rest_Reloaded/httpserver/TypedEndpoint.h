@@ -0,0 +1,133 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "../ffi/FFIInvoke.h"
+#include "HttpServer.h"
+#include "QueryParams.h"
+
+/**
+ * Declarative endpoints for FFI functions.
+ *
+ * The query parameters, their types and the response hint are all derived from the
+ * FFI function pointer type at compile time; the function itself is resolved once and
+ * then called directly, without the per-call name lookup of `invoke`.
+ */
+
+template <typename Func> struct FFISignature;
+
+template <typename R, typename... Args> struct FFISignature<R (*)(Args...)> {
+    using Result = R;
+    using Arguments = std::tuple<std::remove_cv_t<Args>...>;
+    static constexpr size_t arity = sizeof...(Args);
+};
+
+template <typename T> nlohmann::json TypeHint() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return "boolean";
+    }
+    else if constexpr (std::is_arithmetic_v<T>) {
+        return "number";
+    }
+    else if constexpr (std::is_same_v<T, const char*>) {
+        return "string";
+    }
+    else {
+        return "object";
+    }
+}
+
+template <typename T> nlohmann::json ResultToJson(const T& result) {
+    if constexpr (std::is_same_v<T, const char*>) {
+        // the game returns nullptr for unknown ids
+        return result == nullptr ? nlohmann::json(nullptr) : nlohmann::json(result);
+    }
+    else {
+        return result;
+    }
+}
+
+template <typename Func, size_t... I>
+auto BindFFIArguments(QueryParams& params,
+    const std::array<const char*, FFISignature<Func>::arity>& names, std::index_sequence<I...>) {
+    using Arguments = typename FFISignature<Func>::Arguments;
+    // braced init keeps the parameters (and their errors) in declaration order
+    return Arguments{params.required<std::tuple_element_t<I, Arguments>>(names[ I ])...};
+}
+
+/**
+ * GET /<funcname> calling `Func` with one query parameter per FFI argument:
+ *
+ *     HttpServer::AddEndpoint(FFIGetEndpoint<X4FFI::GetComponentName>(
+ *         ffi_invoke, "GetComponentName", "componentId"));
+ */
+template <typename Func, typename... Names>
+HttpServer::Endpoint FFIGetEndpoint(
+    FFIInvoke& ffi_invoke, const char* funcname, Names... param_names) {
+    using Signature = FFISignature<Func>;
+    static_assert(sizeof...(Names) == Signature::arity,
+        "FFIGetEndpoint needs exactly one query parameter name per FFI argument");
+    static_assert(!std::is_void_v<typename Signature::Result>, "GET endpoints need a result");
+
+    const std::array<const char*, Signature::arity> names{param_names...};
+    // std::function needs a copyable closure
+    const auto cached = std::make_shared<std::atomic<Func>>(nullptr);
+    const FFICallMetrics call_metrics(funcname);
+
+    nlohmann::json payload_hint = nullptr;
+    if constexpr (Signature::arity > 0) {
+        payload_hint = nlohmann::json::object();
+        [ & ]<size_t... I>(std::index_sequence<I...>) {
+            ((payload_hint[ names[ I ] ] =
+                     TypeHint<std::tuple_element_t<I, typename Signature::Arguments>>()),
+                ...);
+        }(std::make_index_sequence<Signature::arity>{});
+    }
+
+    return {std::string("/") + funcname, HttpServer::Method::GET,
+        [ &ffi_invoke, funcname, names, cached, call_metrics ](
+            const httplib::Request& req, httplib::Response& res) {
+            QueryParams params(req);
+            const auto arguments = BindFFIArguments<Func>(
+                params, names, std::make_index_sequence<Signature::arity>{});
+            if (!params.ok()) {
+                return params.reject(res);
+            }
+
+            auto fn = cached->load(std::memory_order_acquire);
+            if (fn == nullptr) {
+                fn = ffi_invoke.getFn<Func>(funcname);
+                cached->store(fn, std::memory_order_release);
+            }
+
+            call_metrics.calls->inc();
+            const auto result = [ & ]() {
+                const metrics::ScopedTimer timer(*call_metrics.duration);
+                const trace::Span span(funcname, "ffi");
+                return std::apply(fn, arguments);
+            }();
+            SetJsonContent(res, ResultToJson(result));
+        },
+        TypeHint<typename Signature::Result>(), payload_hint};
+}
+
+#define FFI_GET_HANDLER(FuncName, ...)                                                         \
+    FFIGetEndpoint<X4FFI::FuncName>(ffi_invoke, QUOTE(FuncName), ##__VA_ARGS__)
+
+#define SIMPLE_GET_HANDLER(FuncName) FFI_GET_HANDLER(FuncName)
+
+// parameter types come from the FFI signature; both names are kept for existing registrations
+#define INT_PARAM_GET_HANDLER(FuncName, paramName) FFI_GET_HANDLER(FuncName, paramName)
+#define UINT64_PARAM_GET_HANDLER(FuncName, paramName) FFI_GET_HANDLER(FuncName, paramName)
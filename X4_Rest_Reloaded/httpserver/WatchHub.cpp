@@ -0,0 +1,133 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "WatchHub.h"
+
+WatchHub& WatchHub::instance() {
+    static WatchHub hub;
+    return hub;
+}
+
+void WatchHub::setScriptPrelude(std::string prelude) {
+    const std::lock_guard<std::mutex> lock(mtx_);
+    prelude_ = std::move(prelude);
+    script_dirty_ = true;
+}
+
+void WatchHub::watch(const std::string& name, const std::string& lua_expression) {
+    const std::lock_guard<std::mutex> lock(mtx_);
+    auto& resource = resources_[ name ];
+    if (resource.lua_expression != lua_expression) {
+        resource.lua_expression = lua_expression;
+        script_dirty_ = true;
+    }
+    resource.last_interest = std::chrono::steady_clock::now();
+    active_.store(true);
+}
+
+uint64_t WatchHub::waitForChanges(const std::vector<std::string>& names, uint64_t since_version,
+    std::chrono::milliseconds timeout, nlohmann::json& changes) {
+    changes = nlohmann::json::object();
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    const auto collect = [ & ]() {
+        for (const auto& name : names) {
+            const auto it = resources_.find(name);
+            if (it != resources_.end() && it->second.version > since_version) {
+                changes[ name ] = it->second.value;
+            }
+        }
+        return !changes.empty();
+    };
+
+    changed_.wait_for(lock, timeout, collect);
+    // all watched resources at or below version_ have been handed out by now
+    return changes.empty() ? since_version : version_;
+}
+
+std::shared_ptr<const std::string> WatchHub::dueSampleScript() {
+    if (!active_.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_sample_time_ < SAMPLE_INTERVAL) {
+        return nullptr;
+    }
+    last_sample_time_ = now;
+
+    const std::lock_guard<std::mutex> lock(mtx_);
+    for (auto it = resources_.begin(); it != resources_.end();) {
+        if (now - it->second.last_interest > INTEREST_TIMEOUT) {
+            it = resources_.erase(it);
+            script_dirty_ = true;
+        }
+        else {
+            ++it;
+        }
+    }
+    if (resources_.empty()) {
+        active_.store(false);
+        script_ = nullptr;
+        return nullptr;
+    }
+    if (script_dirty_) {
+        rebuildScript();
+    }
+    return script_;
+}
+
+void WatchHub::rebuildScript() {
+    // every expression is isolated in its own pcall; a single failing resource
+    // (e.g. a destroyed component) must not take down the whole sample
+    std::string script = prelude_ + "\nlocal sample = {}\nlocal ok, value\n";
+    for (const auto& [ name, resource ] : resources_) {
+        script += "ok, value = pcall(function() return " + resource.lua_expression +
+                  " end)\nif ok then sample[" + nlohmann::json(name).dump() + "] = value end\n";
+    }
+    script += "return json.encode(sample)";
+    script_ = std::make_shared<const std::string>(std::move(script));
+    script_dirty_ = false;
+    // values of a new script may differ in shape; force a full diff
+    last_sample_.clear();
+}
+
+void WatchHub::publishSample(const std::string& sample_json) {
+    // nothing moved since the last frame we sampled; skip parsing entirely
+    if (sample_json == last_sample_) {
+        return;
+    }
+    last_sample_ = sample_json;
+
+    nlohmann::json sample;
+    try {
+        sample = nlohmann::json::parse(sample_json);
+    }
+    catch (...) {
+        return;
+    }
+    if (!sample.is_object()) {
+        return;
+    }
+
+    bool any_changed = false;
+    {
+        const std::lock_guard<std::mutex> lock(mtx_);
+        for (auto& [ name, resource ] : resources_) {
+            const auto it = sample.find(name);
+            const auto& value = it == sample.end() ? nlohmann::json(nullptr) : *it;
+            if (resource.version == 0 || resource.value != value) {
+                resource.value = value;
+                resource.version = ++version_;
+                any_changed = true;
+            }
+        }
+    }
+    if (any_changed) {
+        changed_.notify_all();
+    }
+}
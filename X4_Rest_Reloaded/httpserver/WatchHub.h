@@ -0,0 +1,92 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Subscription hub for watched game values.
+ *
+ * Clients register interest in resources (each backed by a lua expression). The game thread
+ * samples all of them in a single lua call every SAMPLE_INTERVAL, diffs against the previous
+ * sample and wakes waiting clients only for resources that actually changed.
+ * One sampling pass serves any number of watchers.
+ */
+class WatchHub {
+public:
+    static WatchHub& instance();
+
+    /**
+     * lua code executed before the sample expressions (json lib, ffi.cdefs, ...)
+     */
+    void setScriptPrelude(std::string prelude);
+
+    /**
+     * registers / refreshes interest in `name`. Resources nobody asked for within
+     * INTEREST_TIMEOUT are no longer sampled.
+     */
+    void watch(const std::string& name, const std::string& lua_expression);
+
+    /**
+     * blocks until any of `names` has a version newer than `since_version` or `timeout`
+     * elapsed. Fills `changes` with {name: value} of changed resources.
+     * @return the version to pass as `since_version` next time
+     */
+    uint64_t waitForChanges(const std::vector<std::string>& names, uint64_t since_version,
+        std::chrono::milliseconds timeout, nlohmann::json& changes);
+
+    // --- game thread ---
+
+    /**
+     * returns the lua script to run if a sample is due, nullptr otherwise.
+     * cheap when nobody watches anything.
+     */
+    std::shared_ptr<const std::string> dueSampleScript();
+
+    /**
+     * feeds the json result of the sample script back.
+     */
+    void publishSample(const std::string& sample_json);
+
+    static constexpr auto SAMPLE_INTERVAL = std::chrono::milliseconds(250);
+    static constexpr auto INTEREST_TIMEOUT = std::chrono::seconds(30);
+
+private:
+    WatchHub() = default;
+
+    struct Resource {
+        std::string lua_expression;
+        nlohmann::json value = nullptr;
+        uint64_t version = 0;
+        std::chrono::steady_clock::time_point last_interest;
+    };
+
+    void rebuildScript();
+
+    std::mutex mtx_;
+    std::condition_variable changed_;
+    std::map<std::string, Resource> resources_;
+    uint64_t version_ = 0;
+
+    std::string prelude_;
+    std::shared_ptr<const std::string> script_;
+    bool script_dirty_ = false;
+    std::string last_sample_;
+
+    std::atomic<bool> active_{false};
+    std::chrono::steady_clock::time_point last_sample_time_;
+};
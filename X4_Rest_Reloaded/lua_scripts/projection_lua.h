@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+#include "../ffi/json_projection.h"
+
+/**
+ * defines `project(list)` which copies only the requested keys of every entry,
+ * so unrequested fields never reach json.encode.
+ */
+inline std::string GetProjectionLua(const FieldList& fields) {
+    return R"(
+local projectedFields = )" +
+           fields.toLuaSet() + R"(
+local function project(list)
+    if projectedFields == nil then
+        return list
+    end
+    local result = {}
+    for i, entry in ipairs(list) do
+        local projected = {}
+        for k in pairs(projectedFields) do
+            projected[k] = entry[k]
+        end
+        result[i] = projected
+    end
+    return result
+end
+)";
+}
@@ -0,0 +1,116 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "FlightRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace metrics {
+
+namespace {
+
+thread_local RequestContext* current_context = nullptr;
+
+constexpr std::array<const char*, static_cast<size_t>(Phase::COUNT)> phase_names = {
+    "lock_wait", "frame_wait", "execute", "serialize"};
+
+double Milliseconds(std::chrono::nanoseconds ns) {
+    return std::chrono::duration<double, std::milli>(ns).count();
+}
+
+} // namespace
+
+RequestContext::RequestContext()
+    : start_(std::chrono::steady_clock::now()), started_at_(std::chrono::system_clock::now()),
+      previous_(current_context) {
+    current_context = this;
+}
+
+RequestContext::~RequestContext() { current_context = previous_; }
+
+RequestContext* RequestContext::current() { return current_context; }
+
+void RequestContext::noteLua(std::string_view script) {
+    lua_hash_ = Fnv1a(script);
+    lua_calls_++;
+}
+
+FlightRecorder& FlightRecorder::instance() {
+    static FlightRecorder recorder;
+    return recorder;
+}
+
+void FlightRecorder::finish(const RequestContext& ctx, std::string_view method,
+    std::string_view route, const std::multimap<std::string, std::string>& params, int status,
+    size_t response_bytes) {
+    const auto total = ctx.elapsed();
+    if (total < threshold() && status < 500 && ctx.error_.empty()) {
+        return;
+    }
+
+    auto phases = nlohmann::json::object();
+    auto accounted = std::chrono::nanoseconds(0);
+    for (size_t i = 0; i < phase_names.size(); i++) {
+        phases[ phase_names[ i ] ] = Milliseconds(ctx.phases_[ i ]);
+        accounted += ctx.phases_[ i ];
+    }
+    phases[ "handler" ] = Milliseconds(std::max(total - accounted, std::chrono::nanoseconds(0)));
+
+    auto query = nlohmann::json::object();
+    for (const auto& [ key, value ] : params) {
+        query[ key ] = value;
+    }
+
+    nlohmann::json entry = {
+        {"startedAt", std::chrono::duration_cast<std::chrono::milliseconds>(
+                          ctx.started_at_.time_since_epoch())
+                          .count()},
+        {"method", method},
+        {"route", route},
+        {"params", std::move(query)},
+        {"status", status},
+        {"durationMs", Milliseconds(total)},
+        {"phasesMs", std::move(phases)},
+        {"responseBytes", response_bytes},
+        {"luaCalls", ctx.lua_calls_},
+        {"luaHash", nullptr},
+        {"error", ctx.error_.empty() ? nlohmann::json(nullptr) : nlohmann::json(ctx.error_)},
+    };
+    if (ctx.lua_calls_ > 0) {
+        char hash[ 17 ];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(ctx.lua_hash_));
+        entry[ "luaHash" ] = hash;
+    }
+
+    const std::lock_guard<std::mutex> lock(mtx_);
+    entries_.push_back(std::move(entry));
+    if (entries_.size() > CAPACITY) {
+        entries_.pop_front();
+    }
+    recorded_++;
+}
+
+nlohmann::json FlightRecorder::entries(std::chrono::milliseconds min_duration, size_t limit) const {
+    const auto min_ms = static_cast<double>(min_duration.count());
+    auto result = nlohmann::json::array();
+
+    const std::lock_guard<std::mutex> lock(mtx_);
+    for (auto it = entries_.rbegin(); it != entries_.rend() && result.size() < limit; ++it) {
+        if ((*it)[ "durationMs" ].get<double>() >= min_ms) {
+            result.push_back(*it);
+        }
+    }
+    return {
+        {"thresholdMs", threshold().count()},
+        {"recorded", recorded_},
+        {"entries", std::move(result)},
+    };
+}
+
+} // namespace metrics
@@ -0,0 +1,147 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Always-on recorder of slow and failed requests.
+ *
+ * Every request gets a RequestContext on the stack of its handler thread; the lua bridge
+ * and the json serialization add their timings to it. Only requests slower than the
+ * threshold (or failed ones) are copied into the bounded ring, so the steady state cost
+ * is a few clock reads per request.
+ */
+namespace metrics {
+
+enum class Phase {
+    LOCK_WAIT,  // waiting for lua_state_mtx
+    FRAME_WAIT, // waiting for the game thread to pick up the script
+    EXECUTE,    // lua running on the game thread
+    SERIALIZE,  // json dump of the response
+    COUNT,
+};
+
+class RequestContext {
+public:
+    RequestContext();
+    ~RequestContext();
+
+    RequestContext(const RequestContext&) = delete;
+    RequestContext& operator=(const RequestContext&) = delete;
+
+    /**
+     * context of the request handled by this thread, nullptr outside of a request
+     */
+    static RequestContext* current();
+
+    void addPhase(Phase phase, std::chrono::nanoseconds elapsed) {
+        phases_[ static_cast<size_t>(phase) ] += elapsed;
+    }
+
+    /**
+     * remembers the (last) lua script of this request by hash
+     */
+    void noteLua(std::string_view script);
+    void setError(std::string_view error) { error_ = error; }
+
+    std::chrono::nanoseconds elapsed() const {
+        return std::chrono::steady_clock::now() - start_;
+    }
+
+private:
+    friend class FlightRecorder;
+
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::system_clock::time_point started_at_;
+    std::array<std::chrono::nanoseconds, static_cast<size_t>(Phase::COUNT)> phases_{};
+    uint64_t lua_hash_ = 0;
+    uint32_t lua_calls_ = 0;
+    std::string error_;
+    RequestContext* previous_;
+};
+
+/**
+ * adds its lifetime to a phase of the current request
+ */
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase)
+        : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        if (const auto ctx = RequestContext::current()) {
+            ctx->addPhase(phase_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * FNV-1a, 64 bit
+ */
+constexpr uint64_t Fnv1a(std::string_view data) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const auto c : data) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+class FlightRecorder {
+public:
+    static constexpr size_t CAPACITY = 128;
+
+    static FlightRecorder& instance();
+
+    std::chrono::milliseconds threshold() const {
+        return std::chrono::milliseconds(threshold_ms_.load(std::memory_order_relaxed));
+    }
+    void setThreshold(std::chrono::milliseconds threshold) {
+        threshold_ms_.store(threshold.count(), std::memory_order_relaxed);
+    }
+
+    /**
+     * records the request if it was slower than the threshold, failed (status >= 500)
+     * or threw
+     */
+    void finish(const RequestContext& ctx, std::string_view method, std::string_view route,
+        const std::multimap<std::string, std::string>& params, int status,
+        size_t response_bytes);
+
+    /**
+     * newest first, at most `limit` entries that took at least `min_duration`
+     */
+    nlohmann::json entries(std::chrono::milliseconds min_duration, size_t limit) const;
+
+private:
+    FlightRecorder() = default;
+
+    std::atomic<int64_t> threshold_ms_{250};
+    mutable std::mutex mtx_;
+    std::deque<nlohmann::json> entries_;
+    uint64_t recorded_ = 0;
+};
+
+} // namespace metrics
@@ -0,0 +1,148 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "FrameMonitor.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace metrics {
+
+namespace {
+
+double Milliseconds(int64_t ns) { return static_cast<double>(ns) / 1e6; }
+
+/**
+ * p50/p90/p99/max of `values` (sorted in place), in ms
+ */
+nlohmann::json Percentiles(std::vector<int64_t>& values) {
+    if (values.empty()) {
+        return nullptr;
+    }
+    std::sort(values.begin(), values.end());
+    const auto at = [ & ](double q) {
+        const auto index = static_cast<size_t>(q * static_cast<double>(values.size() - 1));
+        return Milliseconds(values[ index ]);
+    };
+    return {{"p50", at(0.5)}, {"p90", at(0.9)}, {"p99", at(0.99)},
+        {"max", Milliseconds(values.back())}};
+}
+
+} // namespace
+
+FrameMonitor& FrameMonitor::instance() {
+    static FrameMonitor monitor;
+    return monitor;
+}
+
+FrameMonitor::FrameMonitor()
+    : interval_histogram_(Registry::instance().histogram(
+          "x4_game_frame_interval_seconds", "Time between two onUpdate calls of the UI")),
+      work_histogram_(Registry::instance().histogram("x4_game_frame_injected_work_seconds",
+          "Time per frame spent on lua and watch sampling injected by the server")),
+      overhead_gauge_(Registry::instance().gauge("x4_game_frame_overhead_ppm",
+          "Rolling share of frame time spent on injected work, parts per million")),
+      deferred_counter_(Registry::instance().counter("x4_game_frame_deferred_total",
+          "Frames in which injected work was held back by the throttle")) {}
+
+void FrameMonitor::beginFrame() {
+    const auto now = std::chrono::steady_clock::now();
+    pending_interval_ns_ = last_frame_.time_since_epoch().count() == 0
+                               ? 0
+                               : std::chrono::nanoseconds(now - last_frame_).count();
+    last_frame_ = now;
+    work_start_ = now;
+}
+
+void FrameMonitor::endFrame() {
+    const auto work_ns =
+        std::chrono::nanoseconds(std::chrono::steady_clock::now() - work_start_).count();
+    if (pending_interval_ns_ == 0) {
+        return; // first frame, no interval yet
+    }
+
+    const auto frame = frames_.load(std::memory_order_relaxed);
+    auto& sample = samples_[ frame % WINDOW ];
+    if (frame >= WINDOW) {
+        window_interval_ns_ -= sample.interval_ns.load(std::memory_order_relaxed);
+        window_work_ns_ -= sample.work_ns.load(std::memory_order_relaxed);
+    }
+    sample.interval_ns.store(pending_interval_ns_, std::memory_order_relaxed);
+    sample.work_ns.store(work_ns, std::memory_order_relaxed);
+    window_interval_ns_ += pending_interval_ns_;
+    window_work_ns_ += work_ns;
+    frames_.store(frame + 1, std::memory_order_relaxed);
+
+    const auto overhead = window_interval_ns_ > 0 ? static_cast<double>(window_work_ns_) /
+                                                        static_cast<double>(window_interval_ns_)
+                                                  : 0.0;
+    overhead_.store(overhead, std::memory_order_relaxed);
+    overhead_gauge_.set(static_cast<int64_t>(overhead * 1e6));
+    interval_histogram_.observe(std::chrono::nanoseconds(pending_interval_ns_));
+    work_histogram_.observe(std::chrono::nanoseconds(work_ns));
+}
+
+bool FrameMonitor::shouldDefer() {
+    if (!throttle_enabled_.load(std::memory_order_relaxed) ||
+        overhead_.load(std::memory_order_relaxed) <
+            throttle_target_.load(std::memory_order_relaxed) ||
+        deferred_in_row_ >= throttle_max_deferred_.load(std::memory_order_relaxed)) {
+        deferred_in_row_ = 0;
+        return false;
+    }
+    deferred_in_row_++;
+    deferred_counter_.inc();
+    return true;
+}
+
+void FrameMonitor::setThrottle(const ThrottleConfig& config) {
+    throttle_target_.store(config.target_percent / 100.0, std::memory_order_relaxed);
+    throttle_max_deferred_.store(
+        std::min(config.max_deferred_frames, MAX_DEFERRED_FRAMES), std::memory_order_relaxed);
+    throttle_enabled_.store(config.enabled, std::memory_order_relaxed);
+}
+
+FrameMonitor::ThrottleConfig FrameMonitor::throttle() const {
+    return {throttle_enabled_.load(std::memory_order_relaxed),
+        throttle_target_.load(std::memory_order_relaxed) * 100.0,
+        throttle_max_deferred_.load(std::memory_order_relaxed)};
+}
+
+nlohmann::json FrameMonitor::snapshot() const {
+    const auto frames = frames_.load(std::memory_order_relaxed);
+    const auto count = static_cast<size_t>(std::min<uint64_t>(frames, WINDOW));
+
+    std::vector<int64_t> intervals;
+    std::vector<int64_t> work;
+    intervals.reserve(count);
+    work.reserve(count);
+    int64_t interval_sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        intervals.push_back(samples_[ i ].interval_ns.load(std::memory_order_relaxed));
+        work.push_back(samples_[ i ].work_ns.load(std::memory_order_relaxed));
+        interval_sum += intervals.back();
+    }
+
+    const auto config = throttle();
+    return {
+        {"frames", frames},
+        {"window", count},
+        {"fps", interval_sum > 0 ? static_cast<double>(count) * 1e9 /
+                                       static_cast<double>(interval_sum)
+                                 : 0.0},
+        {"overheadPercent", overheadPercent()},
+        {"frameIntervalMs", Percentiles(intervals)},
+        {"injectedWorkMs", Percentiles(work)},
+        {"throttle",
+            {{"enabled", config.enabled}, {"targetPercent", config.target_percent},
+                {"maxDeferredFrames", config.max_deferred_frames},
+                {"deferredFrames", deferred_counter_.value()}}},
+    };
+}
+
+} // namespace metrics
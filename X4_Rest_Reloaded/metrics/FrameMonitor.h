@@ -0,0 +1,97 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include "Metrics.h"
+
+/**
+ * Measures what the work injected into the game thread (lua from requests, watch sampling)
+ * costs per frame, relative to the frame interval.
+ *
+ * beginFrame/endFrame are only called from the game thread; readers on other threads see
+ * a rolling window through relaxed atomics, so a snapshot may mix two frames.
+ */
+namespace metrics {
+
+class FrameMonitor {
+public:
+    static constexpr size_t WINDOW = 600; // ~10s at 60fps
+
+    static FrameMonitor& instance();
+
+    /**
+     * start of onUpdate; everything until endFrame counts as injected work
+     */
+    void beginFrame();
+    void endFrame();
+
+    /**
+     * true if injected work should be held back this frame: the throttle is enabled,
+     * the rolling overhead is above target and work wasn't deferred for
+     * `max_deferred_frames` frames in a row already.
+     */
+    bool shouldDefer();
+
+    // Deferring more frames than this in a row (0.5s at 60fps) would eat into the 3s an
+    // executeLua waits for its turn, so a busy game could time every call out
+    static constexpr uint32_t MAX_DEFERRED_FRAMES = 30;
+
+    struct ThrottleConfig {
+        bool enabled = false;
+        double target_percent = 2.0;
+        uint32_t max_deferred_frames = 3;
+    };
+    // max_deferred_frames is capped at MAX_DEFERRED_FRAMES
+    void setThrottle(const ThrottleConfig& config);
+    ThrottleConfig throttle() const;
+
+    /**
+     * rolling share of the frame interval spent on injected work, in percent
+     */
+    double overheadPercent() const { return overhead_.load(std::memory_order_relaxed) * 100.0; }
+
+    nlohmann::json snapshot() const;
+
+private:
+    FrameMonitor();
+
+    struct Sample {
+        std::atomic<int64_t> interval_ns{0};
+        std::atomic<int64_t> work_ns{0};
+    };
+
+    // game thread only
+    std::chrono::steady_clock::time_point last_frame_{};
+    std::chrono::steady_clock::time_point work_start_{};
+    int64_t pending_interval_ns_ = 0;
+    int64_t window_interval_ns_ = 0;
+    int64_t window_work_ns_ = 0;
+    uint32_t deferred_in_row_ = 0;
+
+    std::array<Sample, WINDOW> samples_;
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<double> overhead_{0};
+
+    std::atomic<bool> throttle_enabled_{false};
+    std::atomic<double> throttle_target_{0.02};
+    std::atomic<uint32_t> throttle_max_deferred_{3};
+
+    Histogram& interval_histogram_;
+    Histogram& work_histogram_;
+    Gauge& overhead_gauge_;
+    Counter& deferred_counter_;
+};
+
+} // namespace metrics
@@ -0,0 +1,102 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <httplib.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Metrics.h"
+
+namespace metrics {
+
+namespace detail {
+// pattern of the route whose handler runs on this thread, null until one has
+inline thread_local const std::string* matched_route = nullptr;
+}
+
+/**
+ * Registers handlers on a server set up with InstrumentServer, so that its requests are
+ * labelled by the route pattern they matched rather than by path.
+ */
+class InstrumentedRoutes {
+public:
+    explicit InstrumentedRoutes(httplib::Server& server) : server_(server) {}
+
+    InstrumentedRoutes& Get(const std::string& pattern, httplib::Server::Handler handler) {
+        server_.Get(pattern, Track(pattern, std::move(handler)));
+        return *this;
+    }
+    InstrumentedRoutes& Post(const std::string& pattern, httplib::Server::Handler handler) {
+        server_.Post(pattern, Track(pattern, std::move(handler)));
+        return *this;
+    }
+    InstrumentedRoutes& Put(const std::string& pattern, httplib::Server::Handler handler) {
+        server_.Put(pattern, Track(pattern, std::move(handler)));
+        return *this;
+    }
+    InstrumentedRoutes& Patch(const std::string& pattern, httplib::Server::Handler handler) {
+        server_.Patch(pattern, Track(pattern, std::move(handler)));
+        return *this;
+    }
+    InstrumentedRoutes& Delete(const std::string& pattern, httplib::Server::Handler handler) {
+        server_.Delete(pattern, Track(pattern, std::move(handler)));
+        return *this;
+    }
+
+private:
+    static httplib::Server::Handler Track(const std::string& pattern, httplib::Server::Handler handler) {
+        return [ route = std::make_shared<const std::string>(pattern), handler = std::move(handler) ](
+                   const httplib::Request& req, httplib::Response& res) {
+            detail::matched_route = route.get();
+            handler(req, res);
+        };
+    }
+
+    httplib::Server& server_;
+};
+
+/**
+ * Adds per-route request metrics and a /metrics endpoint to a server. Requests are labelled
+ * by the pattern of the handler that ran, so register handlers through InstrumentedRoutes;
+ * requests no such handler ran for are labelled "unmatched".
+ */
+inline void InstrumentServer(httplib::Server& server, const std::string& prefix) {
+    InstrumentedRoutes(server).Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(Registry::instance().render(), CONTENT_TYPE);
+    });
+
+    // httplib handles a request on a single thread: pre-routing stamps the start,
+    // the logger runs once the response has been written
+    static thread_local std::chrono::steady_clock::time_point request_start;
+    server.set_pre_routing_handler([](const httplib::Request&, httplib::Response&) {
+        request_start = std::chrono::steady_clock::now();
+        detail::matched_route = nullptr;
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+
+    server.set_logger([ prefix ](const httplib::Request& req, const httplib::Response& res) {
+        static const std::string unmatched = "unmatched";
+        const auto elapsed = std::chrono::steady_clock::now() - request_start;
+        const auto& route = detail::matched_route ? *detail::matched_route : unmatched;
+        detail::matched_route = nullptr; // requests httplib rejects skip pre-routing
+
+        // registry lookups take a lock; every thread keeps its own route cache
+        thread_local std::unordered_map<std::string, std::unique_ptr<RouteMetrics>> cache;
+        auto& metrics = cache[ prefix + ' ' + req.method + ' ' + route ];
+        if (!metrics) {
+            metrics = std::make_unique<RouteMetrics>(prefix, req.method, route);
+        }
+        metrics->record(res.status, elapsed);
+    });
+}
+
+} // namespace metrics
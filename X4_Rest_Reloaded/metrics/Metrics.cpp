@@ -0,0 +1,234 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace metrics {
+
+uint64_t Counter::value() const {
+    uint64_t sum = 0;
+    for (const auto& shard : shards_) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void Histogram::observe(std::chrono::nanoseconds elapsed) {
+    const auto ns = static_cast<uint64_t>(std::max<int64_t>(elapsed.count(), 0));
+    // smallest k with ns <= 2^k us
+    const auto us = (ns + 999) / 1000;
+    const auto bucket = std::min<size_t>(us <= 1 ? 0 : std::bit_width(us - 1), BUCKETS - 1);
+
+    auto& shard = shards_[ ShardIndex() ];
+    shard.buckets[ bucket ].fetch_add(1, std::memory_order_relaxed);
+    shard.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+double Histogram::UpperBound(size_t i) {
+    return i + 1 >= BUCKETS ? INFINITY : std::ldexp(1e-6, static_cast<int>(i));
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot;
+    uint64_t sum_ns = 0;
+    for (const auto& shard : shards_) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            const auto n = shard.buckets[ i ].load(std::memory_order_relaxed);
+            snapshot.buckets[ i ] += n;
+            snapshot.count += n;
+        }
+        sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+    }
+    snapshot.sum_seconds = static_cast<double>(sum_ns) / 1e9;
+    return snapshot;
+}
+
+double Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[ i ];
+        if (seen >= rank) {
+            return UpperBound(i);
+        }
+    }
+    return UpperBound(BUCKETS - 1);
+}
+
+std::string Labels(
+    std::initializer_list<std::pair<std::string_view, std::string_view>> labels) {
+    std::string result;
+    for (const auto& [ key, value ] : labels) {
+        if (!result.empty()) {
+            result += ',';
+        }
+        result.append(key);
+        result += "=\"";
+        for (const auto c : value) {
+            switch (c) {
+            case '\\':
+                result += "\\\\";
+                break;
+            case '"':
+                result += "\\\"";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            default:
+                result += c;
+            }
+        }
+        result += '"';
+    }
+    return result;
+}
+
+Registry& Registry::instance() {
+    static Registry registry;
+    return registry;
+}
+
+Registry::Family& Registry::family(const std::string& name, const std::string& help, Type type) {
+    auto [ it, inserted ] = families_.try_emplace(name);
+    if (inserted) {
+        it->second.type = type;
+        it->second.help = help;
+    }
+    else if (it->second.type != type) {
+        throw std::invalid_argument("metric " + name + " registered with a different type");
+    }
+    return it->second;
+}
+
+Counter& Registry::counter(
+    const std::string& name, const std::string& help, const std::string& labels) {
+    const std::lock_guard<std::mutex> lock(mtx_);
+    auto& metric = family(name, help, Type::COUNTER).counters[ labels ];
+    if (!metric) {
+        metric = std::make_unique<Counter>();
+    }
+    return *metric;
+}
+
+Gauge& Registry::gauge(
+    const std::string& name, const std::string& help, const std::string& labels) {
+    const std::lock_guard<std::mutex> lock(mtx_);
+    auto& metric = family(name, help, Type::GAUGE).gauges[ labels ];
+    if (!metric) {
+        metric = std::make_unique<Gauge>();
+    }
+    return *metric;
+}
+
+Histogram& Registry::histogram(
+    const std::string& name, const std::string& help, const std::string& labels) {
+    const std::lock_guard<std::mutex> lock(mtx_);
+    auto& metric = family(name, help, Type::HISTOGRAM).histograms[ labels ];
+    if (!metric) {
+        metric = std::make_unique<Histogram>();
+    }
+    return *metric;
+}
+
+namespace {
+
+std::string Braced(const std::string& labels) {
+    return labels.empty() ? "" : "{" + labels + "}";
+}
+
+std::string WithLabel(const std::string& labels, const std::string& extra) {
+    return "{" + (labels.empty() ? extra : labels + "," + extra) + "}";
+}
+
+std::string FormatDouble(double value) {
+    if (std::isinf(value)) {
+        return "+Inf";
+    }
+    char buf[ 32 ];
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+    return buf;
+}
+
+} // namespace
+
+std::string Registry::render() const {
+    const std::lock_guard<std::mutex> lock(mtx_);
+    std::string out;
+    out.reserve(families_.size() * 256);
+
+    for (const auto& [ name, family ] : families_) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        switch (family.type) {
+        case Type::COUNTER:
+            out += "# TYPE " + name + " counter\n";
+            for (const auto& [ labels, counter ] : family.counters) {
+                out += name + Braced(labels) + " " + std::to_string(counter->value()) + "\n";
+            }
+            break;
+        case Type::GAUGE:
+            out += "# TYPE " + name + " gauge\n";
+            for (const auto& [ labels, gauge ] : family.gauges) {
+                out += name + Braced(labels) + " " + std::to_string(gauge->value()) + "\n";
+            }
+            break;
+        case Type::HISTOGRAM:
+            out += "# TYPE " + name + " histogram\n";
+            for (const auto& [ labels, histogram ] : family.histograms) {
+                const auto snapshot = histogram->snapshot();
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < Histogram::BUCKETS; i++) {
+                    cumulative += snapshot.buckets[ i ];
+                    out += name + "_bucket" +
+                           WithLabel(labels,
+                               "le=\"" + FormatDouble(Histogram::UpperBound(i)) + "\"") +
+                           " " + std::to_string(cumulative) + "\n";
+                }
+                out += name + "_sum" + Braced(labels) + " " +
+                       FormatDouble(snapshot.sum_seconds) + "\n";
+                out += name + "_count" + Braced(labels) + " " +
+                       std::to_string(snapshot.count) + "\n";
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+RouteMetrics::RouteMetrics(
+    std::string_view prefix, std::string_view method, std::string_view route) {
+    auto& registry = Registry::instance();
+    const auto prefix_str = std::string(prefix);
+    const auto labels = Labels({{"method", method}, {"route", route}});
+    duration_ = &registry.histogram(prefix_str + "_http_request_duration_seconds",
+        "HTTP request latency by route", labels);
+    static constexpr std::array<std::string_view, 5> classes = {
+        "1xx", "2xx", "3xx", "4xx", "5xx"};
+    for (size_t i = 0; i < classes.size(); i++) {
+        responses_[ i ] = &registry.counter(prefix_str + "_http_requests_total",
+            "HTTP requests by route and status class",
+            Labels({{"method", method}, {"route", route}, {"code", classes[ i ]}}));
+    }
+}
+
+void RouteMetrics::record(int status, std::chrono::nanoseconds elapsed) const {
+    duration_->observe(elapsed);
+    const auto status_class = std::clamp(status / 100, 1, 5) - 1;
+    responses_[ status_class ]->inc();
+}
+
+} // namespace metrics
@@ -0,0 +1,193 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Low overhead metrics, rendered in the Prometheus text format.
+ *
+ * Metrics are created once through the Registry (which hands out stable references) and
+ * then updated lock free. Counters and histograms are sharded per thread so concurrent
+ * request threads don't bounce the same cache line.
+ */
+namespace metrics {
+
+constexpr size_t SHARDS = 8;
+
+/**
+ * stable per-thread shard index
+ */
+inline size_t ShardIndex() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return index;
+}
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) {
+        shards_[ ShardIndex() ].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, SHARDS> shards_;
+};
+
+class Gauge {
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void inc(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void dec(int64_t n = 1) { value_.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+/**
+ * Latency histogram with power-of-two buckets from 1us to 2^25us (~33.5s), plus +Inf.
+ * Relative error is bounded by the bucket width, independent of magnitude.
+ */
+class Histogram {
+public:
+    static constexpr size_t BUCKETS = 27; // 2^0 .. 2^25 us, +Inf
+
+    void observe(std::chrono::nanoseconds elapsed);
+
+    /**
+     * upper bound of bucket `i` in seconds
+     */
+    static double UpperBound(size_t i);
+
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> buckets{};
+        uint64_t count = 0;
+        double sum_seconds = 0;
+
+        /**
+         * upper bound (seconds) of the bucket containing quantile `q`
+         */
+        double quantile(double q) const;
+    };
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> sum_ns{0};
+    };
+    std::array<Shard, SHARDS> shards_;
+};
+
+/**
+ * observes the lifetime of the timer
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { histogram_.observe(std::chrono::steady_clock::now() - start_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * increments a gauge for the lifetime of the guard (queue depths, in-flight requests)
+ */
+class GaugeGuard {
+public:
+    explicit GaugeGuard(Gauge& gauge) : gauge_(gauge) { gauge_.inc(); }
+    ~GaugeGuard() { gauge_.dec(); }
+
+    GaugeGuard(const GaugeGuard&) = delete;
+    GaugeGuard& operator=(const GaugeGuard&) = delete;
+
+private:
+    Gauge& gauge_;
+};
+
+/**
+ * renders `key="value",...` with Prometheus escaping
+ */
+std::string Labels(std::initializer_list<std::pair<std::string_view, std::string_view>> labels);
+
+class Registry {
+public:
+    static Registry& instance();
+
+    // the same name + labels always yield the same metric
+    Counter& counter(const std::string& name, const std::string& help,
+        const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help,
+        const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help,
+        const std::string& labels = "");
+
+    /**
+     * Prometheus text exposition format (version 0.0.4)
+     */
+    std::string render() const;
+
+private:
+    Registry() = default;
+
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Gauge>> gauges;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    };
+
+    Family& family(const std::string& name, const std::string& help, Type type);
+
+    mutable std::mutex mtx_;
+    std::map<std::string, Family> families_;
+};
+
+/**
+ * request count (by status class) and latency of a single route
+ */
+class RouteMetrics {
+public:
+    RouteMetrics(std::string_view prefix, std::string_view method, std::string_view route);
+
+    void record(int status, std::chrono::nanoseconds elapsed) const;
+
+private:
+    Histogram* duration_;
+    std::array<Counter*, 5> responses_; // 1xx .. 5xx
+};
+
+constexpr auto CONTENT_TYPE = "text/plain; version=0.0.4";
+
+} // namespace metrics
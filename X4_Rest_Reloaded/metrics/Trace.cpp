@@ -0,0 +1,122 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Trace.h"
+
+#include <array>
+#include <thread>
+
+namespace trace {
+
+namespace {
+
+constexpr size_t MAX_NAMED_THREADS = 256;
+std::array<std::atomic<const char*>, MAX_NAMED_THREADS> thread_names{};
+
+} // namespace
+
+uint32_t ThreadId() {
+    static std::atomic<uint32_t> next{1};
+    thread_local const uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void NameThread(const char* name) {
+    const auto id = ThreadId();
+    if (id < MAX_NAMED_THREADS) {
+        thread_names[ id ].store(name, std::memory_order_relaxed);
+    }
+}
+
+Recorder& Recorder::instance() {
+    static Recorder recorder;
+    return recorder;
+}
+
+Recorder::Recorder() : slots_(std::make_unique<Slot[]>(CAPACITY)) {}
+
+void Recorder::record(
+    const char* name, const char* category, uint64_t start_ns, uint64_t end_ns) {
+    const auto index = head_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[ index & (CAPACITY - 1) ];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.start.store(start_ns, std::memory_order_relaxed);
+    slot.end.store(end_ns, std::memory_order_relaxed);
+    slot.tid.store(ThreadId(), std::memory_order_relaxed);
+    slot.seq.store(index + 1, std::memory_order_release);
+}
+
+nlohmann::json Recorder::capture(std::chrono::milliseconds duration) {
+    captures_.fetch_add(1, std::memory_order_relaxed);
+    const auto first_index = head_.load(std::memory_order_relaxed);
+    const auto from = Now();
+    std::this_thread::sleep_for(duration);
+    const auto to = Now();
+    captures_.fetch_sub(1, std::memory_order_relaxed);
+    return collect(from, to, first_index);
+}
+
+nlohmann::json Recorder::collect(uint64_t from_ns, uint64_t to_ns, uint64_t first_index) const {
+    auto events = nlohmann::json::array();
+    std::array<bool, MAX_NAMED_THREADS> seen_threads{};
+
+    for (size_t i = 0; i < CAPACITY; i++) {
+        const auto& slot = slots_[ i ];
+        const auto seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == 0 || seq <= first_index) {
+            continue; // empty, being written or from before this capture
+        }
+        const auto name = slot.name.load(std::memory_order_relaxed);
+        const auto category = slot.category.load(std::memory_order_relaxed);
+        const auto start = slot.start.load(std::memory_order_relaxed);
+        const auto end = slot.end.load(std::memory_order_relaxed);
+        const auto tid = slot.tid.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq) {
+            continue; // overwritten while reading
+        }
+        if (start < from_ns || end > to_ns) {
+            continue;
+        }
+        events.push_back({
+            {"name", name},
+            {"cat", category},
+            {"ph", "X"},
+            {"ts", static_cast<double>(start - from_ns) / 1000.0},
+            {"dur", static_cast<double>(end - start) / 1000.0},
+            {"pid", 1},
+            {"tid", tid},
+        });
+        if (tid < MAX_NAMED_THREADS) {
+            seen_threads[ tid ] = true;
+        }
+    }
+
+    for (uint32_t tid = 0; tid < MAX_NAMED_THREADS; tid++) {
+        const auto name = thread_names[ tid ].load(std::memory_order_relaxed);
+        if (seen_threads[ tid ] && name != nullptr) {
+            events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", tid},
+                {"args", {{"name", name}}}});
+        }
+    }
+
+    const auto recorded = head_.load(std::memory_order_relaxed) - first_index;
+    return {
+        {"traceEvents", std::move(events)},
+        {"displayTimeUnit", "ms"},
+        {"otherData",
+            {{"recorded", recorded},
+                {"dropped", recorded > CAPACITY ? recorded - CAPACITY : 0}}},
+    };
+}
+
+} // namespace trace
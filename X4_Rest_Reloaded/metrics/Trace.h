@@ -0,0 +1,109 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * Span tracing of request lifecycles, exported as Chrome trace JSON
+ * (load in chrome://tracing or ui.perfetto.dev).
+ *
+ * Spans are only recorded while a capture is running; otherwise a Span costs one relaxed
+ * load. Recording writes into a fixed size ring without taking locks, so the game thread
+ * never blocks on a reader.
+ */
+namespace trace {
+
+/**
+ * steady clock in ns
+ */
+inline uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * small, stable per-thread id (chrome trace `tid`)
+ */
+uint32_t ThreadId();
+
+/**
+ * labels the calling thread in exported traces. `name` must outlive the process.
+ */
+void NameThread(const char* name);
+
+class Recorder {
+public:
+    static constexpr size_t CAPACITY = 1 << 15; // power of two
+
+    static Recorder& instance();
+
+    bool enabled() const { return captures_.load(std::memory_order_relaxed) > 0; }
+
+    /**
+     * `name` and `category` must point to storage that outlives the capture
+     * (string literals, endpoint paths, FFI function names)
+     */
+    void record(const char* name, const char* category, uint64_t start_ns, uint64_t end_ns);
+
+    /**
+     * records for `duration` and returns everything captured in that window as
+     * chrome trace json. Concurrent captures are fine.
+     */
+    nlohmann::json capture(std::chrono::milliseconds duration);
+
+private:
+    Recorder();
+
+    // seqlock per slot: `seq` is 0 while being written, otherwise index + 1
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<const char*> name{nullptr};
+        std::atomic<const char*> category{nullptr};
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> end{0};
+        std::atomic<uint32_t> tid{0};
+    };
+
+    nlohmann::json collect(uint64_t from_ns, uint64_t to_ns, uint64_t first_index) const;
+
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_{0};
+    std::atomic<int> captures_{0};
+};
+
+/**
+ * records its own lifetime as a complete ("X") event
+ */
+class Span {
+public:
+    explicit Span(const char* name, const char* category = "x4")
+        : name_(name), category_(category),
+          start_(Recorder::instance().enabled() ? Now() : 0) {}
+    ~Span() {
+        if (start_ != 0) {
+            Recorder::instance().record(name_, category_, start_, Now());
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* name_;
+    const char* category_;
+    uint64_t start_;
+};
+
+} // namespace trace
@@ -0,0 +1,165 @@
+/*
+MIT License - Binary WebSocket Protocol Implementation
+*/
+
+#include "BinaryProtocol.h"
+#include <bit>
+#include <cmath>
+
+namespace wire {
+
+namespace {
+
+bool ReadVarint(std::string_view& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        const auto byte = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WriteVarint(uint64_t value, std::string& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// byte by byte, so the layout doesn't depend on the host's endianness
+bool ReadFloat(std::string_view& in, float& value) {
+    if (in.size() < 4) {
+        return false;
+    }
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; ++i) {
+        bits |= static_cast<uint32_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+    }
+    in.remove_prefix(4);
+    value = std::bit_cast<float>(bits);
+    return true;
+}
+
+// The sector ends up in JSON, which only takes valid UTF-8
+bool ValidUtf8(std::string_view text) {
+    size_t i = 0;
+    while (i < text.size()) {
+        const auto lead = static_cast<uint8_t>(text[i]);
+        size_t length = 0;
+        uint32_t codepoint = 0;
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        } else if ((lead & 0xE0) == 0xC0) {
+            length = 2;
+            codepoint = lead & 0x1F;
+        } else if ((lead & 0xF0) == 0xE0) {
+            length = 3;
+            codepoint = lead & 0x0F;
+        } else if ((lead & 0xF8) == 0xF0) {
+            length = 4;
+            codepoint = lead & 0x07;
+        } else {
+            return false;
+        }
+        if (i + length > text.size()) {
+            return false;
+        }
+        for (size_t k = 1; k < length; ++k) {
+            const auto byte = static_cast<uint8_t>(text[i + k]);
+            if ((byte & 0xC0) != 0x80) {
+                return false;
+            }
+            codepoint = (codepoint << 6) | (byte & 0x3F);
+        }
+        // overlong encodings, surrogates and values past U+10FFFF
+        static constexpr uint32_t MIN_CODEPOINT[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (codepoint < MIN_CODEPOINT[length] || codepoint > 0x10FFFF
+            || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+void WriteFloat(float value, std::string& out) {
+    const auto bits = std::bit_cast<uint32_t>(value);
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+    }
+}
+
+}
+
+bool Decode(std::string_view payload, Frame& frame) {
+    if (payload.empty()) {
+        return false;
+    }
+    frame.type = static_cast<MessageType>(static_cast<uint8_t>(payload.front()));
+    payload.remove_prefix(1);
+    if (frame.type != MessageType::Heartbeat && frame.type != MessageType::Position
+        && frame.type != MessageType::PlayerPosition) {
+        return false;
+    }
+    if (!ReadVarint(payload, frame.sessionId) || !ReadVarint(payload, frame.seq)) {
+        return false;
+    }
+    frame.hasSector = false;
+    frame.sector = {};
+    if (frame.type == MessageType::Heartbeat) {
+        return payload.empty();
+    }
+
+    auto& pose = frame.pose;
+    for (auto* value : {&pose.x, &pose.y, &pose.z, &pose.pitch, &pose.yaw, &pose.roll}) {
+        if (!ReadFloat(payload, *value) || !std::isfinite(*value)) {
+            return false;
+        }
+    }
+    if (payload.empty()) {
+        return false;
+    }
+    const auto flags = static_cast<uint8_t>(payload.front());
+    payload.remove_prefix(1);
+    if (flags & FLAG_SECTOR) {
+        uint64_t length = 0;
+        if (!ReadVarint(payload, length) || length > MAX_SECTOR_LENGTH || length > payload.size()) {
+            return false;
+        }
+        frame.hasSector = true;
+        frame.sector = payload.substr(0, static_cast<size_t>(length));
+        if (!ValidUtf8(frame.sector)) {
+            return false;
+        }
+        payload.remove_prefix(static_cast<size_t>(length));
+    }
+    return payload.empty();
+}
+
+void Encode(const Frame& frame, std::string& out) {
+    out.push_back(static_cast<char>(frame.type));
+    WriteVarint(frame.sessionId, out);
+    WriteVarint(frame.seq, out);
+    if (frame.type == MessageType::Heartbeat) {
+        return;
+    }
+
+    const auto& pose = frame.pose;
+    for (auto value : {pose.x, pose.y, pose.z, pose.pitch, pose.yaw, pose.roll}) {
+        WriteFloat(value, out);
+    }
+    const bool sector = frame.hasSector && frame.sector.size() <= MAX_SECTOR_LENGTH;
+    out.push_back(static_cast<char>(sector ? FLAG_SECTOR : 0));
+    if (sector) {
+        WriteVarint(frame.sector.size(), out);
+        out.append(frame.sector);
+    }
+}
+
+} // namespace wire
@@ -0,0 +1,61 @@
+/*
+MIT License - Binary WebSocket Protocol for X4 Foundations Multiplayer
+
+Compact frames for the high rate traffic (heartbeats and positions) on the WebSocket
+port, so a client can stream its position at 10-20 Hz without JSON on either side.
+
+Every frame starts with its type byte, followed by unsigned LEB128 varints and, for
+positions, a fixed layout pose of six little endian float32s:
+
+    Heartbeat       0x01  varint sessionId, varint seq
+    Position        0x02  varint sessionId, varint seq, pose, flags [, sector]
+    PlayerPosition  0x82  same as Position, sent by the server for other players
+
+pose is x, y, z (meters in sector), pitch, yaw, roll (as UIPosRot). flags bit 0 means a
+sector follows as varint length + UTF-8 bytes. seq increases per sender; older frames
+are dropped. Frames with a non-finite pose value or a sector that is not valid UTF-8 are
+rejected.
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace wire {
+
+enum class MessageType : uint8_t {
+    Heartbeat = 0x01,
+    Position = 0x02,
+    PlayerPosition = 0x82
+};
+
+struct Pose {
+    float x = 0, y = 0, z = 0;
+    float pitch = 0, yaw = 0, roll = 0;
+};
+
+struct Frame {
+    MessageType type = MessageType::Heartbeat;
+    uint64_t sessionId = 0;
+    uint64_t seq = 0;
+    Pose pose; // Position and PlayerPosition
+    bool hasSector = false;
+    std::string_view sector; // points into the decoded payload
+};
+
+constexpr uint8_t FLAG_SECTOR = 0x01;
+constexpr size_t MAX_SECTOR_LENGTH = 255;
+
+/**
+ * Parses `payload` into `frame` without allocating; false if it is malformed, of an
+ * unknown type, has a NaN/infinite pose value or a sector that is not valid UTF-8. frame.sector stays valid as long as `payload` does.
+ */
+bool Decode(std::string_view payload, Frame& frame);
+
+/**
+ * Appends the encoded frame to `out`
+ */
+void Encode(const Frame& frame, std::string& out);
+
+} // namespace wire
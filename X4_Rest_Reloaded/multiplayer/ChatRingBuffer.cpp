@@ -0,0 +1,88 @@
+/*
+MIT License - Chat Ring Buffer Implementation
+*/
+
+#include "ChatRingBuffer.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <mutex>
+
+ChatRingBuffer::ChatRingBuffer(size_t capacity) : records_(std::max<size_t>(capacity, 1)) {}
+
+uint64_t ChatRingBuffer::append(std::string_view room, const std::string& playerId,
+    const std::string& playerName, const std::string& message, int64_t timestamp, const Appended& appended) {
+    // serialize outside the lock; only the sequence number is spliced in under it
+    const auto body = nlohmann::json{
+        {"room", room},
+        {"playerId", playerId},
+        {"playerName", playerName},
+        {"message", message},
+        {"timestamp", timestamp}
+    }.dump();
+
+    std::unique_lock lock(mutex_);
+    const auto seq = ++latestSeq_;
+    auto& record = records_[(seq - 1) % records_.size()];
+    record.seq = seq;
+    record.room.assign(room);
+    // reuses the slot's buffers once the ring has wrapped
+    record.json.assign("{\"seq\":");
+    record.json.append(std::to_string(seq));
+    record.json.push_back(',');
+    record.json.append(body, 1, std::string::npos);
+    if (appended) {
+        appended(seq);
+    }
+    return seq;
+}
+
+ChatRingBuffer::ReadResult ChatRingBuffer::read(uint64_t since, size_t limit, std::string_view room) const {
+    ReadResult result;
+    std::vector<const Record*> selected;
+    const auto matches = [&](const Record& record) { return room.empty() || record.room == room; };
+
+    std::shared_lock lock(mutex_);
+    result.latestSeq = latestSeq_;
+    if (latestSeq_ == 0) {
+        result.messages = "[]";
+        return result;
+    }
+    const auto capacity = static_cast<uint64_t>(records_.size());
+    result.oldestSeq = latestSeq_ > capacity ? latestSeq_ - capacity + 1 : 1;
+
+    if (since > 0) {
+        for (auto seq = std::max(since + 1, result.oldestSeq); seq <= latestSeq_ && selected.size() < limit; ++seq) {
+            if (matches(at(seq))) {
+                selected.push_back(&at(seq));
+            }
+        }
+    } else {
+        for (auto seq = latestSeq_; seq >= result.oldestSeq && selected.size() < limit; --seq) {
+            if (matches(at(seq))) {
+                selected.push_back(&at(seq));
+            }
+        }
+        std::reverse(selected.begin(), selected.end());
+    }
+
+    size_t size = 2;
+    for (const auto* record : selected) {
+        size += record->json.size() + 1;
+    }
+    result.messages.reserve(size);
+    result.messages.push_back('[');
+    for (const auto* record : selected) {
+        if (result.messages.size() > 1) {
+            result.messages.push_back(',');
+        }
+        result.messages.append(record->json);
+    }
+    result.messages.push_back(']');
+    result.count = selected.size();
+    return result;
+}
+
+uint64_t ChatRingBuffer::latestSeq() const {
+    std::shared_lock lock(mutex_);
+    return latestSeq_;
+}
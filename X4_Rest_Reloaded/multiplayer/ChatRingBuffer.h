@@ -0,0 +1,60 @@
+/*
+MIT License - Chat Ring Buffer for X4 Foundations Multiplayer
+
+Fixed capacity chat history. Every message gets a sequence number and is serialized
+once when it is posted; reads concatenate the stored JSON text.
+*/
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ChatRingBuffer {
+public:
+    static constexpr auto DEFAULT_ROOM = "global";
+
+    struct ReadResult {
+        std::string messages; // JSON array text
+        size_t count = 0;
+        uint64_t latestSeq = 0; // last sequence number posted, 0 if none
+        uint64_t oldestSeq = 0; // oldest sequence number still held, 0 if none
+    };
+
+    // Called with the new sequence number while the buffer is still locked, so whatever it
+    // queues is queued in order. Must not call back into the buffer.
+    using Appended = std::function<void(uint64_t seq)>;
+
+    explicit ChatRingBuffer(size_t capacity);
+
+    /**
+     * stores a message, returns its sequence number (starting at 1)
+     */
+    uint64_t append(std::string_view room, const std::string& playerId, const std::string& playerName,
+        const std::string& message, int64_t timestamp, const Appended& appended = {});
+
+    /**
+     * messages with a sequence number above `since`, oldest first, at most `limit`.
+     * Without `since` (0) the newest `limit` messages. An empty `room` matches all rooms.
+     * If `since` is below oldestSeq - 1, messages in between were overwritten.
+     */
+    ReadResult read(uint64_t since, size_t limit, std::string_view room = {}) const;
+
+    uint64_t latestSeq() const;
+
+private:
+    struct Record {
+        uint64_t seq = 0;
+        std::string room;
+        std::string json; // serialized message object, including seq and room
+    };
+
+    const Record& at(uint64_t seq) const { return records_[(seq - 1) % records_.size()]; }
+
+    std::vector<Record> records_; // preallocated, slot (seq - 1) % capacity
+    uint64_t latestSeq_ = 0;
+    mutable std::shared_mutex mutex_;
+};
@@ -3,15 +3,67 @@ MIT License - Enhanced Multiplayer Server Implementation
 */
 
 #include "EnhancedMultiplayerServer.h"
+#include "../httpserver/QueryParams.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
+namespace {
+
+// State updates where only the latest one per player matters to a client that is behind.
+// They come at tick rate, so they are not kept in the event log either: a few dozen
+// players moving would otherwise push everything else out of the resume history.
+const std::unordered_set<std::string> COALESCED_EVENT_TYPES = {
+    "economy_update",
+    "player_update",
+    "player_position"
+};
+
+// Sector an event concerns, for sector subscriptions
+std::string eventSector(const nlohmann::json& data) {
+    if (!data.is_object()) {
+        return "";
+    }
+    for (const auto* key : {"sector", "currentSector"}) {
+        auto it = data.find(key);
+        if (it != data.end() && it->is_string()) {
+            return it->get<std::string>();
+        }
+    }
+    return "";
+}
+
+}
+
 EnhancedMultiplayerServer::EnhancedMultiplayerServer(int port, int wsPort) 
-    : MultiplayerServer(port), wsPort_(wsPort) {
+    : MultiplayerServer(port), wsPort_(wsPort),
+      wsConnectionsGauge_(metrics::Registry::instance().gauge(
+          "x4mp_websocket_connections", "Open WebSocket connections")),
+      eventQueueGauge_(metrics::Registry::instance().gauge(
+          "x4mp_event_queue_depth", "Events waiting to be dispatched")),
+      eventQueueLatency_(metrics::Registry::instance().histogram(
+          "x4mp_event_queue_seconds", "Time from queueing an event to its fan-out")),
+      eventsDispatched_(metrics::Registry::instance().counter(
+          "x4mp_events_dispatched_total", "Events taken off the queue and fanned out")),
+      wsSendErrors_(metrics::Registry::instance().counter(
+          "x4mp_websocket_send_errors_total", "Failed WebSocket sends")),
+      wsDropped_(metrics::Registry::instance().counter(
+          "x4mp_websocket_dropped_total", "Messages dropped from full per-connection queues")),
+      wsCoalesced_(metrics::Registry::instance().counter(
+          "x4mp_websocket_coalesced_total", "Queued messages replaced by a newer one of the same kind")),
+      wsBinaryFrames_(metrics::Registry::instance().counter(
+          "x4mp_websocket_binary_frames_total", "Binary heartbeat and position frames applied")),
+      wsBinaryRejected_(metrics::Registry::instance().counter(
+          "x4mp_websocket_binary_rejected_total", "Binary frames that were malformed, unbound or out of order")) {
     detailedEconomy_.lastUpdate = std::chrono::system_clock::now();
 }
 
+EnhancedMultiplayerServer::EnhancedMultiplayerServer(const MultiplayerConfig::ServerConfig& config)
+    : EnhancedMultiplayerServer(config.serverPort, config.wsPort) {
+    applyConfig(config);
+}
+
 EnhancedMultiplayerServer::~EnhancedMultiplayerServer() {
     stop();
 }
@@ -41,6 +93,12 @@ void EnhancedMultiplayerServer::start() {
 void EnhancedMultiplayerServer::stop() {
     MultiplayerServer::stop();
     
+    // Wake the event processor so it sees running_ == false
+    {
+        std::lock_guard<std::mutex> lock(eventMutex_);
+    }
+    eventCv_.notify_all();
+    
     // Stop WebSocket server
     stopWebSocketServer();
     
@@ -50,6 +108,11 @@ void EnhancedMultiplayerServer::stop() {
     }
 }
 
+void EnhancedMultiplayerServer::applyConfig(const MultiplayerConfig::ServerConfig& config) {
+    MultiplayerServer::applyConfig(config);
+    eventBatchWindowMs_ = std::max(0, config.eventBatchWindowMs);
+}
+
 void EnhancedMultiplayerServer::enableTLS(const std::string& certFile, const std::string& keyFile) {
     certFile_ = certFile;
     keyFile_ = keyFile;
@@ -63,75 +126,75 @@ void EnhancedMultiplayerServer::enableTLS(const std::string& certFile, const std
 void EnhancedMultiplayerServer::setupEnhancedEndpoints() {
     
     // Authentication endpoints
-    server_.Post("/auth/register", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/auth/register", [this](const httplib::Request& req, httplib::Response& res) {
         handleUserRegistration(req, res);
     });
     
-    server_.Post("/auth/login", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/auth/login", [this](const httplib::Request& req, httplib::Response& res) {
         handleUserLogin(req, res);
     });
     
-    server_.Post("/auth/logout", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/auth/logout", [this](const httplib::Request& req, httplib::Response& res) {
         handleUserLogout(req, res);
     });
     
-    server_.Get("/auth/validate", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/auth/validate", [this](const httplib::Request& req, httplib::Response& res) {
         handleTokenValidation(req, res);
     });
     
-    server_.Post("/auth/users", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/auth/users", [this](const httplib::Request& req, httplib::Response& res) {
         handleUserManagement(req, res);
     });
     
     // Enhanced player management
-    server_.Post("/mp/player/join-authenticated", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/player/join-authenticated", [this](const httplib::Request& req, httplib::Response& res) {
         handleEnhancedPlayerJoin(req, res);
     });
     
-    server_.Post("/mp/player/permissions", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/player/permissions", [this](const httplib::Request& req, httplib::Response& res) {
         handlePlayerPermissions(req, res);
     });
     
     // Enhanced economy endpoints
-    server_.Post("/mp/economy/detailed-update", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/economy/detailed-update", [this](const httplib::Request& req, httplib::Response& res) {
         handleDetailedEconomyUpdate(req, res);
     });
     
-    server_.Get("/mp/economy/query", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/mp/economy/query", [this](const httplib::Request& req, httplib::Response& res) {
         handleEconomyQuery(req, res);
     });
     
-    server_.Post("/mp/economy/trade-sync", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/economy/trade-sync", [this](const httplib::Request& req, httplib::Response& res) {
         handleTradeDataSync(req, res);
     });
     
     // Event notification endpoints
-    server_.Post("/mp/events/broadcast", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/events/broadcast", [this](const httplib::Request& req, httplib::Response& res) {
         handleEventBroadcast(req, res);
     });
     
-    server_.Post("/mp/events/subscribe", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/events/subscribe", [this](const httplib::Request& req, httplib::Response& res) {
         handleEventSubscription(req, res);
     });
     
-    server_.Get("/mp/events/recent", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/mp/events/recent", [this](const httplib::Request& req, httplib::Response& res) {
         handleGetEvents(req, res);
     });
     
     // Admin interface endpoints
-    server_.Get("/admin", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/admin", [this](const httplib::Request& req, httplib::Response& res) {
         handleAdminDashboard(req, res);
     });
     
-    server_.Get("/admin/players", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/admin/players", [this](const httplib::Request& req, httplib::Response& res) {
         handleAdminPlayerList(req, res);
     });
     
-    server_.Get("/admin/stats", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/admin/stats", [this](const httplib::Request& req, httplib::Response& res) {
         handleAdminServerStats(req, res);
     });
     
-    server_.Post("/admin/config", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/admin/config", [this](const httplib::Request& req, httplib::Response& res) {
         handleAdminConfig(req, res);
     });
 }
@@ -291,11 +354,50 @@ void EnhancedMultiplayerServer::broadcastEvent(const std::string& eventType, con
     event.eventType = eventType;
     event.playerId = fromPlayer;
     event.eventData = data;
+    event.sector = eventSector(data);
     event.timestamp = std::chrono::system_clock::now();
     // Empty targetPlayers means broadcast to all
     
-    std::lock_guard<std::mutex> lock(eventMutex_);
-    eventQueue_.push(event);
+    enqueueEvent(std::move(event));
+}
+
+void EnhancedMultiplayerServer::onPlayerExpired(const PlayerSession& session) {
+    MultiplayerServer::onPlayerExpired(session);
+    broadcastEvent("player_leave", {
+        {"playerId", session.playerId},
+        {"playerName", session.playerName},
+        {"reason", "timeout"}
+    }, session.playerId);
+}
+
+void EnhancedMultiplayerServer::onPlayerMoved(const std::string& playerId, const std::string& previousSector,
+    const std::string& sector, const nlohmann::json& position) {
+    // Connections subscribed to a sector only hear about players in it, so the old
+    // sector is told separately that the player is gone
+    if (!previousSector.empty() && previousSector != sector) {
+        broadcastEvent("player_sector_change", {
+            {"playerId", playerId},
+            {"sector", previousSector},
+            {"newSector", sector}
+        }, playerId);
+    }
+    broadcastEvent("player_position", {
+        {"playerId", playerId},
+        {"sector", sector},
+        {"position", position}
+    }, playerId);
+}
+
+void EnhancedMultiplayerServer::onPlayerStateChanged(const nlohmann::json& change) {
+    broadcastEvent("player_state", change, change["playerId"].get<std::string>());
+}
+
+void EnhancedMultiplayerServer::onUniverseChanged(const nlohmann::json& changes) {
+    broadcastEvent("universe_update", changes);
+}
+
+void EnhancedMultiplayerServer::onChatMessage(const nlohmann::json& message) {
+    broadcastEvent("chat_message", message, message["playerId"].get<std::string>());
 }
 
 void EnhancedMultiplayerServer::sendEventToPlayer(const std::string& playerId, const std::string& eventType, const nlohmann::json& data) {
@@ -306,24 +408,47 @@ void EnhancedMultiplayerServer::sendEventToPlayer(const std::string& playerId, c
     event.timestamp = std::chrono::system_clock::now();
     event.targetPlayers.insert(playerId);
     
-    std::lock_guard<std::mutex> lock(eventMutex_);
-    eventQueue_.push(event);
+    enqueueEvent(std::move(event));
+}
+
+void EnhancedMultiplayerServer::enqueueEvent(EventNotification event) {
+    event.queuedAt = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(eventMutex_);
+        eventQueue_.push(std::move(event));
+        eventQueueGauge_.set(eventQueue_.size());
+    }
+    eventCv_.notify_one();
 }
 
 void EnhancedMultiplayerServer::processEvents() {
-    while (running_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        
+    while (true) {
         std::queue<EventNotification> eventsToProcess;
         {
-            std::lock_guard<std::mutex> lock(eventMutex_);
+            // Sleeps until an event is queued or the server stops
+            std::unique_lock<std::mutex> lock(eventMutex_);
+            eventCv_.wait(lock, [this]() { return !eventQueue_.empty() || !running_; });
+            if (!running_) {
+                break;
+            }
+            
+            // Optionally give a burst a moment to arrive so it goes out as one batch
+            const auto window = std::chrono::milliseconds(eventBatchWindowMs_.load());
+            if (window.count() > 0) {
+                eventCv_.wait_for(lock, window, [this]() { return !running_.load(); });
+            }
+            
             eventsToProcess.swap(eventQueue_);
+            eventQueueGauge_.set(0);
         }
         
+        std::vector<uint64_t> toFlush;
+        std::vector<uint64_t> matched;
         while (!eventsToProcess.empty()) {
             const auto& event = eventsToProcess.front();
+            eventQueueLatency_.observe(std::chrono::steady_clock::now() - event.queuedAt);
             
-            // Send via WebSocket to connected clients
+            // Serialize once; connections only get a pointer to it
             nlohmann::json eventMsg = {
                 {"type", "event"},
                 {"eventType", event.eventType},
@@ -332,24 +457,110 @@ void EnhancedMultiplayerServer::processEvents() {
                 {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(
                     event.timestamp.time_since_epoch()).count()}
             };
+            // Logged with a sequence number first, so clients can poll or resume from it;
+            // coalesced ones go out live only, without a seq
+            auto payload = eventMsg.dump();
+            const bool coalesced = COALESCED_EVENT_TYPES.count(event.eventType) > 0;
+            const auto seq = coalesced ? 0
+                : eventLog_.append({event.eventType, event.sector, event.playerId, event.targetPlayers}, payload);
+            auto message = std::make_shared<const OutboundMessage>(OutboundMessage{
+                std::move(payload),
+                coalesced ? event.eventType + ':' + event.playerId : "",
+                seq
+            });
             
-            std::lock_guard<std::mutex> lock(wsMutex_);
-            for (const auto& [hdl, playerId] : wsConnections_) {
-                // Check if this event should be sent to this player
-                if (event.targetPlayers.empty() || event.targetPlayers.count(playerId) > 0) {
-                    try {
-                        wsServer_->send(hdl, eventMsg.dump(), websocketpp::frame::opcode::text);
-                    } catch (const std::exception&) {
-                        // Connection may be closed, will be cleaned up later
+            {
+                std::lock_guard<std::mutex> lock(wsMutex_);
+                // Only the connections subscribed to this event, not every connection
+                matched.clear();
+                subscriptions_.match(event.eventType, event.sector, event.playerId, event.targetPlayers, matched);
+                for (auto id : matched) {
+                    auto it = wsClients_.find(id);
+                    if (it == wsClients_.end()) {
+                        continue;
+                    }
+                    auto& client = it->second;
+                    enqueueOutbound(client, message);
+                    if (!client.flushPending) {
+                        client.flushPending = true;
+                        toFlush.push_back(id);
                     }
                 }
             }
             
             eventsToProcess.pop();
+            eventsDispatched_.inc();
+        }
+        
+        // Sends happen on the asio thread, one flush per connection for the whole batch
+        for (auto id : toFlush) {
+            wsServer_->get_io_service().post([this, id]() { flushConnection(id); });
         }
     }
 }
 
+void EnhancedMultiplayerServer::enqueueOutbound(WsClient& client, const OutboundPtr& message) {
+    if (!message->coalesceKey.empty()) {
+        for (auto it = client.outbound.rbegin(); it != client.outbound.rend(); ++it) {
+            if ((*it)->coalesceKey == message->coalesceKey) {
+                *it = message;
+                wsCoalesced_.inc();
+                return;
+            }
+        }
+    }
+    if (client.outbound.size() >= MAX_OUTBOUND_MESSAGES) {
+        client.outbound.pop_front();
+        wsDropped_.inc();
+    }
+    client.outbound.push_back(message);
+}
+
+void EnhancedMultiplayerServer::flushConnection(uint64_t connectionId) {
+    // Hand over only as much as the socket is keeping up with; the rest waits in the
+    // bounded queue where it can still be coalesced or dropped
+    WebSocketServer::connection_ptr con;
+    std::vector<OutboundPtr> batch;
+    bool retry = false;
+    {
+        std::lock_guard<std::mutex> lock(wsMutex_);
+        auto it = wsClients_.find(connectionId);
+        if (it == wsClients_.end()) {
+            return; // closed meanwhile
+        }
+        auto& client = it->second;
+        std::error_code ec;
+        con = wsServer_->get_con_from_hdl(client.hdl, ec);
+        if (ec) {
+            return;
+        }
+        size_t buffered = con->get_buffered_amount();
+        while (!client.outbound.empty() && buffered < MAX_BUFFERED_BYTES) {
+            buffered += client.outbound.front()->payload.size();
+            batch.push_back(std::move(client.outbound.front()));
+            client.outbound.pop_front();
+        }
+        retry = !client.outbound.empty();
+        client.flushPending = retry;
+    }
+    
+    for (const auto& message : batch) {
+        const auto opcode = message->binary ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text;
+        if (con->send(message->payload, opcode)) {
+            // Connection may be closing, will be cleaned up by the close handler
+            wsSendErrors_.inc();
+        }
+    }
+    
+    if (retry) {
+        wsServer_->set_timer(FLUSH_RETRY_MS, [this, connectionId](const std::error_code& ec) {
+            if (!ec) {
+                flushConnection(connectionId);
+            }
+        });
+    }
+}
+
 void EnhancedMultiplayerServer::startWebSocketServer() {
     wsServer_ = std::make_unique<WebSocketServer>();
     wsServer_->set_access_channels(websocketpp::log::alevel::all);
@@ -423,31 +634,54 @@ void EnhancedMultiplayerServer::logSecurityEvent(const std::string& event, const
 
 void EnhancedMultiplayerServer::onWebSocketOpen(websocketpp::connection_hdl hdl) {
     std::lock_guard<std::mutex> lock(wsMutex_);
-    wsConnections_[hdl] = ""; // Will be set when authenticated
+    const auto id = ++nextConnectionId_;
+    wsConnectionIds_[hdl] = id;
+    wsClients_[id] = WsClient{hdl}; // playerId is set when authenticated
+    subscriptions_.addConnection(id); // receives everything until it subscribes
+    wsConnectionsGauge_.set(wsClients_.size());
     std::cout << "WebSocket connection opened" << std::endl;
 }
 
 void EnhancedMultiplayerServer::onWebSocketClose(websocketpp::connection_hdl hdl) {
     std::lock_guard<std::mutex> lock(wsMutex_);
-    wsConnections_.erase(hdl);
+    auto it = wsConnectionIds_.find(hdl);
+    if (it != wsConnectionIds_.end()) {
+        subscriptions_.removeConnection(it->second);
+        wsClients_.erase(it->second);
+        wsConnectionIds_.erase(it);
+    }
+    wsConnectionsGauge_.set(wsClients_.size());
     std::cout << "WebSocket connection closed" << std::endl;
 }
 
 void EnhancedMultiplayerServer::onWebSocketMessage(websocketpp::connection_hdl hdl, WebSocketServer::message_ptr msg) {
     try {
+        if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
+            onBinaryMessage(hdl, msg->get_payload());
+            return;
+        }
         auto data = nlohmann::json::parse(msg->get_payload());
         
         if (data["type"] == "auth") {
             std::string token = data["token"];
             if (authManager_.validateToken(token)) {
                 std::string username = authManager_.getUsernameFromToken(token);
-                std::lock_guard<std::mutex> lock(wsMutex_);
-                wsConnections_[hdl] = username;
+                uint64_t connectionId = 0;
+                {
+                    std::lock_guard<std::mutex> lock(wsMutex_);
+                    auto it = wsConnectionIds_.find(hdl);
+                    if (it != wsConnectionIds_.end()) {
+                        connectionId = it->second;
+                        wsClients_[connectionId].playerId = username;
+                        subscriptions_.setIdentity(connectionId, username);
+                    }
+                }
                 
                 nlohmann::json response = {
                     {"type", "auth_response"},
                     {"success", true},
-                    {"username", username}
+                    {"username", username},
+                    {"connectionId", connectionId}
                 };
                 wsServer_->send(hdl, response.dump(), websocketpp::frame::opcode::text);
             } else {
@@ -458,12 +692,167 @@ void EnhancedMultiplayerServer::onWebSocketMessage(websocketpp::connection_hdl h
                 };
                 wsServer_->send(hdl, response.dump(), websocketpp::frame::opcode::text);
             }
+        } else if (data["type"] == "subscribe" || data["type"] == "unsubscribe") {
+            const auto filter = SubscriptionIndex::Filter::fromJson(data);
+            nlohmann::json subscriptions;
+            {
+                std::lock_guard<std::mutex> lock(wsMutex_);
+                auto it = wsConnectionIds_.find(hdl);
+                if (it == wsConnectionIds_.end()) {
+                    return;
+                }
+                subscriptions = updateSubscriptions(it->second, filter, data["type"] == "unsubscribe");
+                auto& client = wsClients_[it->second];
+                if (data.contains("binaryPositions")) {
+                    client.binaryPositions = data["binaryPositions"].get<bool>();
+                }
+                subscriptions["binaryPositions"] = client.binaryPositions;
+            }
+            
+            nlohmann::json response = {
+                {"type", "subscribe_response"},
+                {"success", true},
+                {"subscriptions", subscriptions}
+            };
+            wsServer_->send(hdl, response.dump(), websocketpp::frame::opcode::text);
+        } else if (data["type"] == "bind") {
+            // Binary frames from this connection count for the player's session. The bind
+            // token is only ever sent to the client that joined, so it proves ownership;
+            // the session id in the frames just tells sessions apart
+            const std::string playerId = data["playerId"];
+            const std::string bindToken = data["bindToken"];
+            uint64_t sessionId = 0;
+            bool valid = false;
+            universe_.activePlayers.read(playerId, [&](const PlayerSession& session) {
+                valid = !bindToken.empty() && session.bindToken == bindToken;
+                sessionId = session.sessionId;
+            });
+            if (valid) {
+                std::lock_guard<std::mutex> lock(wsMutex_);
+                auto it = wsConnectionIds_.find(hdl);
+                if (it != wsConnectionIds_.end()) {
+                    auto& client = wsClients_[it->second];
+                    client.boundPlayer = playerId;
+                    client.boundSession = sessionId;
+                    client.lastFrameSeq = 0;
+                    client.binaryPositions = true;
+                }
+            }
+            
+            nlohmann::json response = {
+                {"type", "bind_response"},
+                {"success", valid}
+            };
+            if (!valid) {
+                response["error"] = "Unknown player session";
+            }
+            wsServer_->send(hdl, response.dump(), websocketpp::frame::opcode::text);
+        } else if (data["type"] == "resume") {
+            const auto since = data["since"].get<uint64_t>();
+            uint64_t connectionId = 0;
+            nlohmann::json response;
+            bool flush = false;
+            {
+                std::lock_guard<std::mutex> lock(wsMutex_);
+                auto it = wsConnectionIds_.find(hdl);
+                if (it == wsConnectionIds_.end()) {
+                    return;
+                }
+                connectionId = it->second;
+                response = replayEvents(connectionId, since);
+                auto& client = wsClients_[connectionId];
+                if (!client.outbound.empty() && !client.flushPending) {
+                    client.flushPending = true;
+                    flush = true;
+                }
+            }
+            
+            // The response goes out directly, ahead of the replayed events
+            wsServer_->send(hdl, response.dump(), websocketpp::frame::opcode::text);
+            if (flush) {
+                wsServer_->get_io_service().post([this, connectionId]() { flushConnection(connectionId); });
+            }
         }
     } catch (const std::exception& e) {
         std::cout << "WebSocket message error: " << e.what() << std::endl;
     }
 }
 
+void EnhancedMultiplayerServer::onBinaryMessage(websocketpp::connection_hdl hdl, std::string_view payload) {
+    wire::Frame frame;
+    if (!wire::Decode(payload, frame) || frame.type == wire::MessageType::PlayerPosition) {
+        wsBinaryRejected_.inc();
+        return;
+    }
+    
+    std::string playerId;
+    {
+        std::lock_guard<std::mutex> lock(wsMutex_);
+        auto it = wsConnectionIds_.find(hdl);
+        if (it == wsConnectionIds_.end()) {
+            return;
+        }
+        auto& client = wsClients_[it->second];
+        if (client.boundPlayer.empty() || frame.sessionId != client.boundSession || frame.seq <= client.lastFrameSeq) {
+            wsBinaryRejected_.inc();
+            return;
+        }
+        client.lastFrameSeq = frame.seq;
+        playerId = client.boundPlayer;
+    }
+    
+    std::string sector;
+    if (!applyStreamedFrame(playerId, frame, sector)) {
+        // the session ended or was replaced by a rejoin; the client has to bind again
+        std::lock_guard<std::mutex> lock(wsMutex_);
+        auto it = wsConnectionIds_.find(hdl);
+        if (it != wsConnectionIds_.end()) {
+            auto& client = wsClients_[it->second];
+            if (client.boundSession == frame.sessionId) {
+                client.boundPlayer.clear();
+                client.boundSession = 0;
+            }
+        }
+        wsBinaryRejected_.inc();
+        return;
+    }
+    wsBinaryFrames_.inc();
+    if (frame.type != wire::MessageType::Position) {
+        return;
+    }
+    
+    // Passed on as is, to the binary connections watching the sector
+    frame.type = wire::MessageType::PlayerPosition;
+    std::string encoded;
+    wire::Encode(frame, encoded);
+    auto message = std::make_shared<const OutboundMessage>(OutboundMessage{
+        std::move(encoded), "binary_position:" + playerId, 0, true
+    });
+    
+    static const std::unordered_set<std::string> broadcast;
+    std::vector<uint64_t> matched;
+    std::vector<uint64_t> toFlush;
+    {
+        std::lock_guard<std::mutex> lock(wsMutex_);
+        subscriptions_.match("player_position", sector, playerId, broadcast, matched);
+        for (auto id : matched) {
+            auto it = wsClients_.find(id);
+            if (it == wsClients_.end() || !it->second.binaryPositions || it->second.boundPlayer == playerId) {
+                continue;
+            }
+            auto& client = it->second;
+            enqueueOutbound(client, message);
+            if (!client.flushPending) {
+                client.flushPending = true;
+                toFlush.push_back(id);
+            }
+        }
+    }
+    for (auto id : toFlush) {
+        wsServer_->get_io_service().post([this, id]() { flushConnection(id); });
+    }
+}
+
 // Placeholder implementations for other handlers
 void EnhancedMultiplayerServer::handleUserManagement(const httplib::Request& req, httplib::Response& res) {
     std::string username;
@@ -558,7 +947,7 @@ void EnhancedMultiplayerServer::updateDetailedEconomyData(const std::string& pla
         {"updateType", "detailed_economy"},
         {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(
             detailedEconomy_.lastUpdate.time_since_epoch()).count()}
-    });
+    }, playerId);
 }
 
 nlohmann::json EnhancedMultiplayerServer::getDetailedEconomyData() const {
@@ -597,13 +986,143 @@ void EnhancedMultiplayerServer::handleEventBroadcast(const httplib::Request& req
 }
 
 void EnhancedMultiplayerServer::handleEventSubscription(const httplib::Request& req, httplib::Response& res) {
-    nlohmann::json response = {{"success", true}, {"message", "Event subscription endpoint placeholder"}};
-    res.set_content(response.dump(), "application/json");
+    std::string username;
+    if (!authenticateRequest(req, username)) {
+        nlohmann::json error = {
+            {"success", false},
+            {"error", "Authentication required"}
+        };
+        res.set_content(error.dump(), "application/json");
+        res.status = 401;
+        return;
+    }
+    
+    try {
+        auto data = nlohmann::json::parse(req.body);
+        const auto filter = SubscriptionIndex::Filter::fromJson(data);
+        const bool unsubscribe = data.value("unsubscribe", false);
+        
+        // One connection if given, otherwise every WebSocket the user has open
+        nlohmann::json connections = nlohmann::json::object();
+        {
+            std::lock_guard<std::mutex> lock(wsMutex_);
+            std::vector<uint64_t> ids;
+            if (data.contains("connectionId")) {
+                const auto id = data["connectionId"].get<uint64_t>();
+                auto it = wsClients_.find(id);
+                if (it == wsClients_.end() || it->second.playerId != username) {
+                    nlohmann::json error = {
+                        {"success", false},
+                        {"error", "Unknown connection"}
+                    };
+                    res.set_content(error.dump(), "application/json");
+                    res.status = 404;
+                    return;
+                }
+                ids.push_back(id);
+            } else {
+                ids = subscriptions_.connectionsOf(username);
+            }
+            for (auto id : ids) {
+                connections[std::to_string(id)] = updateSubscriptions(id, filter, unsubscribe);
+            }
+        }
+        
+        nlohmann::json response = {
+            {"success", true},
+            {"connections", connections},
+            {"count", connections.size()}
+        };
+        res.set_content(response.dump(), "application/json");
+    } catch (const std::exception& e) {
+        nlohmann::json error = {
+            {"success", false},
+            {"error", e.what()}
+        };
+        res.set_content(error.dump(), "application/json");
+        res.status = 400;
+    }
+}
+
+nlohmann::json EnhancedMultiplayerServer::replayEvents(uint64_t connectionId, uint64_t since) {
+    auto& client = wsClients_[connectionId];
+    auto log = eventLog_.read(since, MAX_RESUME_EVENTS, [&](const EventLog::Meta& meta) {
+        return subscriptions_.matches(connectionId, meta.eventType, meta.sector, meta.fromPlayer, meta.targetPlayers);
+    });
+    
+    // Queued live events the replay already covers would arrive twice
+    const auto replayedUpTo = log.events.empty() ? since : log.events.back().seq;
+    std::erase_if(client.outbound, [&](const OutboundPtr& message) {
+        return message->seq > since && message->seq <= replayedUpTo;
+    });
+    for (auto it = log.events.rbegin(); it != log.events.rend(); ++it) {
+        client.outbound.push_front(std::make_shared<const OutboundMessage>(OutboundMessage{std::move(it->json), "", it->seq}));
+    }
+    
+    return {
+        {"type", "resume_response"},
+        {"success", true},
+        {"replayed", log.events.size()},
+        {"latestSeq", log.latestSeq},
+        {"oldestSeq", log.oldestSeq},
+        // events after `since` were already overwritten, the client has to resync
+        {"gap", log.latestSeq > 0 && since + 1 < log.oldestSeq},
+        // resume again from the last replayed seq for the rest
+        {"more", log.more}
+    };
+}
+
+nlohmann::json EnhancedMultiplayerServer::updateSubscriptions(uint64_t connectionId, const SubscriptionIndex::Filter& filter, bool unsubscribe) {
+    if (unsubscribe) {
+        subscriptions_.unsubscribe(connectionId, filter);
+    } else {
+        subscriptions_.subscribe(connectionId, filter);
+    }
+    return subscriptions_.describe(connectionId);
 }
 
 void EnhancedMultiplayerServer::handleGetEvents(const httplib::Request& req, httplib::Response& res) {
-    nlohmann::json response = {{"events", nlohmann::json::array()}, {"count", 0}};
-    res.set_content(response.dump(), "application/json");
+    int limit = 20; // Default limit
+    if (req.has_param("limit")) {
+        // Use default limit if parsing fails
+        if (query::Parse(req.get_param_value("limit"), limit)) {
+            limit = std::clamp(limit, 0, static_cast<int>(MAX_RECENT_EVENTS));
+        }
+    }
+    // since=<seq> returns only newer events, oldest first
+    uint64_t since = 0;
+    if (req.has_param("since")) {
+        query::Parse(req.get_param_value("since"), since);
+    }
+    
+    // Events sent to a single player are only shown to that player
+    std::string username;
+    authenticateRequest(req, username);
+    auto log = eventLog_.read(since, static_cast<size_t>(limit), [&username](const EventLog::Meta& meta) {
+        return meta.targetPlayers.empty() || meta.targetPlayers.count(username) > 0;
+    });
+    
+    // Events are stored serialized, the response is assembled from that text
+    size_t size = 128;
+    for (const auto& event : log.events) {
+        size += event.json.size() + 1;
+    }
+    std::string response;
+    response.reserve(size);
+    response.append("{\"events\":[");
+    for (size_t i = 0; i < log.events.size(); ++i) {
+        if (i > 0) {
+            response.push_back(',');
+        }
+        response.append(log.events[i].json);
+    }
+    response.append("],\"count\":").append(std::to_string(log.events.size()));
+    response.append(",\"latestSeq\":").append(std::to_string(log.latestSeq));
+    response.append(",\"oldestSeq\":").append(std::to_string(log.oldestSeq));
+    response.append(",\"more\":").append(log.more ? "true" : "false");
+    response.push_back('}');
+    
+    res.set_content(std::move(response), "application/json");
 }
 
 void EnhancedMultiplayerServer::handleAdminDashboard(const httplib::Request& req, httplib::Response& res) {
@@ -677,7 +1196,7 @@ void EnhancedMultiplayerServer::handleAdminServerStats(const httplib::Request& r
         {"activeTokens", authManager_.getActiveTokenCount()},
         {"uptime", 3600}, // Placeholder
         {"tlsEnabled", tlsEnabled_},
-        {"wsConnections", wsConnections_.size()}
+        {"wsConnections", wsClients_.size()}
     };
     res.set_content(response.dump(), "application/json");
 }
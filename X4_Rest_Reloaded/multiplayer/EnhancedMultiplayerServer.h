@@ -11,19 +11,29 @@ This extends the basic multiplayer server with:
 #pragma once
 #include "MultiplayerServer.h"
 #include "AuthenticationManager.h"
+#include "EventLog.h"
+#include "SubscriptionIndex.h"
 #include <nlohmann/json.hpp>
 #include <websocketpp/config/asio.hpp>
 #include <websocketpp/server.hpp>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
 #include <queue>
 #include <unordered_set>
 
 class EnhancedMultiplayerServer : public MultiplayerServer {
 public:
+    static constexpr size_t EVENT_HISTORY = 4096; // events kept for since= reads and resume
+    
     struct EventNotification {
         std::string eventType;
         std::string playerId;
         nlohmann::json eventData;
         std::chrono::system_clock::time_point timestamp;
+        std::chrono::steady_clock::time_point queuedAt;
+        std::string sector; // for sector subscriptions, empty if the event has none
         std::unordered_set<std::string> targetPlayers; // Empty = broadcast to all
     };
 
@@ -36,12 +46,17 @@ public:
     };
 
     explicit EnhancedMultiplayerServer(int port = 3003, int wsPort = 3004);
+    // on config.serverPort and config.wsPort, with applyConfig(config) already done
+    explicit EnhancedMultiplayerServer(const MultiplayerConfig::ServerConfig& config);
     ~EnhancedMultiplayerServer();
 
     // Enhanced server management
     void start() override;
     void stop() override;
     
+    // also takes the event batch window
+    void applyConfig(const MultiplayerConfig::ServerConfig& config) override;
+    
     // Enable HTTPS/TLS
     void enableTLS(const std::string& certFile, const std::string& keyFile);
     bool isTLSEnabled() const { return tlsEnabled_; }
@@ -66,6 +81,19 @@ private:
     // Enhanced endpoint setup
     void setupEnhancedEndpoints();
     
+    // Tells everyone about sessions that timed out
+    void onPlayerExpired(const PlayerSession& session) override;
+    
+    // Pushes the move to the sector it happened in (see sector subscriptions)
+    void onPlayerMoved(const std::string& playerId, const std::string& previousSector,
+        const std::string& sector, const nlohmann::json& position) override;
+    
+    // Pushed as player_state, universe_update and chat_message events, so clients can keep
+    // a copy of the shared state without polling for it
+    void onPlayerStateChanged(const nlohmann::json& change) override;
+    void onUniverseChanged(const nlohmann::json& changes) override;
+    void onChatMessage(const nlohmann::json& message) override;
+    
     // Authentication endpoints
     void handleUserRegistration(const httplib::Request& req, httplib::Response& res);
     void handleUserLogin(const httplib::Request& req, httplib::Response& res);
@@ -98,10 +126,46 @@ private:
     std::string extractAuthToken(const httplib::Request& req);
     void logSecurityEvent(const std::string& event, const std::string& details);
     
+    // Event fan-out: events are serialized once into an OutboundMessage shared by every
+    // connection queue it goes to; each connection's queue is flushed on the asio thread
+    struct OutboundMessage {
+        std::string payload;
+        std::string coalesceKey; // a newer message with the same key replaces a queued one
+        uint64_t seq = 0; // event log sequence number, 0 if not an event
+        bool binary = false; // sent as a binary frame (BinaryProtocol)
+    };
+    using OutboundPtr = std::shared_ptr<const OutboundMessage>;
+    
+    struct WsClient {
+        websocketpp::connection_hdl hdl;
+        std::string playerId; // set when authenticated
+        // Binary protocol: the session this connection streams for (see "bind") and the
+        // last frame seq taken from it; binaryPositions gets other players' positions
+        std::string boundPlayer;
+        uint64_t boundSession = 0;
+        uint64_t lastFrameSeq = 0;
+        bool binaryPositions = false;
+        std::deque<OutboundPtr> outbound;
+        bool flushPending = false;
+    };
+    
+    void enqueueOutbound(WsClient& client, const OutboundPtr& message);
+    void flushConnection(uint64_t connectionId);
+    
+    // Subscriptions: a connection gets the events matching any of its subscriptions, or
+    // every event while it has none. Targeted events only reach the target's connections.
+    // Caller holds wsMutex_; returns the connection's subscriptions afterwards
+    nlohmann::json updateSubscriptions(uint64_t connectionId, const SubscriptionIndex::Filter& filter, bool unsubscribe);
+    
+    // Resume after a reconnect: queues the logged events after `since` that match the
+    // connection's subscriptions ahead of anything already queued. Caller holds wsMutex_.
+    nlohmann::json replayEvents(uint64_t connectionId, uint64_t since);
+    
     // WebSocket handlers
     void onWebSocketOpen(websocketpp::connection_hdl hdl);
     void onWebSocketClose(websocketpp::connection_hdl hdl);
     void onWebSocketMessage(websocketpp::connection_hdl hdl, websocketpp::server<websocketpp::config::asio>::message_ptr msg);
+    void onBinaryMessage(websocketpp::connection_hdl hdl, std::string_view payload);
     
     // WebSocket server type
     typedef websocketpp::server<websocketpp::config::asio> WebSocketServer;
@@ -114,8 +178,13 @@ private:
     std::string keyFile_;
     
     // Event system
+    EventLog eventLog_{EVENT_HISTORY};
     std::queue<EventNotification> eventQueue_;
     std::mutex eventMutex_;
+    std::condition_variable eventCv_;
+    std::atomic<int> eventBatchWindowMs_{0};
+    
+    void enqueueEvent(EventNotification event);
     std::thread eventProcessorThread_;
     
     // Enhanced economy data
@@ -126,13 +195,36 @@ private:
     std::unique_ptr<WebSocketServer> wsServer_;
     std::thread wsThread_;
     int wsPort_;
-    std::unordered_map<websocketpp::connection_hdl, std::string, std::owner_less<websocketpp::connection_hdl>> wsConnections_;
-    std::mutex wsMutex_;
+    std::unordered_map<uint64_t, WsClient> wsClients_;
+    std::map<websocketpp::connection_hdl, uint64_t, std::owner_less<websocketpp::connection_hdl>> wsConnectionIds_;
+    SubscriptionIndex subscriptions_;
+    uint64_t nextConnectionId_ = 0;
+    std::mutex wsMutex_; // guards wsClients_, wsConnectionIds_ and subscriptions_
+    
+    // Metrics
+    metrics::Gauge& wsConnectionsGauge_;
+    metrics::Gauge& eventQueueGauge_;
+    metrics::Histogram& eventQueueLatency_;
+    metrics::Counter& eventsDispatched_;
+    metrics::Counter& wsSendErrors_;
+    metrics::Counter& wsDropped_;
+    metrics::Counter& wsCoalesced_;
+    metrics::Counter& wsBinaryFrames_;
+    metrics::Counter& wsBinaryRejected_;
     
     // Security and logging
     std::unordered_map<std::string, int> failedLoginAttempts_;
     std::mutex securityMutex_;
     
+    // Slow consumers: at most this many messages wait per connection (oldest dropped first),
+    // and nothing more is handed to websocketpp while it buffers more than MAX_BUFFERED_BYTES
+    static constexpr size_t MAX_OUTBOUND_MESSAGES = 256;
+    static constexpr size_t MAX_BUFFERED_BYTES = 1 << 20;
+    static constexpr long FLUSH_RETRY_MS = 50;
+    
+    static constexpr size_t MAX_RECENT_EVENTS = 100; // per /mp/events/recent read
+    static constexpr size_t MAX_RESUME_EVENTS = 128; // per WebSocket resume request
+    
     static constexpr int MAX_FAILED_ATTEMPTS = 5;
     static constexpr auto LOCKOUT_DURATION = std::chrono::minutes(15);
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+MIT License - Event Log Implementation
+*/
+
+#include "EventLog.h"
+#include <algorithm>
+#include <mutex>
+
+EventLog::EventLog(size_t capacity) : records_(std::max<size_t>(capacity, 1)) {}
+
+uint64_t EventLog::append(Meta meta, std::string& json) {
+    std::unique_lock lock(mutex_);
+    const auto seq = ++latestSeq_;
+    json.insert(1, "\"seq\":" + std::to_string(seq) + (json.size() > 2 ? "," : ""));
+
+    auto& record = records_[(seq - 1) % records_.size()];
+    record.seq = seq;
+    record.meta = std::move(meta);
+    // reuses the slot's buffer once the ring has wrapped
+    record.json.assign(json);
+    return seq;
+}
+
+EventLog::ReadResult EventLog::read(uint64_t since, size_t limit, const Filter& filter) const {
+    ReadResult result;
+    std::vector<const Record*> selected;
+    const auto matches = [&](const Record& record) { return !filter || filter(record.meta); };
+
+    std::shared_lock lock(mutex_);
+    result.latestSeq = latestSeq_;
+    if (latestSeq_ == 0) {
+        return result;
+    }
+    const auto capacity = static_cast<uint64_t>(records_.size());
+    result.oldestSeq = latestSeq_ > capacity ? latestSeq_ - capacity + 1 : 1;
+
+    if (since > 0) {
+        auto seq = std::max(since + 1, result.oldestSeq);
+        for (; seq <= latestSeq_ && selected.size() < limit; ++seq) {
+            if (matches(at(seq))) {
+                selected.push_back(&at(seq));
+            }
+        }
+        for (; seq <= latestSeq_ && !result.more; ++seq) {
+            result.more = matches(at(seq));
+        }
+    } else {
+        for (auto seq = latestSeq_; seq >= result.oldestSeq && selected.size() < limit; --seq) {
+            if (matches(at(seq))) {
+                selected.push_back(&at(seq));
+            }
+        }
+        std::reverse(selected.begin(), selected.end());
+    }
+
+    result.events.reserve(selected.size());
+    for (const auto* record : selected) {
+        result.events.push_back({record->seq, record->json});
+    }
+    return result;
+}
+
+uint64_t EventLog::latestSeq() const {
+    std::shared_lock lock(mutex_);
+    return latestSeq_;
+}
@@ -0,0 +1,69 @@
+/*
+MIT License - Event Log for X4 Foundations Multiplayer
+
+Fixed capacity, append-only history of the events pushed to WebSocket clients. Every
+event gets a sequence number, so polling clients and reconnecting WebSockets can ask
+for what they missed instead of resyncing their whole state.
+*/
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class EventLog {
+public:
+    struct Meta {
+        std::string eventType;
+        std::string sector;
+        std::string fromPlayer;
+        std::unordered_set<std::string> targetPlayers; // empty for broadcasts
+    };
+
+    struct Event {
+        uint64_t seq;
+        std::string json;
+    };
+
+    struct ReadResult {
+        std::vector<Event> events; // oldest first
+        uint64_t latestSeq = 0; // last sequence number appended, 0 if none
+        uint64_t oldestSeq = 0; // oldest sequence number still held, 0 if none
+        bool more = false; // stopped at the limit with newer matching events left
+    };
+
+    using Filter = std::function<bool(const Meta&)>;
+
+    explicit EventLog(size_t capacity);
+
+    /**
+     * stores an event; `json` is its serialized object and gets the sequence number
+     * spliced in as its first member. Returns the sequence number (starting at 1).
+     */
+    uint64_t append(Meta meta, std::string& json);
+
+    /**
+     * events with a sequence number above `since` that pass `filter`, at most `limit`.
+     * Without `since` (0) the newest `limit` events.
+     * If `since` is below oldestSeq - 1, events in between were overwritten.
+     */
+    ReadResult read(uint64_t since, size_t limit, const Filter& filter = {}) const;
+
+    uint64_t latestSeq() const;
+
+private:
+    struct Record {
+        uint64_t seq = 0;
+        Meta meta;
+        std::string json;
+    };
+
+    const Record& at(uint64_t seq) const { return records_[(seq - 1) % records_.size()]; }
+
+    std::vector<Record> records_; // preallocated, slot (seq - 1) % capacity
+    uint64_t latestSeq_ = 0;
+    mutable std::shared_mutex mutex_;
+};
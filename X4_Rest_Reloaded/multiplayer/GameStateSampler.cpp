@@ -0,0 +1,165 @@
+/*
+MIT License - Game State Sampler Implementation
+*/
+
+#include "GameStateSampler.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// functions referenced by the metric expressions
+const std::string LUA_PRELUDE = R"(
+local ffi = require("ffi")
+local C = ffi.C
+ffi.cdef[[
+    uint64_t GetPlayerID(void);
+    const char* GetPlayerName(void);
+    uint64_t GetPlayerOccupiedShipID(void);
+]]
+-- the game's menus declare these too; a declaration that clashes must not stop the sample
+pcall(ffi.cdef, [[
+    typedef struct {
+        const float x;
+        const float y;
+        const float z;
+        const float yaw;
+        const float pitch;
+        const float roll;
+    } UIPosRot;
+    UIPosRot GetObjectPositionInSector(uint64_t objectid);
+]])
+local function playerId()
+    return ConvertStringTo64Bit(tostring(C.GetPlayerID()))
+end
+-- the ship the player flies, or the player when on foot; UIPosRot style, in meters
+local function playerPosition()
+    local object = C.GetPlayerOccupiedShipID()
+    if object == 0 then
+        object = C.GetPlayerID()
+    end
+    local pos = C.GetObjectPositionInSector(object)
+    return {x = pos.x, y = pos.y, z = pos.z, yaw = pos.yaw, pitch = pos.pitch, roll = pos.roll}
+end
+)";
+
+}
+
+const std::vector<GameStateSampler::Metric>& GameStateSampler::PlayerMetrics() {
+    // names match the playerData fields the client sent before, currentSector and position
+    // become the session's sector and position
+    static const std::vector<Metric> metrics = {
+        {"gameName", "ffi.string(C.GetPlayerName())"},
+        {"gamePlayerId", "tostring(playerId())"},
+        {"occupiedShipId", "tostring(ConvertStringTo64Bit(tostring(C.GetPlayerOccupiedShipID())))"},
+        {"money", "GetPlayerMoney()"},
+        {"currentSector", "tostring(GetComponentData(playerId(), \"sectorid\"))"},
+        {"position", "playerPosition()"}
+    };
+    return metrics;
+}
+
+const std::vector<GameStateSampler::Metric>& GameStateSampler::EconomyMetrics() {
+    static const std::vector<Metric> metrics = {
+        {"gameTime", "GetCurrentGameTime()", true}
+    };
+    return metrics;
+}
+
+GameStateSampler::GameStateSampler(LuaRunner runLua, const std::vector<std::string>& playerMetrics,
+    const std::vector<std::string>& economyMetrics)
+    : runLua_(std::move(runLua)) {
+    // every expression is isolated in its own pcall, like the watch sample script; one
+    // failing metric must not take down the whole sample
+    script_ = LUA_PRELUDE + "\nlocal sample = {player = {}, economy = {}}\nlocal ok, value\n";
+    const auto add = [this](const char* group, const std::vector<Metric>& metrics) {
+        for (const auto& metric : metrics) {
+            if (metric.clock) {
+                clocks_.push_back(metric.name);
+            }
+            script_ += "ok, value = pcall(function() return " + metric.luaExpression +
+                " end)\nif ok then sample." + group + "[" + nlohmann::json(metric.name).dump() + "] = value end\n";
+        }
+    };
+    add("player", Select(PlayerMetrics(), playerMetrics));
+    add("economy", Select(EconomyMetrics(), economyMetrics));
+    script_ += "return json.encode(sample)";
+}
+
+bool GameStateSampler::sample(Sample& out) {
+    std::string result;
+    try {
+        result = runLua_(script_);
+    } catch (const std::exception& e) {
+        std::cout << "Error sampling game state: " << e.what() << std::endl;
+        return false;
+    }
+
+    // nothing moved since the last sample; skip parsing entirely
+    if (sampled_ && result == lastResult_) {
+        out.player = player_;
+        out.economy = economy_;
+        out.playerChanged = false;
+        out.economyChanged = false;
+        return true;
+    }
+
+    nlohmann::json sample;
+    try {
+        sample = nlohmann::json::parse(result);
+    } catch (const std::exception& e) {
+        std::cout << "Error sampling game state: " << e.what() << std::endl;
+        return false;
+    }
+    if (!sample.is_object()) {
+        return false;
+    }
+    // json.encode writes empty tables as arrays
+    auto player = sample.value("player", nlohmann::json::object());
+    auto economy = sample.value("economy", nlohmann::json::object());
+    if (!player.is_object()) {
+        player = nlohmann::json::object();
+    }
+    if (!economy.is_object()) {
+        economy = nlohmann::json::object();
+    }
+
+    out.playerChanged = !sampled_ || changed(player_, player);
+    out.economyChanged = !sampled_ || changed(economy_, economy);
+    lastResult_ = std::move(result);
+    player_ = std::move(player);
+    economy_ = std::move(economy);
+    sampled_ = true;
+    out.player = player_;
+    out.economy = economy_;
+    return true;
+}
+
+bool GameStateSampler::changed(const nlohmann::json& previous, const nlohmann::json& current) const {
+    // a clock moves on every sample; comparing it would make every sample a change
+    const auto withoutClocks = [this](nlohmann::json values) {
+        for (const auto& name : clocks_) {
+            values.erase(name);
+        }
+        return values;
+    };
+    return withoutClocks(previous) != withoutClocks(current);
+}
+
+std::vector<GameStateSampler::Metric> GameStateSampler::Select(const std::vector<Metric>& available,
+    const std::vector<std::string>& names) {
+    if (names.empty()) {
+        return available;
+    }
+    std::vector<Metric> selected;
+    for (const auto& name : names) {
+        auto it = std::find_if(available.begin(), available.end(),
+            [&name](const Metric& metric) { return metric.name == name; });
+        if (it == available.end()) {
+            std::cout << "Warning: unknown sampled metric \"" << name << "\"" << std::endl;
+            continue;
+        }
+        selected.push_back(*it);
+    }
+    return selected;
+}
@@ -0,0 +1,63 @@
+/*
+MIT License - Game State Sampler for X4 Foundations Multiplayer
+
+Reads the player and economy metrics the multiplayer client shares in one lua script, so a
+sample costs a single pass on the game thread instead of one FFI call per value. Keeps the
+previous sample and reports whether it changed, so the client only sends when something did.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+class GameStateSampler {
+public:
+    // Runs a lua script on the game thread and returns what it returned (executeLua with
+    // the json library)
+    using LuaRunner = std::function<std::string(const std::string& script)>;
+
+    struct Metric {
+        std::string name;
+        std::string luaExpression;
+        bool clock = false; // advances on its own; sent along, but not a change by itself
+    };
+
+    // Everything that can be sampled; a configuration picks metrics by name
+    static const std::vector<Metric>& PlayerMetrics();
+    static const std::vector<Metric>& EconomyMetrics();
+
+    struct Sample {
+        nlohmann::json player;   // metric name -> value, metrics that failed are absent
+        nlohmann::json economy;
+        bool playerChanged = false; // differs from the previous sample, clocks aside (always true for the first)
+        bool economyChanged = false;
+    };
+
+    /**
+     * samples the named metrics, all of a kind if its list is empty. Unknown names are
+     * skipped with a warning.
+     */
+    GameStateSampler(LuaRunner runLua, const std::vector<std::string>& playerMetrics,
+        const std::vector<std::string>& economyMetrics);
+
+    /**
+     * one pass over all metrics. False if the script could not run (no game loaded,
+     * game thread busy), in which case the previous sample is kept.
+     */
+    bool sample(Sample& out);
+
+private:
+    static std::vector<Metric> Select(const std::vector<Metric>& available,
+        const std::vector<std::string>& names);
+    bool changed(const nlohmann::json& previous, const nlohmann::json& current) const;
+
+    LuaRunner runLua_;
+    std::string script_;
+    std::vector<std::string> clocks_; // names of the selected clock metrics
+    std::string lastResult_; // raw script output, an unchanged game skips parsing
+    nlohmann::json player_;
+    nlohmann::json economy_;
+    bool sampled_ = false;
+};
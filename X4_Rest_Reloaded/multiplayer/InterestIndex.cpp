@@ -0,0 +1,159 @@
+/*
+MIT License - Player Interest Index Implementation
+*/
+
+#include "InterestIndex.h"
+#include <cmath>
+#include <mutex>
+
+std::string InterestIndex::update(const std::string& playerId, const std::string& sector, const nlohmann::json& position) {
+    if (position.is_object()) {
+        const auto x = position.find("x");
+        const auto y = position.find("y");
+        const auto z = position.find("z");
+        if (x != position.end() && y != position.end() && z != position.end()
+            && x->is_number() && y->is_number() && z->is_number()) {
+            return update(playerId, sector, x->get<double>(), y->get<double>(), z->get<double>());
+        }
+    }
+    Location location;
+    location.sector = sector;
+    return place(playerId, std::move(location));
+}
+
+std::string InterestIndex::update(const std::string& playerId, const std::string& sector, double x, double y, double z) {
+    Location location;
+    location.sector = sector;
+    // the grid cell is an int32 per axis; anything it can't hold has no usable position
+    const auto inRange = [](double value) { return std::abs(value) < MAX_COORDINATE; };
+    if (!inRange(x) || !inRange(y) || !inRange(z)) {
+        return place(playerId, std::move(location));
+    }
+    location.hasPosition = true;
+    location.x = x;
+    location.y = y;
+    location.z = z;
+    location.cell = CellKey(CellCoord(x), CellCoord(y), CellCoord(z));
+    return place(playerId, std::move(location));
+}
+
+std::string InterestIndex::place(const std::string& playerId, Location location) {
+    const auto& sector = location.sector;
+    std::unique_lock lock(mutex_);
+    std::string previous;
+    auto it = players_.find(playerId);
+    if (it != players_.end()) {
+        previous = it->second.sector;
+        unlink(playerId, it->second);
+    }
+    if (!sector.empty()) {
+        auto& entry = sectors_[sector];
+        entry.players.insert(playerId);
+        if (location.hasPosition) {
+            entry.cells[location.cell].insert(playerId);
+        }
+    }
+    players_.insert_or_assign(playerId, std::move(location));
+    return previous;
+}
+
+void InterestIndex::remove(const std::string& playerId) {
+    std::unique_lock lock(mutex_);
+    auto it = players_.find(playerId);
+    if (it == players_.end()) {
+        return;
+    }
+    unlink(playerId, it->second);
+    players_.erase(it);
+}
+
+std::vector<std::string> InterestIndex::inSector(const std::string& sector) const {
+    std::shared_lock lock(mutex_);
+    auto it = sectors_.find(sector);
+    if (it == sectors_.end()) {
+        return {};
+    }
+    return {it->second.players.begin(), it->second.players.end()};
+}
+
+std::vector<std::string> InterestIndex::near(const std::string& playerId, double radius) const {
+    std::shared_lock lock(mutex_);
+    auto self = players_.find(playerId);
+    if (self == players_.end() || self->second.sector.empty()) {
+        return {};
+    }
+    const auto& origin = self->second;
+    const auto& sector = sectors_.at(origin.sector);
+    if (!(radius > 0)) {
+        return {sector.players.begin(), sector.players.end()};
+    }
+    if (!origin.hasPosition) {
+        return {playerId};
+    }
+
+    std::vector<std::string> result;
+    const auto collect = [&](const std::unordered_set<std::string>& cell) {
+        for (const auto& id : cell) {
+            const auto& other = players_.at(id);
+            const auto dx = other.x - origin.x, dy = other.y - origin.y, dz = other.z - origin.z;
+            if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+                result.push_back(id);
+            }
+        }
+    };
+
+    // Probe the cells the radius covers, unless the sector has fewer occupied cells than that
+    const auto cells = std::ceil(radius / CELL_SIZE);
+    const auto reach = cells > 64 ? int64_t{65} : static_cast<int64_t>(cells);
+    const auto span = 2 * reach + 1;
+    if (reach > 64 || static_cast<size_t>(span * span * span) > sector.cells.size()) {
+        for (const auto& [key, cell] : sector.cells) {
+            collect(cell);
+        }
+        return result;
+    }
+    const auto cx = CellCoord(origin.x), cy = CellCoord(origin.y), cz = CellCoord(origin.z);
+    for (auto x = cx - reach; x <= cx + reach; ++x) {
+        for (auto y = cy - reach; y <= cy + reach; ++y) {
+            for (auto z = cz - reach; z <= cz + reach; ++z) {
+                auto it = sector.cells.find(CellKey(static_cast<int32_t>(x), static_cast<int32_t>(y), static_cast<int32_t>(z)));
+                if (it != sector.cells.end()) {
+                    collect(it->second);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+int32_t InterestIndex::CellCoord(double value) {
+    return static_cast<int32_t>(std::floor(value / CELL_SIZE));
+}
+
+uint64_t InterestIndex::CellKey(int32_t x, int32_t y, int32_t z) {
+    // 21 bits per axis is plenty at 10 km cells
+    constexpr uint64_t mask = (uint64_t{1} << 21) - 1;
+    return ((static_cast<uint64_t>(x) & mask) << 42) | ((static_cast<uint64_t>(y) & mask) << 21)
+        | (static_cast<uint64_t>(z) & mask);
+}
+
+void InterestIndex::unlink(const std::string& playerId, const Location& location) {
+    auto it = sectors_.find(location.sector);
+    if (it == sectors_.end()) {
+        return;
+    }
+    auto& sector = it->second;
+    sector.players.erase(playerId);
+    if (location.hasPosition) {
+        auto cell = sector.cells.find(location.cell);
+        if (cell != sector.cells.end()) {
+            cell->second.erase(playerId);
+            if (cell->second.empty()) {
+                sector.cells.erase(cell);
+            }
+        }
+    }
+    if (sector.players.empty()) {
+        sectors_.erase(it);
+    }
+}
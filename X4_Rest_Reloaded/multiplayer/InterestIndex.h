@@ -0,0 +1,63 @@
+/*
+MIT License - Player Interest Index for X4 Foundations Multiplayer
+
+Which players are where: sessions indexed by sector and, within a sector, by a coarse
+grid over their position (UIPosRot style x/y/z in meters). "Who is near me" then costs
+in proportion to the players around, not the total population.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class InterestIndex {
+public:
+    static constexpr double CELL_SIZE = 10000.0; // meters per grid cell edge
+    // positions further out than this on any axis (or not finite) are not gridded
+    static constexpr double MAX_COORDINATE = CELL_SIZE * (1 << 20);
+
+    /**
+     * moves the player to `sector`; `position` is used if it has numeric x, y and z
+     * within MAX_COORDINATE, otherwise the player is only placed in the sector.
+     * Returns the sector the player was in before, empty if none.
+     */
+    std::string update(const std::string& playerId, const std::string& sector, const nlohmann::json& position);
+    std::string update(const std::string& playerId, const std::string& sector, double x, double y, double z);
+
+    void remove(const std::string& playerId);
+
+    std::vector<std::string> inSector(const std::string& sector) const;
+
+    /**
+     * players in the same sector as `playerId`, including itself. With a radius > 0 only
+     * those with a known position within that distance of the player's.
+     */
+    std::vector<std::string> near(const std::string& playerId, double radius) const;
+
+private:
+    struct Location {
+        std::string sector;
+        bool hasPosition = false;
+        double x = 0, y = 0, z = 0;
+        uint64_t cell = 0;
+    };
+
+    struct Sector {
+        std::unordered_set<std::string> players;
+        std::unordered_map<uint64_t, std::unordered_set<std::string>> cells;
+    };
+
+    std::string place(const std::string& playerId, Location location);
+    static int32_t CellCoord(double value);
+    static uint64_t CellKey(int32_t x, int32_t y, int32_t z);
+    void unlink(const std::string& playerId, const Location& location);
+
+    std::unordered_map<std::string, Location> players_;
+    std::unordered_map<std::string, Sector> sectors_;
+    mutable std::shared_mutex mutex_;
+};
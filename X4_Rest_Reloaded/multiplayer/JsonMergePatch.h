@@ -0,0 +1,44 @@
+/*
+MIT License - JSON Merge Patch helpers for X4 Foundations Multiplayer
+
+RFC 7386 merge patches between two documents. Applying one is nlohmann's
+json::merge_patch; this adds the other direction.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+
+namespace mergepatch {
+
+/**
+ * The merge patch that turns `from` into `to`: changed members only, removed members
+ * as null, nested objects diffed recursively. An empty object means no change.
+ * Merge patches can't set a member to null, so null values in `to` read as removals.
+ */
+inline nlohmann::json Diff(const nlohmann::json& from, const nlohmann::json& to) {
+    if (!from.is_object() || !to.is_object()) {
+        return from == to ? nlohmann::json::object() : to;
+    }
+    auto patch = nlohmann::json::object();
+    for (const auto& [key, value] : from.items()) {
+        if (!to.contains(key)) {
+            patch[key] = nullptr;
+        }
+    }
+    for (const auto& [key, value] : to.items()) {
+        auto it = from.find(key);
+        if (it == from.end()) {
+            patch[key] = value;
+        } else if (it->is_object() && value.is_object()) {
+            auto nested = Diff(*it, value);
+            if (!nested.empty()) {
+                patch[key] = std::move(nested);
+            }
+        } else if (*it != value) {
+            patch[key] = value;
+        }
+    }
+    return patch;
+}
+
+} // namespace mergepatch
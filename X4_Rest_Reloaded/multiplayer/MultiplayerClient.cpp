@@ -3,14 +3,15 @@ MIT License - Multiplayer Client Implementation for X4 Foundations
 */
 
 #include "MultiplayerClient.h"
+#include "JsonMergePatch.h"
 #include "../ffi/FFIInvoke.h"
 #include <iostream>
 #include <random>
 #include <sstream>
 #include <iomanip>
 
-MultiplayerClient::MultiplayerClient(FFIInvoke& ffi_invoke) 
-    : ffi_invoke_(ffi_invoke), running_(false), connected_(false) {
+MultiplayerClient::MultiplayerClient(FFIInvoke& ffi_invoke, GameStateSampler::LuaRunner runLua) 
+    : ffi_invoke_(ffi_invoke), runLua_(std::move(runLua)), running_(false), connected_(false) {
     playerId_ = generatePlayerId();
 }
 
@@ -25,19 +26,27 @@ void MultiplayerClient::initialize(const MultiplayerConfig& config) {
         std::cout << "Multiplayer sync disabled in configuration" << std::endl;
         return;
     }
+    if (runLua_) {
+        sampler_ = std::make_unique<GameStateSampler>(runLua_, config_.playerMetrics, config_.economyMetrics);
+    }
     
     // Create HTTP client
     httpClient_ = std::make_unique<httplib::Client>(config_.serverHost, config_.serverPort);
     httpClient_->set_connection_timeout(CONNECTION_TIMEOUT);
     httpClient_->set_read_timeout(CONNECTION_TIMEOUT);
+    // Every tick goes to the same server; reuse the connection instead of a handshake each time
+    httpClient_->set_keep_alive(true);
     
     // Try to connect to server
     if (joinServer()) {
         running_ = true;
         
         // Start worker threads
-        heartbeatThread_ = std::thread(&MultiplayerClient::heartbeatWorker, this);
-        syncThread_ = std::thread(&MultiplayerClient::syncWorker, this);
+        samplerThread_ = std::thread(&MultiplayerClient::samplerWorker, this);
+        transportThread_ = std::thread(&MultiplayerClient::transportWorker, this);
+        if (config_.wsPort > 0) {
+            syncThread_ = std::thread(&MultiplayerClient::syncWorker, this);
+        }
         
         std::cout << "Multiplayer client initialized and connected to " 
                   << config_.serverHost << ":" << config_.serverPort << std::endl;
@@ -48,15 +57,36 @@ void MultiplayerClient::initialize(const MultiplayerConfig& config) {
 
 void MultiplayerClient::shutdown() {
     if (running_) {
-        running_ = false;
-        leaveServer();
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            running_ = false;
+        }
+        mailboxCv_.notify_all();
         
-        if (heartbeatThread_.joinable()) {
-            heartbeatThread_.join();
+        if (samplerThread_.joinable()) {
+            samplerThread_.join();
+        }
+        if (transportThread_.joinable()) {
+            transportThread_.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(wsMutex_);
+            if (wsClient_) {
+                std::error_code ec;
+                wsClient_->close(wsHdl_, websocketpp::close::status::going_away, "", ec);
+                if (ec) {
+                    // not open yet
+                    wsClient_->stop();
+                }
+            }
         }
         if (syncThread_.joinable()) {
             syncThread_.join();
         }
+        synced_ = false;
+        syncCache_.clear();
+        // after the workers, so the leave can't be overtaken by a tick still in flight
+        leaveServer();
         
         connected_ = false;
         std::cout << "Multiplayer client shut down" << std::endl;
@@ -67,19 +97,27 @@ bool MultiplayerClient::joinServer() {
     if (!httpClient_) return false;
     
     try {
-        nlohmann::json joinData = {
-            {"playerId", playerId_},
-            {"playerName", config_.playerName.empty() ? "Player_" + playerId_.substr(0, 8) : config_.playerName},
-            {"currentSector", ""},  // Will be filled by gatherPlayerData if available
-            {"position", nlohmann::json::object()},
-            {"playerData", gatherPlayerData()}
-        };
+        // Runs before the workers start, so the sampler is not in use yet
+        nlohmann::json playerData;
+        GameStateSampler::Sample game;
+        if (sampler_ && sampler_->sample(game)) {
+            playerData = std::move(game.player);
+        } else {
+            playerData = gatherPlayerData();
+        }
+        auto state = currentState(playerData);
+        nlohmann::json joinData = state;
+        joinData["playerId"] = playerId_;
         
+        std::lock_guard<std::mutex> lock(stateMutex_);
         auto response = httpClient_->Post("/mp/join", joinData.dump(), "application/json");
         
         if (response && response->status == 200) {
             auto responseData = nlohmann::json::parse(response->body);
             connected_ = responseData.value("success", false);
+            if (connected_) {
+                sentState_ = std::move(state);
+            }
             return connected_;
         }
     } catch (const std::exception& e) {
@@ -104,75 +142,6 @@ void MultiplayerClient::leaveServer() {
     }
 }
 
-void MultiplayerClient::sendHeartbeat() {
-    if (!httpClient_ || !connected_) return;
-    
-    try {
-        auto playerData = gatherPlayerData();
-        
-        nlohmann::json heartbeatData = {
-            {"playerId", playerId_},
-            {"currentSector", playerData.value("currentSector", "")},
-            {"position", playerData.value("position", nlohmann::json::object())}
-        };
-        
-        auto response = httpClient_->Post("/mp/heartbeat", heartbeatData.dump(), "application/json");
-        
-        if (!response || response->status != 200) {
-            connected_ = false;
-        }
-    } catch (const std::exception& e) {
-        std::cout << "Error sending heartbeat: " << e.what() << std::endl;
-        connected_ = false;
-    }
-}
-
-void MultiplayerClient::syncPlayerData() {
-    if (!httpClient_ || !connected_ || !config_.enablePlayerTracking) return;
-    
-    try {
-        auto playerData = gatherPlayerData();
-        
-        nlohmann::json updateData = {
-            {"playerId", playerId_},
-            {"playerName", config_.playerName},
-            {"currentSector", playerData.value("currentSector", "")},
-            {"position", playerData.value("position", nlohmann::json::object())},
-            {"playerData", playerData}
-        };
-        
-        auto response = httpClient_->Put("/mp/player/update", updateData.dump(), "application/json");
-        
-        if (!response || response->status != 200) {
-            connected_ = false;
-        }
-    } catch (const std::exception& e) {
-        std::cout << "Error syncing player data: " << e.what() << std::endl;
-    }
-}
-
-void MultiplayerClient::syncEconomyData() {
-    if (!httpClient_ || !connected_ || !config_.enableEconomySync) return;
-    
-    try {
-        auto economyData = gatherEconomyData();
-        
-        nlohmann::json updateData = {
-            {"economyData", economyData},
-            {"universeTime", std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count()}
-        };
-        
-        auto response = httpClient_->Put("/mp/economy", updateData.dump(), "application/json");
-        
-        if (!response || response->status != 200) {
-            std::cout << "Warning: Failed to sync economy data" << std::endl;
-        }
-    } catch (const std::exception& e) {
-        std::cout << "Error syncing economy data: " << e.what() << std::endl;
-    }
-}
-
 void MultiplayerClient::sendChatMessage(const std::string& message) {
     if (!httpClient_ || !connected_ || !config_.enableChat) return;
     
@@ -197,6 +166,9 @@ nlohmann::json MultiplayerClient::getChatMessages(int limit) {
     if (!httpClient_ || !connected_ || !config_.enableChat) {
         return nlohmann::json::array();
     }
+    if (synced_ && limit >= 0 && static_cast<size_t>(limit) <= SyncCache::CHAT_HISTORY) {
+        return syncCache_.chat(static_cast<size_t>(limit));
+    }
     
     try {
         std::string url = "/mp/chat?limit=" + std::to_string(limit);
@@ -216,6 +188,9 @@ nlohmann::json MultiplayerClient::getActivePlayers() {
     if (!httpClient_ || !connected_) {
         return nlohmann::json::object();
     }
+    if (synced_) {
+        return syncCache_.players();
+    }
     
     try {
         auto response = httpClient_->Get("/mp/players");
@@ -230,10 +205,53 @@ nlohmann::json MultiplayerClient::getActivePlayers() {
     return nlohmann::json::object();
 }
 
+nlohmann::json MultiplayerClient::getNearbyPlayers(double radius) {
+    if (!httpClient_ || !connected_) {
+        return nlohmann::json::object();
+    }
+    
+    try {
+        std::string url = "/mp/players?near=" + playerId_;
+        if (radius > 0) {
+            url += "&radius=" + std::to_string(radius);
+        }
+        auto response = httpClient_->Get(url);
+        
+        if (response && response->status == 200) {
+            return nlohmann::json::parse(response->body);
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error getting nearby players: " << e.what() << std::endl;
+    }
+    
+    return nlohmann::json::object();
+}
+
+nlohmann::json MultiplayerClient::getPlayerChanges(uint64_t sinceVersion) {
+    if (!httpClient_ || !connected_) {
+        return nlohmann::json::object();
+    }
+    
+    try {
+        auto response = httpClient_->Get("/mp/players/changes?since=" + std::to_string(sinceVersion));
+        
+        if (response && response->status == 200) {
+            return nlohmann::json::parse(response->body);
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error getting player changes: " << e.what() << std::endl;
+    }
+    
+    return nlohmann::json::object();
+}
+
 nlohmann::json MultiplayerClient::getUniverseState() {
     if (!httpClient_ || !connected_) {
         return nlohmann::json::object();
     }
+    if (synced_) {
+        return syncCache_.universe();
+    }
     
     try {
         auto response = httpClient_->Get("/mp/universe");
@@ -248,21 +266,315 @@ nlohmann::json MultiplayerClient::getUniverseState() {
     return nlohmann::json::object();
 }
 
-void MultiplayerClient::heartbeatWorker() {
+void MultiplayerClient::samplerWorker() {
+    // With the sampler the game is read every sampleIntervalMs, but only sent when it changed
+    // or to keep the session alive. Without it every read is sent, once per heartbeatInterval.
+    const auto keepalive = std::chrono::seconds(config_.heartbeatInterval);
+    const auto interval = sampler_ ? std::chrono::milliseconds(config_.sampleIntervalMs)
+        : std::chrono::duration_cast<std::chrono::milliseconds>(keepalive);
+    auto nextKeepalive = std::chrono::steady_clock::now();
+    auto nextEconomy = nextKeepalive;
+    nlohmann::json published; // the state last handed to the transport
+    nlohmann::json economyData;
+    bool economyDirty = false; // changed since it was last sent
     while (running_ && connected_) {
-        sendHeartbeat();
-        std::this_thread::sleep_for(std::chrono::seconds(config_.heartbeatInterval));
+        bool sampled = true;
+        bool playerChanged = true;
+        nlohmann::json playerData;
+        if (sampler_) {
+            GameStateSampler::Sample game;
+            sampled = sampler_->sample(game);
+            if (sampled) {
+                playerData = std::move(game.player);
+                playerChanged = game.playerChanged;
+                economyData = std::move(game.economy);
+                economyDirty = economyDirty || game.economyChanged;
+            }
+        } else {
+            playerData = gatherPlayerData();
+            economyDirty = true;
+        }
+        
+        TickSample sample;
+        sample.state = nlohmann::json::object();
+        bool changed = false;
+        if (sampled && playerChanged) {
+            if (config_.enablePlayerTracking) {
+                sample.state = currentState(playerData);
+            } else {
+                sample.state = {
+                    {"currentSector", playerData.value("currentSector", "")},
+                    {"position", playerData.value("position", nlohmann::json::object())}
+                };
+            }
+            changed = sample.state != published;
+        }
+        
+        const auto now = std::chrono::steady_clock::now();
+        if (config_.enableEconomySync && economyDirty && now >= nextEconomy) {
+            sample.economy = {
+                {"economyData", sampler_ ? economyData : gatherEconomyData()},
+                {"universeTime", std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count()}
+            };
+            economyDirty = false;
+            nextEconomy = now + std::chrono::seconds(config_.syncInterval);
+        }
+        
+        // An unchanged game costs the sample and nothing else; the keepalive is a tick
+        // without a patch
+        if (changed || !sample.economy.is_null() || now >= nextKeepalive) {
+            if (changed) {
+                published = sample.state;
+            }
+            publish(std::move(sample));
+            nextKeepalive = now + keepalive;
+        }
+        
+        std::unique_lock<std::mutex> lock(mailboxMutex_);
+        mailboxCv_.wait_for(lock, interval, [this] {
+            return !running_;
+        });
+    }
+}
+
+void MultiplayerClient::publish(TickSample sample) {
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex_);
+        if (mailbox_) {
+            // the newer state supersedes the pending one, but what only the pending one
+            // carries still has to go out: the economy, or the state if this is a keepalive
+            if (sample.economy.is_null()) {
+                sample.economy = std::move(mailbox_->economy);
+            }
+            if (sample.state.empty()) {
+                sample.state = std::move(mailbox_->state);
+            }
+        }
+        mailbox_ = std::move(sample);
+    }
+    mailboxCv_.notify_all();
+}
+
+void MultiplayerClient::transportWorker() {
+    while (true) {
+        TickSample sample;
+        {
+            std::unique_lock<std::mutex> lock(mailboxMutex_);
+            mailboxCv_.wait(lock, [this] {
+                return mailbox_.has_value() || !running_ || !connected_;
+            });
+            if (!mailbox_ || !running_ || !connected_) {
+                return;
+            }
+            sample = std::move(*mailbox_);
+            mailbox_.reset();
+        }
+        if (!sendTick(sample)) {
+            std::lock_guard<std::mutex> lock(mailboxMutex_);
+            connected_ = false;
+            mailboxCv_.notify_all();
+        }
     }
 }
 
+bool MultiplayerClient::sendTick(const TickSample& sample) {
+    try {
+        // Diff against what the server acknowledged, limited to the fields this sample covers
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        auto acknowledged = nlohmann::json::object();
+        for (const auto& [key, value] : sample.state.items()) {
+            if (sentState_.contains(key)) {
+                acknowledged[key] = sentState_[key];
+            }
+        }
+        auto patch = mergepatch::Diff(acknowledged, sample.state);
+        
+        nlohmann::json tickData = {
+            {"playerId", playerId_}
+        };
+        if (!patch.is_object() || !patch.empty()) {
+            tickData["patch"] = std::move(patch);
+        }
+        if (!sample.economy.is_null()) {
+            tickData["economy"] = sample.economy;
+        }
+        
+        auto response = httpClient_->Post("/mp/tick", tickData.dump(), "application/json");
+        
+        if (!response || response->status != 200) {
+            return false;
+        }
+        sentState_.update(sample.state);
+        return true;
+    } catch (const std::exception& e) {
+        std::cout << "Error sending tick: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+nlohmann::json MultiplayerClient::currentState(const nlohmann::json& playerData) {
+    // sector and position have their own fields; left in playerData every move would
+    // become a versioned playerData change
+    auto data = playerData;
+    data.erase("currentSector");
+    data.erase("position");
+    return {
+        {"playerName", displayName()},
+        {"currentSector", playerData.value("currentSector", "")},
+        {"position", playerData.value("position", nlohmann::json::object())},
+        {"playerData", std::move(data)}
+    };
+}
+
 void MultiplayerClient::syncWorker() {
+    const auto uri = "ws://" + config_.serverHost + ":" + std::to_string(config_.wsPort);
     while (running_ && connected_) {
-        syncPlayerData();
-        syncEconomyData();
-        std::this_thread::sleep_for(std::chrono::seconds(config_.syncInterval));
+        WebSocketClient client;
+        client.clear_access_channels(websocketpp::log::alevel::all);
+        client.clear_error_channels(websocketpp::log::elevel::all);
+        client.init_asio();
+        client.set_open_handler([this, &client](websocketpp::connection_hdl hdl) {
+            onSyncOpen(client, hdl);
+        });
+        client.set_message_handler([this](websocketpp::connection_hdl, WebSocketClient::message_ptr msg) {
+            onSyncMessage(msg->get_payload());
+        });
+        
+        std::error_code ec;
+        auto connection = client.get_connection(uri, ec);
+        if (!ec) {
+            client.connect(connection);
+            bool run = false;
+            {
+                // shutdown clears running_ before it looks for a session to close
+                std::lock_guard<std::mutex> lock(wsMutex_);
+                wsClient_ = &client;
+                wsHdl_ = connection->get_handle();
+                run = running_;
+            }
+            if (run) {
+                client.run(); // until the connection closes
+            }
+            std::lock_guard<std::mutex> lock(wsMutex_);
+            wsClient_ = nullptr;
+        }
+        synced_ = false;
+        
+        std::unique_lock<std::mutex> lock(mailboxMutex_);
+        mailboxCv_.wait_for(lock, RECONNECT_DELAY, [this] {
+            return !running_;
+        });
     }
 }
 
+void MultiplayerClient::onSyncOpen(WebSocketClient& client, websocketpp::connection_hdl hdl) {
+    std::error_code ec;
+    nlohmann::json subscribe = {
+        {"type", "subscribe"},
+        {"eventTypes", {"player_state", "player_position", "universe_update", "chat_message"}}
+    };
+    client.send(hdl, subscribe.dump(), websocketpp::frame::opcode::text, ec);
+    
+    // Events are already being pushed to this connection, but are only handled after this
+    // returns, so nothing between the snapshot and them is missed
+    if (!ec && catchUpPlayers() && catchUpUniverse() && catchUpChat()) {
+        synced_ = true;
+    } else {
+        client.close(hdl, websocketpp::close::status::normal, "sync failed", ec);
+    }
+}
+
+void MultiplayerClient::onSyncMessage(const std::string& payload) {
+    try {
+        auto message = nlohmann::json::parse(payload);
+        if (message.value("type", "") != "event") {
+            return;
+        }
+        const auto eventType = message.value("eventType", "");
+        const auto& data = message["data"];
+        
+        if (eventType == "player_state") {
+            // missed or overtaken by a later change; the server's log has the ones in between
+            if (syncCache_.applyPlayerChange(data) == SyncCache::Apply::Gap && !catchUpPlayers()) {
+                synced_ = false;
+            }
+        } else if (eventType == "player_position") {
+            syncCache_.updatePosition(data.at("playerId").get<std::string>(), data.at("position"));
+        } else if (eventType == "universe_update") {
+            syncCache_.updateUniverse(data);
+        } else if (eventType == "chat_message") {
+            if (data.value("seq", uint64_t{0}) > syncCache_.latestChatSeq() + 1) {
+                catchUpChat();
+            }
+            syncCache_.addChatMessage(data);
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error handling sync event: " << e.what() << std::endl;
+    }
+}
+
+bool MultiplayerClient::catchUpPlayers() {
+    try {
+        while (true) {
+            const auto since = syncCache_.hasPlayers() ? syncCache_.playersVersion() : 0;
+            auto response = httpClient_->Get("/mp/players/changes?since=" + std::to_string(since));
+            if (!response || response->status != 200) {
+                return false;
+            }
+            auto body = nlohmann::json::parse(response->body);
+            if (body.value("reset", false)) {
+                syncCache_.resetPlayers(body["players"], body["version"].get<uint64_t>());
+                return true;
+            }
+            for (const auto& change : body["changes"]) {
+                syncCache_.applyPlayerChange(change);
+            }
+            if (!body.value("more", false)) {
+                return true;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error catching up player states: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+bool MultiplayerClient::catchUpUniverse() {
+    try {
+        auto response = httpClient_->Get("/mp/universe");
+        if (response && response->status == 200) {
+            syncCache_.updateUniverse(nlohmann::json::parse(response->body));
+            return true;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error catching up universe state: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+bool MultiplayerClient::catchUpChat() {
+    if (!config_.enableChat) {
+        return true;
+    }
+    try {
+        std::string url = "/mp/chat?limit=" + std::to_string(SyncCache::CHAT_HISTORY);
+        if (const auto since = syncCache_.latestChatSeq(); since > 0) {
+            url += "&since=" + std::to_string(since);
+        }
+        auto response = httpClient_->Get(url);
+        if (response && response->status == 200) {
+            for (const auto& message : nlohmann::json::parse(response->body)["messages"]) {
+                syncCache_.addChatMessage(message);
+            }
+            return true;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error catching up chat: " << e.what() << std::endl;
+    }
+    return false;
+}
+
 nlohmann::json MultiplayerClient::gatherPlayerData() {
     nlohmann::json playerData = nlohmann::json::object();
     
@@ -356,6 +668,10 @@ nlohmann::json MultiplayerClient::gatherEconomyData() {
     return economyData;
 }
 
+std::string MultiplayerClient::displayName() const {
+    return config_.playerName.empty() ? "Player_" + playerId_.substr(0, 8) : config_.playerName;
+}
+
 std::string MultiplayerClient::generatePlayerId() {
     // Generate a simple unique player ID
     std::random_device rd;
@@ -6,13 +6,21 @@ It connects to a multiplayer coordination server to share game state.
 */
 
 #pragma once
+#include "GameStateSampler.h"
+#include "SyncCache.h"
 #include <httplib.h>
 #include <nlohmann/json.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
 #include <string>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 class FFIInvoke;
 
@@ -21,64 +29,117 @@ public:
     struct MultiplayerConfig {
         std::string serverHost = "localhost";
         int serverPort = 3003;
+        int wsPort = 3004; // server pushes state changes here; 0 to read over REST instead
         bool enableSync = false;
         int heartbeatInterval = 30; // seconds
         int syncInterval = 60; // seconds
+        // How often the game is sampled when a lua runner was given; only changes are sent,
+        // plus a keepalive every heartbeatInterval
+        int sampleIntervalMs = 1000;
+        std::vector<std::string> playerMetrics; // GameStateSampler metric names, empty = all
+        std::vector<std::string> economyMetrics;
         std::string playerName;
         bool enableChat = true;
         bool enableEconomySync = true;
         bool enablePlayerTracking = true;
     };
 
-    explicit MultiplayerClient(FFIInvoke& ffi_invoke);
+    // With `runLua` the game state is read in one batched lua pass (GameStateSampler),
+    // otherwise with individual FFI calls
+    explicit MultiplayerClient(FFIInvoke& ffi_invoke, GameStateSampler::LuaRunner runLua = {});
     ~MultiplayerClient();
 
     void initialize(const MultiplayerConfig& config);
     void shutdown();
     
     bool isConnected() const { return connected_; }
+    // True while the WebSocket session keeps the sync cache current
+    bool isSynced() const { return synced_; }
+    const SyncCache& getSyncCache() const { return syncCache_; }
     const MultiplayerConfig& getConfig() const { return config_; }
 
     // Player session management
     bool joinServer();
     void leaveServer();
-    void sendHeartbeat();
-    
-    // Data synchronization
-    void syncPlayerData();
-    void syncEconomyData();
     
     // Chat functionality
     void sendChatMessage(const std::string& message);
+    // from the sync cache while synced
     nlohmann::json getChatMessages(int limit = 50);
     
-    // Get other players' data
+    // Get other players' data; players and universe come from the sync cache while synced.
+    // Without a cache getActivePlayers fetches every player, prefer getNearbyPlayers
     nlohmann::json getActivePlayers();
+    // Player state changes after `sinceVersion`, or full states if 0 or too old
+    nlohmann::json getPlayerChanges(uint64_t sinceVersion);
+    // Players in our sector, within `radius` meters if > 0
+    nlohmann::json getNearbyPlayers(double radius = 0);
     nlohmann::json getUniverseState();
 
 private:
-    void heartbeatWorker();
+    // One tick's worth of game state, handed from the sampler to the transport
+    struct TickSample {
+        nlohmann::json state;   // currentSector, position and, with player tracking, the rest
+        nlohmann::json economy; // null unless economy sync is due this tick
+    };
+    
+    // The sampler reads the game and never waits on the network; the transport sends
+    // whatever sample is newest as one /mp/tick request
+    void samplerWorker();
+    void transportWorker();
+    void publish(TickSample sample);
+    bool sendTick(const TickSample& sample);
+    nlohmann::json currentState(const nlohmann::json& playerData);
+    
+    // WebSocket session to wsPort, reconnecting until shutdown. Each time it opens the cache
+    // catches up over REST, then follows the pushed events.
+    typedef websocketpp::client<websocketpp::config::asio_client> WebSocketClient;
     void syncWorker();
+    void onSyncOpen(WebSocketClient& client, websocketpp::connection_hdl hdl);
+    void onSyncMessage(const std::string& payload);
+    bool catchUpPlayers();
+    bool catchUpUniverse();
+    bool catchUpChat();
     
     // Helper functions to gather X4 game data
     nlohmann::json gatherPlayerData();
     nlohmann::json gatherEconomyData();
     std::string generatePlayerId();
+    std::string displayName() const;
     
     // HTTP client for server communication
     std::unique_ptr<httplib::Client> httpClient_;
     
     FFIInvoke& ffi_invoke_;
+    GameStateSampler::LuaRunner runLua_;
+    std::unique_ptr<GameStateSampler> sampler_; // used by the sampler thread only
     MultiplayerConfig config_;
     std::string playerId_;
     
     std::atomic<bool> running_;
     std::atomic<bool> connected_;
     
-    std::thread heartbeatThread_;
+    std::thread samplerThread_;
+    std::thread transportThread_;
+    
+    // Latest wins: a sample the transport hasn't picked up yet is replaced by a newer one
+    std::optional<TickSample> mailbox_;
+    std::mutex mailboxMutex_;
+    std::condition_variable mailboxCv_;
+    
+    SyncCache syncCache_;
+    std::atomic<bool> synced_{false};
     std::thread syncThread_;
+    WebSocketClient* wsClient_ = nullptr; // the session's endpoint while it runs
+    websocketpp::connection_hdl wsHdl_;
+    std::mutex wsMutex_; // guards wsClient_ and wsHdl_
     
     mutable std::mutex clientMutex_;
     
+    // Player state as the server last acknowledged it; only the difference is sent
+    nlohmann::json sentState_;
+    std::mutex stateMutex_;
+    
     static constexpr auto CONNECTION_TIMEOUT = std::chrono::seconds(10);
+    static constexpr auto RECONNECT_DELAY = std::chrono::seconds(5);
 };
\ No newline at end of file
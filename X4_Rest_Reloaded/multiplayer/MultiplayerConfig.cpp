@@ -72,6 +72,7 @@ MultiplayerConfig::Config MultiplayerConfig::getDefaultConfig() {
     config.client.autoConnect = false;
     config.client.heartbeatInterval = 30;
     config.client.syncInterval = 60;
+    config.client.sampleIntervalMs = 1000;
     config.client.enableChat = true;
     config.client.enableEconomySync = true;
     config.client.enablePlayerTracking = true;
@@ -114,6 +115,7 @@ MultiplayerConfig::ServerConfig MultiplayerConfig::serverConfigFromJson(const nl
     config.enableEconomySync = json.value("enableEconomySync", true);
     config.enablePlayerTracking = json.value("enablePlayerTracking", true);
     config.heartbeatTimeout = json.value("heartbeatTimeout", 300);
+    config.eventBatchWindowMs = json.value("eventBatchWindowMs", 0);
     
     return config;
 }
@@ -128,6 +130,9 @@ MultiplayerConfig::ClientConfig MultiplayerConfig::clientConfigFromJson(const nl
     config.autoConnect = json.value("autoConnect", false);
     config.heartbeatInterval = json.value("heartbeatInterval", 30);
     config.syncInterval = json.value("syncInterval", 60);
+    config.sampleIntervalMs = json.value("sampleIntervalMs", 1000);
+    config.playerMetrics = json.value("playerMetrics", std::vector<std::string>{});
+    config.economyMetrics = json.value("economyMetrics", std::vector<std::string>{});
     config.enableChat = json.value("enableChat", true);
     config.enableEconomySync = json.value("enableEconomySync", true);
     config.enablePlayerTracking = json.value("enablePlayerTracking", true);
@@ -144,7 +149,8 @@ nlohmann::json MultiplayerConfig::serverConfigToJson(const ServerConfig& config)
         {"enableChat", config.enableChat},
         {"enableEconomySync", config.enableEconomySync},
         {"enablePlayerTracking", config.enablePlayerTracking},
-        {"heartbeatTimeout", config.heartbeatTimeout}
+        {"heartbeatTimeout", config.heartbeatTimeout},
+        {"eventBatchWindowMs", config.eventBatchWindowMs}
     };
 }
 
@@ -157,6 +163,9 @@ nlohmann::json MultiplayerConfig::clientConfigToJson(const ClientConfig& config)
         {"autoConnect", config.autoConnect},
         {"heartbeatInterval", config.heartbeatInterval},
         {"syncInterval", config.syncInterval},
+        {"sampleIntervalMs", config.sampleIntervalMs},
+        {"playerMetrics", config.playerMetrics},
+        {"economyMetrics", config.economyMetrics},
         {"enableChat", config.enableChat},
         {"enableEconomySync", config.enableEconomySync},
         {"enablePlayerTracking", config.enablePlayerTracking}
@@ -8,6 +8,7 @@ Handles configuration loading/saving for multiplayer functionality.
 #include <nlohmann/json.hpp>
 #include <string>
 #include <fstream>
+#include <vector>
 
 class MultiplayerConfig {
 public:
@@ -35,6 +36,7 @@ public:
         // Event notification settings
         bool enableEventNotifications = true;
         int eventQueueMaxSize = 1000;
+        int eventBatchWindowMs = 0; // wait this long after an event to batch more, 0 = dispatch immediately
         
         // Enhanced economy settings
         bool enableDetailedEconomySync = true;
@@ -54,6 +56,9 @@ public:
         bool autoConnect = false;
         int heartbeatInterval = 30; // seconds
         int syncInterval = 60; // seconds
+        int sampleIntervalMs = 1000; // game state sampling; only changes are sent
+        std::vector<std::string> playerMetrics; // metrics to share, empty = all
+        std::vector<std::string> economyMetrics;
         bool enableChat = true;
         bool enableEconomySync = true;
         bool enablePlayerTracking = true;
@@ -3,17 +3,30 @@ MIT License - Multiplayer Coordination Server Implementation for X4 Foundations
 */
 
 #include "MultiplayerServer.h"
+#include "JsonMergePatch.h"
+#include "../httpserver/QueryParams.h"
+#include "../metrics/HttpMetrics.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <random>
 
 MultiplayerServer::MultiplayerServer(int port) 
-    : port_(port), running_(false) {
-    universe_.universeTime = 0;
+    : port_(port), running_(false),
+      playerTimeoutSeconds_(std::chrono::seconds(DEFAULT_PLAYER_TIMEOUT).count()),
+      activePlayersGauge_(metrics::Registry::instance().gauge(
+          "x4mp_active_players", "Players with an active session")),
+      sessionsExpired_(metrics::Registry::instance().counter(
+          "x4mp_sessions_expired_total", "Sessions removed after missing heartbeats")) {
     universe_.globalEconomyData = nlohmann::json::object();
     universe_.factionRelations = nlohmann::json::object();
 }
 
+MultiplayerServer::MultiplayerServer(const MultiplayerConfig::ServerConfig& config)
+    : MultiplayerServer(config.serverPort) {
+    MultiplayerServer::applyConfig(config);
+}
+
 MultiplayerServer::~MultiplayerServer() {
     stop();
 }
@@ -51,56 +64,77 @@ void MultiplayerServer::stop() {
     std::cout << "Multiplayer coordination server stopped" << std::endl;
 }
 
+void MultiplayerServer::applyConfig(const MultiplayerConfig::ServerConfig& config) {
+    // existing sessions pick up the new timeout the next time their expiry entry is due
+    playerTimeoutSeconds_ = std::max(1, config.heartbeatTimeout);
+}
+
 void MultiplayerServer::setupEndpoints() {
     // Enable CORS for web clients
     server_.set_default_headers(httplib::Headers{{"Access-Control-Allow-Origin", "*"}});
     
+    // Request metrics + Prometheus /metrics
+    metrics::InstrumentServer(server_, "x4mp");
+    
     // Player session management
-    server_.Post("/mp/join", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/join", [this](const httplib::Request& req, httplib::Response& res) {
         handlePlayerJoin(req, res);
     });
     
-    server_.Post("/mp/leave", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/leave", [this](const httplib::Request& req, httplib::Response& res) {
         handlePlayerLeave(req, res);
     });
     
-    server_.Post("/mp/heartbeat", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/heartbeat", [this](const httplib::Request& req, httplib::Response& res) {
         handlePlayerHeartbeat(req, res);
     });
     
-    server_.Put("/mp/player/update", [this](const httplib::Request& req, httplib::Response& res) {
+    // heartbeat + state patch + economy in one round trip
+    routes_.Post("/mp/tick", [this](const httplib::Request& req, httplib::Response& res) {
+        handleTick(req, res);
+    });
+    
+    routes_.Put("/mp/player/update", [this](const httplib::Request& req, httplib::Response& res) {
         handlePlayerUpdate(req, res);
     });
     
+    routes_.Patch("/mp/player/state", [this](const httplib::Request& req, httplib::Response& res) {
+        handlePlayerStatePatch(req, res);
+    });
+    
     // Universe state queries
-    server_.Get("/mp/players", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/mp/players", [this](const httplib::Request& req, httplib::Response& res) {
         handleGetActivePlayers(req, res);
     });
     
-    server_.Get("/mp/universe", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/mp/players/changes", [this](const httplib::Request& req, httplib::Response& res) {
+        handleGetPlayerChanges(req, res);
+    });
+    
+    routes_.Get("/mp/universe", [this](const httplib::Request& req, httplib::Response& res) {
         handleGetUniverseState(req, res);
     });
     
     // Economy synchronization
-    server_.Put("/mp/economy", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Put("/mp/economy", [this](const httplib::Request& req, httplib::Response& res) {
         handleUpdateEconomy(req, res);
     });
     
     // Chat system
-    server_.Post("/mp/chat", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Post("/mp/chat", [this](const httplib::Request& req, httplib::Response& res) {
         handleSendChatMessage(req, res);
     });
     
-    server_.Get("/mp/chat", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/mp/chat", [this](const httplib::Request& req, httplib::Response& res) {
         handleGetChatMessages(req, res);
     });
     
     // Server info
-    server_.Get("/mp/info", [this](const httplib::Request& req, httplib::Response& res) {
+    routes_.Get("/mp/info", [this](const httplib::Request& req, httplib::Response& res) {
         nlohmann::json info = {
             {"serverVersion", "1.0.0"},
             {"activePlayers", universe_.activePlayers.size()},
-            {"universeTime", universe_.universeTime},
+            {"universeTime", universe_.universeTime.load()},
             {"uptime", running_ ? "running" : "stopped"}
         };
         res.set_content(info.dump(), "application/json");
@@ -113,8 +147,6 @@ void MultiplayerServer::handlePlayerJoin(const httplib::Request& req, httplib::R
         std::string playerId = body["playerId"];
         std::string playerName = body["playerName"];
         
-        std::lock_guard<std::mutex> lock(universe_.universeMutex);
-        
         PlayerSession session;
         session.playerId = playerId;
         session.playerName = playerName;
@@ -122,14 +154,33 @@ void MultiplayerServer::handlePlayerJoin(const httplib::Request& req, httplib::R
         session.position = body.value("position", nlohmann::json::object());
         session.lastHeartbeat = std::chrono::steady_clock::now();
         session.playerData = body.value("playerData", nlohmann::json::object());
-        
-        universe_.activePlayers[playerId] = session;
+        session.sessionId = nextSessionId_++;
+        session.bindToken = GenerateBindToken();
+        const auto sessionId = session.sessionId;
+        const auto bindToken = session.bindToken;
+        
+        expiryWheel_.schedule(playerId, session.sessionId,
+            session.lastHeartbeat + std::chrono::seconds(playerTimeoutSeconds_.load()));
+        const auto sector = session.currentSector;
+        const auto position = session.position;
+        uint64_t version = 0;
+        std::string previousSector;
+        universe_.activePlayers.upsert(std::move(session), [&](PlayerSession& stored) {
+            // a rejoin replaces the whole state
+            version = stored.stateVersion = logStateReplaced(playerId, StateOf(stored));
+            previousSector = indexPlayer(stored);
+        });
+        activePlayersGauge_.set(universe_.activePlayers.size());
+        onPlayerMoved(playerId, previousSector, sector, position);
         
         nlohmann::json response = {
             {"success", true},
             {"playerId", playerId},
             {"message", "Player joined successfully"},
-            {"activePlayers", universe_.activePlayers.size()}
+            {"activePlayers", universe_.activePlayers.size()},
+            {"version", version},
+            {"sessionId", sessionId},
+            {"bindToken", bindToken}
         };
         
         res.set_content(response.dump(), "application/json");
@@ -150,11 +201,13 @@ void MultiplayerServer::handlePlayerLeave(const httplib::Request& req, httplib::
         auto body = nlohmann::json::parse(req.body);
         std::string playerId = body["playerId"];
         
-        std::lock_guard<std::mutex> lock(universe_.universeMutex);
-        
-        auto it = universe_.activePlayers.find(playerId);
-        if (it != universe_.activePlayers.end()) {
-            universe_.activePlayers.erase(it);
+        auto removed = universe_.activePlayers.extractIf(playerId, [&](const PlayerSession&) {
+            logStateRemoved(playerId);
+            universe_.interest.remove(playerId);
+            return true;
+        });
+        if (removed) {
+            activePlayersGauge_.set(universe_.activePlayers.size());
         }
         
         nlohmann::json response = {
@@ -181,24 +234,11 @@ void MultiplayerServer::handlePlayerHeartbeat(const httplib::Request& req, httpl
         auto body = nlohmann::json::parse(req.body);
         std::string playerId = body["playerId"];
         
-        std::lock_guard<std::mutex> lock(universe_.universeMutex);
-        
-        auto it = universe_.activePlayers.find(playerId);
-        if (it != universe_.activePlayers.end()) {
-            it->second.lastHeartbeat = std::chrono::steady_clock::now();
-            
-            // Update basic player data if provided
-            if (body.contains("currentSector")) {
-                it->second.currentSector = body["currentSector"];
-            }
-            if (body.contains("position")) {
-                it->second.position = body["position"];
-            }
-        }
+        heartbeatPlayer(playerId, body);
         
         nlohmann::json response = {
             {"success", true},
-            {"universeTime", universe_.universeTime}
+            {"universeTime", universe_.universeTime.load()}
         };
         
         res.set_content(response.dump(), "application/json");
@@ -214,29 +254,61 @@ void MultiplayerServer::handlePlayerHeartbeat(const httplib::Request& req, httpl
     }
 }
 
+bool MultiplayerServer::heartbeatPlayer(const std::string& playerId, nlohmann::json& body) {
+    if (body.contains("currentSector") && !body["currentSector"].is_string()) {
+        throw std::invalid_argument("currentSector must be a string");
+    }
+    // Only this player's shard is locked; the body was parsed outside of it
+    const bool moved = body.contains("currentSector") || body.contains("position");
+    std::string sector;
+    std::string previousSector;
+    nlohmann::json position;
+    auto fields = nlohmann::json::object();
+    if (body.contains("currentSector")) {
+        fields["currentSector"] = std::move(body["currentSector"]);
+    }
+    if (body.contains("position")) {
+        fields["position"] = std::move(body["position"]);
+    }
+    const bool found = universe_.activePlayers.update(playerId, [&](PlayerSession& session) {
+        session.lastHeartbeat = std::chrono::steady_clock::now();
+        
+        // Update basic player data if provided
+        applyPlayerFields(session, fields);
+        if (moved) {
+            sector = session.currentSector;
+            position = session.position;
+            previousSector = indexPlayer(session);
+        }
+    });
+    if (found && moved) {
+        onPlayerMoved(playerId, previousSector, sector, position);
+    }
+    return found;
+}
+
 void MultiplayerServer::handlePlayerUpdate(const httplib::Request& req, httplib::Response& res) {
     try {
         auto body = nlohmann::json::parse(req.body);
         std::string playerId = body["playerId"];
         
-        std::lock_guard<std::mutex> lock(universe_.universeMutex);
-        
-        auto it = universe_.activePlayers.find(playerId);
-        if (it != universe_.activePlayers.end()) {
-            it->second.lastHeartbeat = std::chrono::steady_clock::now();
+        const bool moved = body.contains("currentSector") || body.contains("position");
+        std::string sector;
+        std::string previousSector;
+        nlohmann::json position;
+        const bool found = universe_.activePlayers.update(playerId, [&](PlayerSession& session) {
+            session.lastHeartbeat = std::chrono::steady_clock::now();
             
-            if (body.contains("playerName")) {
-                it->second.playerName = body["playerName"];
-            }
-            if (body.contains("currentSector")) {
-                it->second.currentSector = body["currentSector"];
-            }
-            if (body.contains("position")) {
-                it->second.position = body["position"];
-            }
-            if (body.contains("playerData")) {
-                it->second.playerData = body["playerData"];
+            // Replaces the fields given; only the difference goes into the state log
+            applyPlayerFields(session, body);
+            if (moved) {
+                sector = session.currentSector;
+                position = session.position;
+                previousSector = indexPlayer(session);
             }
+        });
+        if (found && moved) {
+            onPlayerMoved(playerId, previousSector, sector, position);
         }
         
         nlohmann::json response = {
@@ -258,62 +330,125 @@ void MultiplayerServer::handlePlayerUpdate(const httplib::Request& req, httplib:
 }
 
 void MultiplayerServer::handleGetActivePlayers(const httplib::Request& req, httplib::Response& res) {
-    std::lock_guard<std::mutex> lock(universe_.universeMutex);
-    
     nlohmann::json players = nlohmann::json::array();
-    for (const auto& [playerId, session] : universe_.activePlayers) {
+    const auto add = [&players](const PlayerSession& session) {
         players.push_back({
             {"playerId", session.playerId},
             {"playerName", session.playerName},
             {"currentSector", session.currentSector},
             {"position", session.position},
-            {"playerData", session.playerData}
+            {"playerData", session.playerData},
+            {"stateVersion", session.stateVersion}
         });
+    };
+    // taken first: the states read below are at least this recent
+    const auto version = universe_.stateLog.latestVersion();
+    
+    // near=<playerId> (optionally radius=<meters>) or sector=<name> only look at the
+    // players indexed there; without either every player is returned
+    if (req.has_param("near") || req.has_param("sector")) {
+        std::vector<std::string> ids;
+        if (req.has_param("near")) {
+            double radius = 0;
+            if (req.has_param("radius") && query::Parse(req.get_param_value("radius"), radius)) {
+                radius = std::clamp(radius, 0.0, MAX_NEAR_RADIUS);
+            }
+            ids = universe_.interest.near(req.get_param_value("near"), radius);
+        } else {
+            ids = universe_.interest.inSector(req.get_param_value("sector"));
+        }
+        for (const auto& id : ids) {
+            universe_.activePlayers.read(id, add);
+        }
+    } else {
+        universe_.activePlayers.forEach(add);
     }
     
     nlohmann::json response = {
-        {"players", players},
-        {"count", universe_.activePlayers.size()}
+        {"count", players.size()},
+        {"version", version},
+        {"players", std::move(players)}
     };
     
     res.set_content(response.dump(), "application/json");
     res.status = 200;
 }
 
-void MultiplayerServer::handleGetUniverseState(const httplib::Request& req, httplib::Response& res) {
-    std::lock_guard<std::mutex> lock(universe_.universeMutex);
-    
-    nlohmann::json response = {
-        {"universeTime", universe_.universeTime},
-        {"activePlayers", universe_.activePlayers.size()},
-        {"globalEconomy", universe_.globalEconomyData},
-        {"factionRelations", universe_.factionRelations}
-    };
-    
-    res.set_content(response.dump(), "application/json");
-    res.status = 200;
+void MultiplayerServer::handlePlayerStatePatch(const httplib::Request& req, httplib::Response& res) {
+    try {
+        auto body = nlohmann::json::parse(req.body);
+        std::string playerId = body["playerId"];
+        
+        const auto version = patchPlayerState(playerId, body["patch"]);
+        if (!version) {
+            nlohmann::json error = {
+                {"success", false},
+                {"error", "Player not found"}
+            };
+            res.set_content(error.dump(), "application/json");
+            res.status = 404;
+            return;
+        }
+        
+        nlohmann::json response = {
+            {"success", true},
+            {"version", *version}
+        };
+        
+        res.set_content(response.dump(), "application/json");
+        res.status = 200;
+        
+    } catch (const std::exception& e) {
+        nlohmann::json error = {
+            {"success", false},
+            {"error", e.what()}
+        };
+        res.set_content(error.dump(), "application/json");
+        res.status = 400;
+    }
 }
 
-void MultiplayerServer::handleUpdateEconomy(const httplib::Request& req, httplib::Response& res) {
+void MultiplayerServer::handleTick(const httplib::Request& req, httplib::Response& res) {
     try {
         auto body = nlohmann::json::parse(req.body);
+        std::string playerId = body["playerId"];
         
-        std::lock_guard<std::mutex> lock(universe_.universeMutex);
+        // One request per client tick: the heartbeat, and optionally what changed in the
+        // player state and the client's economy view. All of it is checked first, so a
+        // malformed part doesn't leave the rest applied and broadcast.
+        if (body.contains("patch")) {
+            ValidateStatePatch(body["patch"]);
+        }
+        if (body.contains("economy")) {
+            ValidateEconomy(body["economy"]);
+        }
         
-        if (body.contains("economyData")) {
-            universe_.globalEconomyData = body["economyData"];
+        std::optional<uint64_t> version;
+        if (body.contains("patch")) {
+            version = patchPlayerState(playerId, body["patch"]);
+        } else if (heartbeatPlayer(playerId, body)) {
+            version = 0;
         }
-        if (body.contains("factionRelations")) {
-            universe_.factionRelations = body["factionRelations"];
+        if (!version) {
+            nlohmann::json error = {
+                {"success", false},
+                {"error", "Player not found"}
+            };
+            res.set_content(error.dump(), "application/json");
+            res.status = 404;
+            return;
         }
-        if (body.contains("universeTime")) {
-            universe_.universeTime = body["universeTime"];
+        if (body.contains("economy")) {
+            updateEconomy(body["economy"]);
         }
         
         nlohmann::json response = {
             {"success", true},
-            {"message", "Economy data updated"}
+            {"universeTime", universe_.universeTime.load()}
         };
+        if (*version > 0) {
+            response["version"] = *version;
+        }
         
         res.set_content(response.dump(), "application/json");
         res.status = 200;
@@ -328,30 +463,285 @@ void MultiplayerServer::handleUpdateEconomy(const httplib::Request& req, httplib
     }
 }
 
-void MultiplayerServer::handleSendChatMessage(const httplib::Request& req, httplib::Response& res) {
+void MultiplayerServer::ValidateStatePatch(const nlohmann::json& patch) {
+    if (!patch.is_object()) {
+        throw std::invalid_argument("patch must be an object");
+    }
+    for (const auto& [key, value] : patch.items()) {
+        if (key == "playerName" || key == "currentSector") {
+            if (!value.is_string() && !value.is_null()) {
+                throw std::invalid_argument(key + " must be a string");
+            }
+        } else if (key != "position" && key != "playerData") {
+            throw std::invalid_argument("unknown state field: " + key);
+        }
+    }
+}
+
+std::optional<uint64_t> MultiplayerServer::patchPlayerState(const std::string& playerId, nlohmann::json& patch) {
+    // Checked up front so a bad patch changes nothing
+    ValidateStatePatch(patch);
+    
+    const bool moved = patch.contains("currentSector") || patch.contains("position");
+    std::string sector;
+    std::string previousSector;
+    nlohmann::json position;
+    uint64_t version = 0;
+    const bool found = universe_.activePlayers.update(playerId, [&](PlayerSession& session) {
+        session.lastHeartbeat = std::chrono::steady_clock::now();
+        
+        // A null field is reset to "" or {} here, where merge_patch would drop it, so the log
+        // gets what actually changed rather than the patch as sent
+        auto logged = nlohmann::json::object();
+        for (auto& [key, value] : patch.items()) {
+            if (key == "playerName" || key == "currentSector") {
+                auto& target = key == "playerName" ? session.playerName : session.currentSector;
+                auto updated = value.is_null() ? std::string() : value.get<std::string>();
+                if (updated != target) {
+                    logged[key] = updated;
+                    target = std::move(updated);
+                }
+            } else {
+                auto& target = key == "position" ? session.position : session.playerData;
+                auto updated = target;
+                if (value.is_null()) {
+                    updated = nlohmann::json::object();
+                } else {
+                    updated.merge_patch(value);
+                }
+                // positions go out as player_position events, not as versioned changes
+                auto diff = key == "position" ? nlohmann::json::object()
+                                              : mergepatch::Diff(target, updated);
+                if (!diff.is_object() || !diff.empty()) {
+                    logged[key] = std::move(diff);
+                }
+                target = std::move(updated);
+            }
+        }
+        if (!logged.empty()) {
+            session.stateVersion = logStatePatched(playerId, logged);
+        }
+        version = session.stateVersion;
+        if (moved) {
+            sector = session.currentSector;
+            position = session.position;
+            previousSector = indexPlayer(session);
+        }
+    });
+    if (!found) {
+        return std::nullopt;
+    }
+    if (moved) {
+        onPlayerMoved(playerId, previousSector, sector, position);
+    }
+    return version;
+}
+
+void MultiplayerServer::handleGetPlayerChanges(const httplib::Request& req, httplib::Response& res) {
+    uint64_t since = 0;
+    if (req.has_param("since")) {
+        query::Parse(req.get_param_value("since"), since);
+    }
+    
+    // Changes are stored serialized, the response is assembled from that text
+    auto log = universe_.stateLog.read(since, MAX_STATE_CHANGES);
+    // a `since` ahead of the log means the server restarted
+    if (since > 0 && since <= log.latestVersion && since + 1 >= log.oldestVersion) {
+        std::string response;
+        response.reserve(log.changes.size() + 96);
+        response.append("{\"reset\":false,\"version\":").append(std::to_string(log.latestVersion));
+        response.append(",\"changes\":").append(log.changes);
+        response.append(",\"count\":").append(std::to_string(log.count));
+        response.append(",\"more\":").append(log.more ? "true" : "false");
+        response.push_back('}');
+        res.set_content(std::move(response), "application/json");
+        res.status = 200;
+        return;
+    }
+    
+    // First read, or the changes since then were already overwritten: full states instead.
+    // The version is taken first, so replaying later changes on top stays correct.
+    const auto version = universe_.stateLog.latestVersion();
+    auto players = nlohmann::json::object();
+    universe_.activePlayers.forEach([&](const PlayerSession& session) {
+        players[session.playerId] = StateOf(session);
+    });
+    
+    nlohmann::json response = {
+        {"reset", true},
+        {"version", version},
+        {"players", std::move(players)}
+    };
+    res.set_content(response.dump(), "application/json");
+    res.status = 200;
+}
+
+nlohmann::json MultiplayerServer::StateOf(const PlayerSession& session) {
+    return {
+        {"playerName", session.playerName},
+        {"currentSector", session.currentSector},
+        {"position", session.position},
+        {"playerData", session.playerData}
+    };
+}
+
+void MultiplayerServer::applyPlayerFields(PlayerSession& session, nlohmann::json& fields) {
+    auto patch = nlohmann::json::object();
+    const auto setString = [&](const char* key, std::string& target) {
+        auto it = fields.find(key);
+        if (it == fields.end()) {
+            return;
+        }
+        auto value = it->get<std::string>();
+        if (value != target) {
+            patch[key] = value;
+            target = std::move(value);
+        }
+    };
+    const auto setObject = [&](const char* key, nlohmann::json& target) {
+        auto it = fields.find(key);
+        if (it == fields.end()) {
+            return;
+        }
+        auto diff = mergepatch::Diff(target, *it);
+        if (!diff.is_object() || !diff.empty()) {
+            patch[key] = std::move(diff);
+        }
+        target = std::move(*it);
+    };
+    setString("playerName", session.playerName);
+    setString("currentSector", session.currentSector);
+    setObject("playerData", session.playerData);
+    // like streamed positions not versioned; every move is pushed as player_position
+    if (auto it = fields.find("position"); it != fields.end()) {
+        session.position = std::move(*it);
+    }
+    
+    if (!patch.empty()) {
+        session.stateVersion = logStatePatched(session.playerId, patch);
+    }
+}
+
+void MultiplayerServer::handleGetUniverseState(const httplib::Request& req, httplib::Response& res) {
+    nlohmann::json response = {
+        {"universeTime", universe_.universeTime.load()},
+        {"activePlayers", universe_.activePlayers.size()}
+    };
+    {
+        std::shared_lock<std::shared_mutex> lock(universe_.economyMutex);
+        response["globalEconomy"] = universe_.globalEconomyData;
+        response["factionRelations"] = universe_.factionRelations;
+    }
+    
+    res.set_content(response.dump(), "application/json");
+    res.status = 200;
+}
+
+void MultiplayerServer::handleUpdateEconomy(const httplib::Request& req, httplib::Response& res) {
     try {
         auto body = nlohmann::json::parse(req.body);
+        updateEconomy(body);
+        
+        nlohmann::json response = {
+            {"success", true},
+            {"message", "Economy data updated"}
+        };
         
-        std::lock_guard<std::mutex> lock(universe_.universeMutex);
+        res.set_content(response.dump(), "application/json");
+        res.status = 200;
         
-        nlohmann::json message = {
-            {"playerId", body["playerId"]},
-            {"playerName", body["playerName"]},
-            {"message", body["message"]},
-            {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count()}
+    } catch (const std::exception& e) {
+        nlohmann::json error = {
+            {"success", false},
+            {"error", e.what()}
         };
+        res.set_content(error.dump(), "application/json");
+        res.status = 400;
+    }
+}
+
+void MultiplayerServer::ValidateEconomy(const nlohmann::json& body) {
+    if (!body.is_object()) {
+        throw std::invalid_argument("economy update must be an object");
+    }
+    if (body.contains("universeTime") && !body["universeTime"].is_number_unsigned()) {
+        throw std::invalid_argument("universeTime must be a non-negative integer");
+    }
+}
+
+void MultiplayerServer::updateEconomy(nlohmann::json& body) {
+    ValidateEconomy(body);
+    // what was replaced, named as in /mp/universe
+    auto changes = nlohmann::json::object();
+    if (body.contains("universeTime")) {
+        universe_.universeTime = body["universeTime"].get<uint64_t>();
+        changes["universeTime"] = universe_.universeTime.load();
+    }
+    
+    {
+        std::lock_guard<std::shared_mutex> lock(universe_.economyMutex);
         
-        universe_.chatMessages.push_back(message);
+        if (body.contains("economyData")) {
+            universe_.globalEconomyData = std::move(body["economyData"]);
+            changes["globalEconomy"] = universe_.globalEconomyData;
+        }
+        if (body.contains("factionRelations")) {
+            universe_.factionRelations = std::move(body["factionRelations"]);
+            changes["factionRelations"] = universe_.factionRelations;
+        }
+    }
+    if (!changes.empty()) {
+        onUniverseChanged(changes);
+    }
+}
+
+uint64_t MultiplayerServer::logStatePatched(const std::string& playerId, const nlohmann::json& patch) {
+    return universe_.stateLog.patched(playerId, patch, [&](uint64_t version) {
+        onPlayerStateChanged({{"version", version}, {"playerId", playerId}, {"patch", patch}});
+    });
+}
+
+uint64_t MultiplayerServer::logStateReplaced(const std::string& playerId, const nlohmann::json& state) {
+    return universe_.stateLog.replaced(playerId, state, [&](uint64_t version) {
+        onPlayerStateChanged({{"version", version}, {"playerId", playerId}, {"state", state}});
+    });
+}
+
+uint64_t MultiplayerServer::logStateRemoved(const std::string& playerId) {
+    return universe_.stateLog.removed(playerId, [&](uint64_t version) {
+        onPlayerStateChanged({{"version", version}, {"playerId", playerId}, {"removed", true}});
+    });
+}
+
+void MultiplayerServer::handleSendChatMessage(const httplib::Request& req, httplib::Response& res) {
+    try {
+        auto body = nlohmann::json::parse(req.body);
         
-        // Keep only the last MAX_CHAT_MESSAGES messages
-        if (universe_.chatMessages.size() > MAX_CHAT_MESSAGES) {
-            universe_.chatMessages.erase(universe_.chatMessages.begin());
+        // Rooms are free-form ("global", "sector:<id>", a faction channel, ...)
+        std::string room = body.value("room", ChatRingBuffer::DEFAULT_ROOM);
+        if (room.empty() || room.size() > MAX_CHAT_ROOM_LENGTH) {
+            throw std::invalid_argument("room must be 1-" + std::to_string(MAX_CHAT_ROOM_LENGTH) + " characters");
         }
         
+        const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        auto seq = universe_.chat.append(room, body.at("playerId").get<std::string>(),
+            body.at("playerName").get<std::string>(), body.at("message").get<std::string>(), timestamp,
+            [&](uint64_t assigned) {
+                onChatMessage({
+                    {"seq", assigned},
+                    {"room", room},
+                    {"playerId", body["playerId"]},
+                    {"playerName", body["playerName"]},
+                    {"message", body["message"]},
+                    {"timestamp", timestamp}
+                });
+            });
+        
         nlohmann::json response = {
             {"success", true},
-            {"message", "Chat message sent"}
+            {"message", "Chat message sent"},
+            {"seq", seq}
         };
         
         res.set_content(response.dump(), "application/json");
@@ -368,53 +758,142 @@ void MultiplayerServer::handleSendChatMessage(const httplib::Request& req, httpl
 }
 
 void MultiplayerServer::handleGetChatMessages(const httplib::Request& req, httplib::Response& res) {
-    std::lock_guard<std::mutex> lock(universe_.universeMutex);
-    
     int limit = 50; // Default limit
     if (req.has_param("limit")) {
-        try {
-            limit = std::stoi(req.get_param_value("limit"));
-            limit = std::min(limit, static_cast<int>(MAX_CHAT_MESSAGES));
-        } catch (...) {
-            // Use default limit if parsing fails
+        // Use default limit if parsing fails
+        if (query::Parse(req.get_param_value("limit"), limit)) {
+            limit = std::clamp(limit, 0, static_cast<int>(MAX_CHAT_MESSAGES));
         }
     }
-    
-    nlohmann::json messages = nlohmann::json::array();
-    int start = std::max(0, static_cast<int>(universe_.chatMessages.size()) - limit);
-    
-    for (int i = start; i < static_cast<int>(universe_.chatMessages.size()); ++i) {
-        messages.push_back(universe_.chatMessages[i]);
+    // since=<seq> returns only newer messages, oldest first
+    uint64_t since = 0;
+    if (req.has_param("since")) {
+        query::Parse(req.get_param_value("since"), since);
     }
+    const auto room = req.get_param_value("room");
     
-    nlohmann::json response = {
-        {"messages", messages},
-        {"count", messages.size()}
-    };
+    // Messages are stored serialized, the response is assembled from that text
+    auto chat = universe_.chat.read(since, static_cast<size_t>(limit), room);
+    std::string response;
+    response.reserve(chat.messages.size() + 96);
+    response.append("{\"messages\":").append(chat.messages);
+    response.append(",\"count\":").append(std::to_string(chat.count));
+    response.append(",\"latestSeq\":").append(std::to_string(chat.latestSeq));
+    response.append(",\"oldestSeq\":").append(std::to_string(chat.oldestSeq));
+    response.push_back('}');
     
-    res.set_content(response.dump(), "application/json");
+    res.set_content(std::move(response), "application/json");
     res.status = 200;
 }
 
 void MultiplayerServer::heartbeatWorker() {
     while (running_) {
-        std::this_thread::sleep_for(HEARTBEAT_INTERVAL);
-        cleanupInactivePlayers();
+        std::this_thread::sleep_for(EXPIRY_TICK);
+        expireInactivePlayers();
     }
 }
 
-void MultiplayerServer::cleanupInactivePlayers() {
-    std::lock_guard<std::mutex> lock(universe_.universeMutex);
-    
-    auto now = std::chrono::steady_clock::now();
-    auto it = universe_.activePlayers.begin();
+void MultiplayerServer::expireInactivePlayers() {
+    // Heartbeats only touch their session; the wheel holds one entry per session
+    // and an entry that comes due is checked against the last heartbeat, then either
+    // expires the session or is pushed back to the new deadline
+    const auto now = std::chrono::steady_clock::now();
+    const auto timeout = std::chrono::seconds(playerTimeoutSeconds_.load());
     
-    while (it != universe_.activePlayers.end()) {
-        if (now - it->second.lastHeartbeat > PLAYER_TIMEOUT) {
-            std::cout << "Removing inactive player: " << it->second.playerName << " (" << it->first << ")" << std::endl;
-            it = universe_.activePlayers.erase(it);
-        } else {
-            ++it;
+    bool expiredAny = false;
+    for (auto& entry : expiryWheel_.advance(now)) {
+        std::chrono::steady_clock::time_point renewAt{};
+        auto expired = universe_.activePlayers.extractIf(entry.playerId, [&](const PlayerSession& session) {
+            if (session.sessionId != entry.sessionId) {
+                return false; // left, or rejoined with a new entry
+            }
+            if (now - session.lastHeartbeat >= timeout) {
+                logStateRemoved(session.playerId);
+                universe_.interest.remove(session.playerId);
+                return true;
+            }
+            renewAt = session.lastHeartbeat + timeout;
+            return false;
+        });
+        
+        if (expired) {
+            expiredAny = true;
+            sessionsExpired_.inc();
+            onPlayerExpired(*expired);
+        } else if (renewAt != std::chrono::steady_clock::time_point{}) {
+            expiryWheel_.schedule(std::move(entry.playerId), entry.sessionId, renewAt);
+        }
+    }
+    if (expiredAny) {
+        activePlayersGauge_.set(universe_.activePlayers.size());
+    }
+}
+
+bool MultiplayerServer::applyStreamedFrame(const std::string& playerId, const wire::Frame& frame, std::string& sector) {
+    const bool isPosition = frame.type == wire::MessageType::Position;
+    bool current = false;
+    bool sectorChanged = false;
+    std::string previousSector;
+    nlohmann::json position;
+    universe_.activePlayers.update(playerId, [&](PlayerSession& session) {
+        if (session.sessionId != frame.sessionId) {
+            return;
+        }
+        current = true;
+        session.lastHeartbeat = std::chrono::steady_clock::now();
+        if (isPosition) {
+            // assigned member by member, so an existing position object is reused
+            if (!session.position.is_object()) {
+                session.position = nlohmann::json::object();
+            }
+            auto& target = session.position;
+            target["x"] = frame.pose.x;
+            target["y"] = frame.pose.y;
+            target["z"] = frame.pose.z;
+            target["pitch"] = frame.pose.pitch;
+            target["yaw"] = frame.pose.yaw;
+            target["roll"] = frame.pose.roll;
+            if (frame.hasSector && frame.sector != session.currentSector) {
+                session.currentSector.assign(frame.sector);
+                session.stateVersion = logStatePatched(playerId, {{"currentSector", session.currentSector}});
+                sectorChanged = true;
+                position = session.position;
+                previousSector = indexPlayer(session);
+            } else {
+                // within a sector only the index is updated
+                universe_.interest.update(playerId, session.currentSector,
+                    frame.pose.x, frame.pose.y, frame.pose.z);
+            }
         }
+        sector = session.currentSector;
+    });
+    if (!current) {
+        return false;
+    }
+    
+    // A new sector goes through the regular move
+    if (sectorChanged) {
+        onPlayerMoved(playerId, previousSector, sector, position);
     }
-}
\ No newline at end of file
+    return true;
+}
+
+std::string MultiplayerServer::indexPlayer(const PlayerSession& session) {
+    return universe_.interest.update(session.playerId, session.currentSector, session.position);
+}
+
+std::string MultiplayerServer::GenerateBindToken() {
+    std::random_device rd;
+    std::uniform_int_distribution<> dis(0, 255);
+    
+    std::stringstream ss;
+    for (size_t i = 0; i < BIND_TOKEN_BYTES; ++i) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << dis(rd);
+    }
+    
+    return ss.str();
+}
+
+void MultiplayerServer::onPlayerExpired(const PlayerSession& session) {
+    std::cout << "Removing inactive player: " << session.playerName << " (" << session.playerId << ")" << std::endl;
+}
@@ -13,47 +13,126 @@ allowing players to share universe state without modifying the core game.
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <optional>
 #include <vector>
 
+#include "../metrics/HttpMetrics.h"
+#include "../metrics/Metrics.h"
+#include "BinaryProtocol.h"
+#include "ChatRingBuffer.h"
+#include "InterestIndex.h"
+#include "MultiplayerConfig.h"
+#include "PlayerSessionStore.h"
+#include "PlayerStateLog.h"
+#include "SessionExpiryWheel.h"
+
 class MultiplayerServer {
 public:
-    struct PlayerSession {
-        std::string playerId;
-        std::string playerName;
-        std::string currentSector;
-        nlohmann::json position;
-        std::chrono::steady_clock::time_point lastHeartbeat;
-        nlohmann::json playerData;
-    };
+    using PlayerSession = ::PlayerSession;
+
+    static constexpr size_t CHAT_HISTORY = 1024; // messages kept for since= reads
+    static constexpr size_t PLAYER_STATE_HISTORY = 8192; // state changes kept for since= reads
 
+    // players, economy and chat each have their own synchronization so that heartbeats
+    // scale with cores instead of queueing behind roster dumps and chat posts
     struct SharedUniverse {
-        std::unordered_map<std::string, PlayerSession> activePlayers;
+        PlayerSessionStore activePlayers;
+        InterestIndex interest; // where the active players are
+        PlayerStateLog stateLog{PLAYER_STATE_HISTORY}; // versioned changes to activePlayers
         nlohmann::json globalEconomyData;
         nlohmann::json factionRelations;
-        std::vector<nlohmann::json> chatMessages;
-        uint64_t universeTime;
-        std::mutex universeMutex;
+        std::shared_mutex economyMutex; // globalEconomyData, factionRelations
+        ChatRingBuffer chat{CHAT_HISTORY};
+        std::atomic<uint64_t> universeTime{0};
     };
 
     explicit MultiplayerServer(int port = 3003);
-    ~MultiplayerServer();
+    // on config.serverPort, with applyConfig(config) already done
+    explicit MultiplayerServer(const MultiplayerConfig::ServerConfig& config);
+    virtual ~MultiplayerServer();
 
-    void start();
-    void stop();
+    virtual void start();
+    virtual void stop();
+    
+    // takes settings that apply to a running server (session timeout)
+    virtual void applyConfig(const MultiplayerConfig::ServerConfig& config);
     
     bool isRunning() const { return running_; }
     int getPort() const { return port_; }
 
-private:
+protected:
     void setupEndpoints();
-    void cleanupInactivePlayers();
+    void expireInactivePlayers();
     void heartbeatWorker();
+    
+    // called after a session timed out and was removed
+    virtual void onPlayerExpired(const PlayerSession& session);
+    
+    // Shared by the single purpose endpoints and /mp/tick
+    // refreshes the session with the sector/position in `body`; false if the player is unknown,
+    // throws std::invalid_argument for a non-string sector
+    bool heartbeatPlayer(const std::string& playerId, nlohmann::json& body);
+    // applies a merge patch to the player state, returns the new version or nullopt if the
+    // player is unknown; throws std::invalid_argument for a malformed patch. A position
+    // change alone doesn't take a version, see applyPlayerFields
+    std::optional<uint64_t> patchPlayerState(const std::string& playerId, nlohmann::json& patch);
+    // economyData, factionRelations, universeTime; throws std::invalid_argument before
+    // changing anything if `body` is malformed
+    void updateEconomy(nlohmann::json& body);
+    // The checks patchPlayerState and updateEconomy start with, so /mp/tick can check the
+    // whole body before applying any part of it
+    static void ValidateStatePatch(const nlohmann::json& patch);
+    static void ValidateEconomy(const nlohmann::json& body);
+    
+    // Player state (name, sector, position, playerData) as in the state log; a full state
+    // carries the position as of then, later moves are not versioned
+    static nlohmann::json StateOf(const PlayerSession& session);
+    // random secret handed to the joining client only, see PlayerSession::bindToken
+    static std::string GenerateBindToken();
+    // sets the fields present in `fields` and logs what changed, except the position: that
+    // changes with nearly every heartbeat and already goes out as player_position, sector
+    // filtered. Caller holds the session's lock
+    void applyPlayerFields(PlayerSession& session, nlohmann::json& fields);
+    
+    // Heartbeat or position streamed over the binary protocol. Updates the session in place;
+    // streamed positions are not versioned, sector changes are. Returns false if `sessionId`
+    // is no longer the player's session, otherwise `sector` is the player's current sector.
+    bool applyStreamedFrame(const std::string& playerId, const wire::Frame& frame, std::string& sector);
+    
+    // reindexes the player's location, returns the sector it was in before. Called with the
+    // session locked, so a move racing a leave or expiry can't put the player back.
+    std::string indexPlayer(const PlayerSession& session);
+    
+    // (playerId, previousSector, sector, position), called when a join, heartbeat or update
+    // reported a sector or position; previousSector is empty for a new session
+    virtual void onPlayerMoved(const std::string&, const std::string&, const std::string&,
+        const nlohmann::json&) {}
+    
+    // State log entries; each one is also passed to onPlayerStateChanged.
+    // Return the version assigned.
+    uint64_t logStatePatched(const std::string& playerId, const nlohmann::json& patch);
+    uint64_t logStateReplaced(const std::string& playerId, const nlohmann::json& state);
+    uint64_t logStateRemoved(const std::string& playerId);
+    
+    // called with each state change as listed by /mp/players/changes, while the state log
+    // is locked, so changes arrive in version order; must not read the state log
+    virtual void onPlayerStateChanged(const nlohmann::json&) {}
+    // called with the fields of /mp/universe that an economy update replaced
+    virtual void onUniverseChanged(const nlohmann::json&) {}
+    // called with each chat message as listed by /mp/chat, in seq order (while the chat
+    // buffer is locked)
+    virtual void onChatMessage(const nlohmann::json&) {}
 
     // API Endpoints
     void handlePlayerJoin(const httplib::Request& req, httplib::Response& res);
     void handlePlayerLeave(const httplib::Request& req, httplib::Response& res);
     void handlePlayerHeartbeat(const httplib::Request& req, httplib::Response& res);
     void handlePlayerUpdate(const httplib::Request& req, httplib::Response& res);
+    void handlePlayerStatePatch(const httplib::Request& req, httplib::Response& res);
+    void handleGetPlayerChanges(const httplib::Request& req, httplib::Response& res);
+    void handleTick(const httplib::Request& req, httplib::Response& res);
     void handleGetActivePlayers(const httplib::Request& req, httplib::Response& res);
     void handleGetUniverseState(const httplib::Request& req, httplib::Response& res);
     void handleUpdateEconomy(const httplib::Request& req, httplib::Response& res);
@@ -61,13 +140,23 @@ private:
     void handleGetChatMessages(const httplib::Request& req, httplib::Response& res);
 
     httplib::Server server_;
+    metrics::InstrumentedRoutes routes_{server_}; // register handlers here, see InstrumentServer
     SharedUniverse universe_;
     int port_;
-    bool running_;
+    std::atomic<bool> running_;
     std::thread serverThread_;
     std::thread heartbeatThread_;
+    SessionExpiryWheel expiryWheel_{EXPIRY_TICK};
+    std::atomic<int64_t> playerTimeoutSeconds_;
+    std::atomic<uint64_t> nextSessionId_{1};
+    metrics::Gauge& activePlayersGauge_;
+    metrics::Counter& sessionsExpired_;
     
-    static constexpr auto PLAYER_TIMEOUT = std::chrono::minutes(5);
-    static constexpr auto HEARTBEAT_INTERVAL = std::chrono::seconds(30);
-    static constexpr size_t MAX_CHAT_MESSAGES = 100;
+    static constexpr auto DEFAULT_PLAYER_TIMEOUT = std::chrono::minutes(5);
+    static constexpr auto EXPIRY_TICK = std::chrono::seconds(1);
+    static constexpr size_t MAX_CHAT_MESSAGES = 100; // per read
+    static constexpr size_t MAX_CHAT_ROOM_LENGTH = 64;
+    static constexpr size_t MAX_STATE_CHANGES = 500; // per changes read
+    static constexpr double MAX_NEAR_RADIUS = 1e6; // meters, for /mp/players?near=&radius=
+    static constexpr size_t BIND_TOKEN_BYTES = 16;
 };
\ No newline at end of file
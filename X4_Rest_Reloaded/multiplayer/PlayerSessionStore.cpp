@@ -0,0 +1,17 @@
+/*
+MIT License - Sharded Player Session Store Implementation
+*/
+
+#include "PlayerSessionStore.h"
+
+bool PlayerSessionStore::erase(std::string_view playerId) {
+    auto& shard = shardFor(playerId);
+    std::unique_lock lock(shard.mutex);
+    const auto it = shard.sessions.find(playerId);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    shard.sessions.erase(it);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
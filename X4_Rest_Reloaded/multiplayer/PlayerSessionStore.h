@@ -0,0 +1,155 @@
+/*
+MIT License - Sharded Player Session Store for X4 Foundations Multiplayer
+
+Player sessions spread over independently locked shards, so heartbeats and updates
+from different players don't contend on one lock.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+struct PlayerSession {
+    std::string playerId;
+    std::string playerName;
+    std::string currentSector;
+    nlohmann::json position;
+    std::chrono::steady_clock::time_point lastHeartbeat;
+    nlohmann::json playerData;
+    uint64_t sessionId = 0; // unique per join, tells a rejoin apart from the old session
+    std::string bindToken; // secret from the join response, required to bind a WebSocket; never listed
+    uint64_t stateVersion = 0; // version of the last change in the player state log
+};
+
+class PlayerSessionStore {
+public:
+    static constexpr size_t SHARD_BITS = 5;
+    static constexpr size_t SHARDS = size_t{1} << SHARD_BITS;
+
+    /**
+     * inserts or replaces the session for session.playerId, returns true if it is new
+     */
+    bool upsert(PlayerSession session) {
+        return upsert(std::move(session), [](PlayerSession&) {});
+    }
+
+    /**
+     * like upsert(session), running `fn(PlayerSession&)` on the stored session under the
+     * same write lock
+     */
+    template <typename Fn> bool upsert(PlayerSession session, Fn&& fn) {
+        auto& shard = shardFor(session.playerId);
+        std::unique_lock lock(shard.mutex);
+        auto id = session.playerId;
+        const auto [ it, inserted ] = shard.sessions.insert_or_assign(std::move(id), std::move(session));
+        if (inserted) {
+            size_.fetch_add(1, std::memory_order_relaxed);
+        }
+        fn(it->second);
+        return inserted;
+    }
+
+    /**
+     * removes the session, returns true if it existed
+     */
+    bool erase(std::string_view playerId);
+
+    /**
+     * runs `fn(PlayerSession&)` on the session under its shard's write lock,
+     * returns false if the player has no session
+     */
+    template <typename Fn> bool update(std::string_view playerId, Fn&& fn) {
+        auto& shard = shardFor(playerId);
+        std::unique_lock lock(shard.mutex);
+        const auto it = shard.sessions.find(playerId);
+        if (it == shard.sessions.end()) {
+            return false;
+        }
+        fn(it->second);
+        return true;
+    }
+
+    /**
+     * runs `fn(const PlayerSession&)` on the session under its shard's read lock,
+     * returns false if the player has no session
+     */
+    template <typename Fn> bool read(std::string_view playerId, Fn&& fn) const {
+        const auto& shard = shardFor(playerId);
+        std::shared_lock lock(shard.mutex);
+        const auto it = shard.sessions.find(playerId);
+        if (it == shard.sessions.end()) {
+            return false;
+        }
+        fn(it->second);
+        return true;
+    }
+
+    /**
+     * visits every session, read-locking one shard at a time: consistent per shard,
+     * not across the whole store
+     */
+    template <typename Fn> void forEach(Fn&& fn) const {
+        for (const auto& shard : shards_) {
+            std::shared_lock lock(shard.mutex);
+            for (const auto& [ id, session ] : shard.sessions) {
+                fn(session);
+            }
+        }
+    }
+
+    /**
+     * removes and returns the session if `pred(const PlayerSession&)` holds for it,
+     * checked under the same write lock as the removal
+     */
+    template <typename Pred>
+    std::optional<PlayerSession> extractIf(std::string_view playerId, Pred&& pred) {
+        auto& shard = shardFor(playerId);
+        std::unique_lock lock(shard.mutex);
+        const auto it = shard.sessions.find(playerId);
+        if (it == shard.sessions.end() || !pred(std::as_const(it->second))) {
+            return std::nullopt;
+        }
+        auto session = std::move(it->second);
+        shard.sessions.erase(it);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return session;
+    }
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+    // lets find() take a string_view without building a std::string per lookup
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, PlayerSession, Hash, std::equal_to<>> sessions;
+    };
+
+    // top bits of a multiplicatively mixed hash: the maps inside use the low bits
+    static size_t ShardIndex(std::string_view playerId) {
+        const auto hash = static_cast<uint64_t>(Hash{}(playerId));
+        return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS));
+    }
+    Shard& shardFor(std::string_view playerId) { return shards_[ ShardIndex(playerId) ]; }
+    const Shard& shardFor(std::string_view playerId) const {
+        return shards_[ ShardIndex(playerId) ];
+    }
+
+    std::array<Shard, SHARDS> shards_;
+    std::atomic<size_t> size_{0};
+};
@@ -0,0 +1,75 @@
+/*
+MIT License - Player State Change Log Implementation
+*/
+
+#include "PlayerStateLog.h"
+#include <algorithm>
+#include <mutex>
+
+PlayerStateLog::PlayerStateLog(size_t capacity) : records_(std::max<size_t>(capacity, 1)) {}
+
+uint64_t PlayerStateLog::patched(const std::string& playerId, const nlohmann::json& patch,
+    const Appended& appended) {
+    return append(playerId, "patch", patch, appended);
+}
+
+uint64_t PlayerStateLog::replaced(const std::string& playerId, const nlohmann::json& state,
+    const Appended& appended) {
+    return append(playerId, "state", state, appended);
+}
+
+uint64_t PlayerStateLog::removed(const std::string& playerId, const Appended& appended) {
+    return append(playerId, "removed", true, appended);
+}
+
+uint64_t PlayerStateLog::append(const std::string& playerId, const char* kind, const nlohmann::json& body,
+    const Appended& appended) {
+    // serialize outside the lock; only the version is spliced in under it
+    const auto text = nlohmann::json{
+        {"playerId", playerId},
+        {kind, body}
+    }.dump();
+
+    std::unique_lock lock(mutex_);
+    const auto version = ++latestVersion_;
+    auto& record = records_[(version - 1) % records_.size()];
+    record.assign("{\"version\":");
+    record.append(std::to_string(version));
+    record.push_back(',');
+    record.append(text, 1, std::string::npos);
+    if (appended) {
+        appended(version);
+    }
+    return version;
+}
+
+PlayerStateLog::ReadResult PlayerStateLog::read(uint64_t since, size_t limit) const {
+    ReadResult result;
+    result.changes.push_back('[');
+
+    std::shared_lock lock(mutex_);
+    result.latestVersion = latestVersion_;
+    if (latestVersion_ == 0) {
+        result.changes.push_back(']');
+        return result;
+    }
+    const auto capacity = static_cast<uint64_t>(records_.size());
+    result.oldestVersion = latestVersion_ > capacity ? latestVersion_ - capacity + 1 : 1;
+
+    auto version = std::max(since + 1, result.oldestVersion);
+    for (; version <= latestVersion_ && result.count < limit; ++version) {
+        if (result.count > 0) {
+            result.changes.push_back(',');
+        }
+        result.changes.append(records_[(version - 1) % capacity]);
+        ++result.count;
+    }
+    result.more = version <= latestVersion_;
+    result.changes.push_back(']');
+    return result;
+}
+
+uint64_t PlayerStateLog::latestVersion() const {
+    std::shared_lock lock(mutex_);
+    return latestVersion_;
+}
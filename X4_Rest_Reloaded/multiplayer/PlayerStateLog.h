@@ -0,0 +1,57 @@
+/*
+MIT License - Player State Change Log for X4 Foundations Multiplayer
+
+Versioned history of player state changes. Every change gets the next version number and
+is kept as a merge patch (or a full state for joins), so clients fetch what changed since
+the version they have instead of every player's full state.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+class PlayerStateLog {
+public:
+    struct ReadResult {
+        std::string changes; // JSON array text, oldest first
+        size_t count = 0;
+        uint64_t latestVersion = 0; // last version assigned, 0 if none
+        uint64_t oldestVersion = 0; // oldest version still held, 0 if none
+        bool more = false; // stopped at the limit with newer changes left
+    };
+
+    // Called with the new version while the log is still locked, so whatever it queues is
+    // queued in version order. Must not call back into the log.
+    using Appended = std::function<void(uint64_t version)>;
+
+    explicit PlayerStateLog(size_t capacity);
+
+    // Each returns the version assigned to the change (starting at 1)
+
+    // the player's state changed by `patch`, a merge patch
+    uint64_t patched(const std::string& playerId, const nlohmann::json& patch, const Appended& appended = {});
+    // the player's state was replaced by `state` (a join)
+    uint64_t replaced(const std::string& playerId, const nlohmann::json& state, const Appended& appended = {});
+    // the player is gone
+    uint64_t removed(const std::string& playerId, const Appended& appended = {});
+
+    /**
+     * changes with a version above `since`, at most `limit`. If `since` is below
+     * oldestVersion - 1, changes in between were overwritten.
+     */
+    ReadResult read(uint64_t since, size_t limit) const;
+
+    uint64_t latestVersion() const;
+
+private:
+    uint64_t append(const std::string& playerId, const char* kind, const nlohmann::json& body,
+        const Appended& appended);
+
+    std::vector<std::string> records_; // serialized changes, slot (version - 1) % capacity
+    uint64_t latestVersion_ = 0;
+    mutable std::shared_mutex mutex_;
+};
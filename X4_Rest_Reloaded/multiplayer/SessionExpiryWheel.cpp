@@ -0,0 +1,55 @@
+/*
+MIT License - Session Expiry Timing Wheel Implementation
+*/
+
+#include "SessionExpiryWheel.h"
+#include <algorithm>
+#include <iterator>
+
+SessionExpiryWheel::SessionExpiryWheel(Clock::duration tick, size_t slots)
+    : epoch_(Clock::now()), tick_(tick) {
+    size_t size = 1;
+    while (size < slots) {
+        size <<= 1;
+    }
+    slots_.resize(size);
+    mask_ = size - 1;
+}
+
+int64_t SessionExpiryWheel::tickOf(Clock::time_point time) const {
+    return std::max<int64_t>(0, (time - epoch_) / tick_);
+}
+
+void SessionExpiryWheel::schedule(std::string playerId, uint64_t sessionId, Clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // a deadline in an already processed tick goes into the next one
+    const auto tick = std::max(tickOf(deadline), currentTick_ + 1);
+    slots_[static_cast<size_t>(tick) & mask_].push_back({std::move(playerId), sessionId, deadline});
+    size_++;
+}
+
+std::vector<SessionExpiryWheel::Entry> SessionExpiryWheel::advance(Clock::time_point now) {
+    std::vector<Entry> due;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // a tick is processed once it has fully passed, so entries can be up to a tick late
+    const auto target = tickOf(now) - 1;
+    // after a long stall one pass over every slot catches up
+    const auto first = std::max(currentTick_ + 1, target - static_cast<int64_t>(mask_));
+    for (auto tick = first; tick <= target; ++tick) {
+        auto& slot = slots_[static_cast<size_t>(tick) & mask_];
+        // entries for a later round stay where they are
+        auto keep = std::partition(slot.begin(), slot.end(),
+            [&](const Entry& entry) { return tickOf(entry.deadline) > target; });
+        std::move(keep, slot.end(), std::back_inserter(due));
+        slot.erase(keep, slot.end());
+    }
+    currentTick_ = std::max(currentTick_, target);
+    size_ -= due.size();
+    return due;
+}
+
+size_t SessionExpiryWheel::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
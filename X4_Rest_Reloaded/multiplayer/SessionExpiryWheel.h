@@ -0,0 +1,50 @@
+/*
+MIT License - Session Expiry Timing Wheel for X4 Foundations Multiplayer
+
+Hashed timing wheel of session deadlines: scheduling is O(1) and each tick only looks at
+the entries that fall into its slot, independent of the number of sessions.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class SessionExpiryWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string playerId;
+        uint64_t sessionId;
+        Clock::time_point deadline;
+    };
+
+    /**
+     * `slots` is rounded up to a power of two; deadlines further out than
+     * tick * slots wait in their slot for additional rounds
+     */
+    explicit SessionExpiryWheel(Clock::duration tick = std::chrono::seconds(1), size_t slots = 512);
+
+    void schedule(std::string playerId, uint64_t sessionId, Clock::time_point deadline);
+
+    /**
+     * removes and returns the entries of every tick that has passed by `now`
+     */
+    std::vector<Entry> advance(Clock::time_point now);
+
+    size_t size() const;
+
+private:
+    int64_t tickOf(Clock::time_point time) const;
+
+    const Clock::time_point epoch_;
+    const Clock::duration tick_;
+    std::vector<std::vector<Entry>> slots_;
+    size_t mask_;
+    int64_t currentTick_ = -1; // last tick advance() has processed
+    size_t size_ = 0;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,193 @@
+/*
+MIT License - WebSocket Subscription Index Implementation
+*/
+
+#include "SubscriptionIndex.h"
+#include <algorithm>
+
+SubscriptionIndex::Filter SubscriptionIndex::Filter::fromJson(const nlohmann::json& json) {
+    Filter filter;
+    const auto list = [&json](const char* key, std::vector<std::string>& out) {
+        if (!json.contains(key)) {
+            return;
+        }
+        const auto& value = json[key];
+        if (value.is_string()) {
+            out.push_back(value.get<std::string>());
+        } else {
+            out = value.get<std::vector<std::string>>();
+        }
+    };
+    list("eventTypes", filter.eventTypes);
+    list("sectors", filter.sectors);
+    list("players", filter.players);
+    return filter;
+}
+
+void SubscriptionIndex::addConnection(uint64_t id) {
+    connections_.try_emplace(id);
+    unfiltered_.insert(id);
+}
+
+void SubscriptionIndex::removeConnection(uint64_t id) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+        return;
+    }
+    const auto& connection = it->second;
+    for (const auto& key : connection.eventTypes) {
+        Erase(byEventType_, key, id);
+    }
+    for (const auto& key : connection.sectors) {
+        Erase(bySector_, key, id);
+    }
+    for (const auto& key : connection.players) {
+        Erase(byPlayer_, key, id);
+    }
+    if (!connection.identity.empty()) {
+        Erase(byIdentity_, connection.identity, id);
+    }
+    unfiltered_.erase(id);
+    connections_.erase(it);
+}
+
+void SubscriptionIndex::setIdentity(uint64_t id, const std::string& playerId) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+        return;
+    }
+    if (!it->second.identity.empty()) {
+        Erase(byIdentity_, it->second.identity, id);
+    }
+    it->second.identity = playerId;
+    if (!playerId.empty()) {
+        byIdentity_[playerId].insert(id);
+    }
+}
+
+void SubscriptionIndex::subscribe(uint64_t id, const Filter& filter) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Add(byEventType_, it->second.eventTypes, filter.eventTypes, id);
+    Add(bySector_, it->second.sectors, filter.sectors, id);
+    Add(byPlayer_, it->second.players, filter.players, id);
+    updateUnfiltered(id, it->second);
+}
+
+void SubscriptionIndex::unsubscribe(uint64_t id, const Filter& filter) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Remove(byEventType_, it->second.eventTypes, filter.eventTypes, id);
+    Remove(bySector_, it->second.sectors, filter.sectors, id);
+    Remove(byPlayer_, it->second.players, filter.players, id);
+    updateUnfiltered(id, it->second);
+}
+
+void SubscriptionIndex::match(const std::string& eventType, const std::string& sector, const std::string& fromPlayer,
+    const std::unordered_set<std::string>& targetPlayers, std::vector<uint64_t>& out) const {
+    const auto first = out.size();
+    const auto append = [&out](const Index& index, const std::string& key) {
+        if (key.empty()) {
+            return;
+        }
+        auto it = index.find(key);
+        if (it != index.end()) {
+            out.insert(out.end(), it->second.begin(), it->second.end());
+        }
+    };
+
+    if (!targetPlayers.empty()) {
+        for (const auto& player : targetPlayers) {
+            append(byIdentity_, player);
+        }
+    } else {
+        out.insert(out.end(), unfiltered_.begin(), unfiltered_.end());
+        append(byEventType_, eventType);
+        append(bySector_, sector);
+        append(byPlayer_, fromPlayer);
+    }
+
+    // a connection can match through several indexes
+    std::sort(out.begin() + first, out.end());
+    out.erase(std::unique(out.begin() + first, out.end()), out.end());
+}
+
+bool SubscriptionIndex::matches(uint64_t id, const std::string& eventType, const std::string& sector, const std::string& fromPlayer,
+    const std::unordered_set<std::string>& targetPlayers) const {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+        return false;
+    }
+    const auto& connection = it->second;
+    if (!targetPlayers.empty()) {
+        return !connection.identity.empty() && targetPlayers.count(connection.identity) > 0;
+    }
+    return connection.unfiltered() || connection.eventTypes.count(eventType) > 0
+        || (!sector.empty() && connection.sectors.count(sector) > 0)
+        || (!fromPlayer.empty() && connection.players.count(fromPlayer) > 0);
+}
+
+std::vector<uint64_t> SubscriptionIndex::connectionsOf(const std::string& playerId) const {
+    auto it = byIdentity_.find(playerId);
+    if (it == byIdentity_.end()) {
+        return {};
+    }
+    return {it->second.begin(), it->second.end()};
+}
+
+nlohmann::json SubscriptionIndex::describe(uint64_t id) const {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+        return nullptr;
+    }
+    const auto sorted = [](const std::unordered_set<std::string>& values) {
+        std::vector<std::string> list(values.begin(), values.end());
+        std::sort(list.begin(), list.end());
+        return list;
+    };
+    return {
+        {"eventTypes", sorted(it->second.eventTypes)},
+        {"sectors", sorted(it->second.sectors)},
+        {"players", sorted(it->second.players)},
+        {"allEvents", it->second.unfiltered()}
+    };
+}
+
+void SubscriptionIndex::Add(Index& index, std::unordered_set<std::string>& keys, const std::vector<std::string>& values, uint64_t id) {
+    for (const auto& value : values) {
+        if (!value.empty() && keys.insert(value).second) {
+            index[value].insert(id);
+        }
+    }
+}
+
+void SubscriptionIndex::Remove(Index& index, std::unordered_set<std::string>& keys, const std::vector<std::string>& values, uint64_t id) {
+    for (const auto& value : values) {
+        if (keys.erase(value) > 0) {
+            Erase(index, value, id);
+        }
+    }
+}
+
+void SubscriptionIndex::Erase(Index& index, const std::string& key, uint64_t id) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+    it->second.erase(id);
+    if (it->second.empty()) {
+        index.erase(it);
+    }
+}
+
+void SubscriptionIndex::updateUnfiltered(uint64_t id, const Connection& connection) {
+    if (connection.unfiltered()) {
+        unfiltered_.insert(id);
+    } else {
+        unfiltered_.erase(id);
+    }
+}
@@ -0,0 +1,83 @@
+/*
+MIT License - WebSocket Subscription Index for X4 Foundations Multiplayer
+
+Inverted indexes from event type, sector and player to the connections subscribed to
+them, so an event is matched against its subscribers instead of every connection.
+Not synchronized; the owner guards it.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class SubscriptionIndex {
+public:
+    struct Filter {
+        std::vector<std::string> eventTypes;
+        std::vector<std::string> sectors;
+        std::vector<std::string> players; // events from these players
+
+        // {"eventTypes": [...], "sectors": [...], "players": [...]}, all optional
+        static Filter fromJson(const nlohmann::json& json);
+        bool empty() const { return eventTypes.empty() && sectors.empty() && players.empty(); }
+    };
+
+    void addConnection(uint64_t id);
+    void removeConnection(uint64_t id);
+
+    /**
+     * the player a connection authenticated as; targeted events go to these
+     */
+    void setIdentity(uint64_t id, const std::string& playerId);
+
+    void subscribe(uint64_t id, const Filter& filter);
+    void unsubscribe(uint64_t id, const Filter& filter);
+
+    /**
+     * Appends the connections an event goes to. Targeted events (non-empty targetPlayers) go to
+     * the connections authenticated as a target. Others go to connections subscribed to its
+     * type, sector or sending player, plus connections without any subscription, which get
+     * everything. Each connection appears once.
+     */
+    void match(const std::string& eventType, const std::string& sector, const std::string& fromPlayer,
+        const std::unordered_set<std::string>& targetPlayers, std::vector<uint64_t>& out) const;
+
+    /**
+     * whether match() would include connection `id` for this event
+     */
+    bool matches(uint64_t id, const std::string& eventType, const std::string& sector, const std::string& fromPlayer,
+        const std::unordered_set<std::string>& targetPlayers) const;
+
+    std::vector<uint64_t> connectionsOf(const std::string& playerId) const;
+    nlohmann::json describe(uint64_t id) const;
+    bool contains(uint64_t id) const { return connections_.count(id) > 0; }
+    size_t size() const { return connections_.size(); }
+
+private:
+    using Index = std::unordered_map<std::string, std::unordered_set<uint64_t>>;
+
+    struct Connection {
+        std::string identity;
+        std::unordered_set<std::string> eventTypes;
+        std::unordered_set<std::string> sectors;
+        std::unordered_set<std::string> players;
+
+        bool unfiltered() const { return eventTypes.empty() && sectors.empty() && players.empty(); }
+    };
+
+    static void Add(Index& index, std::unordered_set<std::string>& keys, const std::vector<std::string>& values, uint64_t id);
+    static void Remove(Index& index, std::unordered_set<std::string>& keys, const std::vector<std::string>& values, uint64_t id);
+    static void Erase(Index& index, const std::string& key, uint64_t id);
+    void updateUnfiltered(uint64_t id, const Connection& connection);
+
+    std::unordered_map<uint64_t, Connection> connections_;
+    Index byEventType_;
+    Index bySector_;
+    Index byPlayer_;
+    Index byIdentity_;
+    std::unordered_set<uint64_t> unfiltered_;
+};
@@ -0,0 +1,153 @@
+/*
+MIT License - Client Sync Cache Implementation
+*/
+
+#include "SyncCache.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+void SyncCache::resetPlayers(const nlohmann::json& players, uint64_t version) {
+    std::unique_lock lock(mutex_);
+    players_.clear();
+    for (const auto& [id, state] : players.items()) {
+        players_[id] = {state, version};
+    }
+    playersVersion_ = version;
+    hasPlayers_ = true;
+    touch();
+}
+
+SyncCache::Apply SyncCache::applyPlayerChange(const nlohmann::json& change) {
+    const auto version = change.at("version").get<uint64_t>();
+    const auto& playerId = change.at("playerId").get_ref<const std::string&>();
+
+    std::unique_lock lock(mutex_);
+    if (!hasPlayers_ || version > playersVersion_ + 1) {
+        return Apply::Gap;
+    }
+    if (version <= playersVersion_) {
+        return Apply::Stale;
+    }
+    if (change.contains("removed")) {
+        players_.erase(playerId);
+    } else if (change.contains("state")) {
+        players_[playerId] = {change["state"], version};
+    } else if (change.contains("patch")) {
+        auto& player = players_[playerId];
+        player.state.merge_patch(change["patch"]);
+        player.version = version;
+    }
+    playersVersion_ = version;
+    touch();
+    return Apply::Applied;
+}
+
+uint64_t SyncCache::playersVersion() const {
+    std::shared_lock lock(mutex_);
+    return playersVersion_;
+}
+
+bool SyncCache::hasPlayers() const {
+    std::shared_lock lock(mutex_);
+    return hasPlayers_;
+}
+
+void SyncCache::updatePosition(const std::string& playerId, const nlohmann::json& position) {
+    std::unique_lock lock(mutex_);
+    auto it = players_.find(playerId);
+    if (it == players_.end()) {
+        return; // not joined as far as the cache knows; its join carries the position
+    }
+    it->second.state["position"] = position;
+    touch();
+}
+
+void SyncCache::updateUniverse(const nlohmann::json& changes) {
+    std::unique_lock lock(mutex_);
+    for (const auto& key : {"universeTime", "globalEconomy", "factionRelations"}) {
+        if (changes.contains(key)) {
+            universe_[key] = changes[key];
+        }
+    }
+    touch();
+}
+
+void SyncCache::addChatMessage(const nlohmann::json& message) {
+    const auto seq = message.value("seq", uint64_t{0});
+
+    std::unique_lock lock(mutex_);
+    if (seq <= chatSeq_) {
+        return;
+    }
+    chatSeq_ = seq;
+    chat_.push_back(message);
+    if (chat_.size() > CHAT_HISTORY) {
+        chat_.pop_front();
+    }
+    touch();
+}
+
+uint64_t SyncCache::latestChatSeq() const {
+    std::shared_lock lock(mutex_);
+    return chatSeq_;
+}
+
+void SyncCache::clear() {
+    std::unique_lock lock(mutex_);
+    players_.clear();
+    playersVersion_ = 0;
+    hasPlayers_ = false;
+    universe_ = nlohmann::json::object();
+    chat_.clear();
+    chatSeq_ = 0;
+    lastUpdate_ = 0;
+}
+
+nlohmann::json SyncCache::players() const {
+    std::shared_lock lock(mutex_);
+    auto players = nlohmann::json::array();
+    for (const auto& [id, player] : players_) {
+        auto entry = player.state;
+        entry["playerId"] = id;
+        entry["stateVersion"] = player.version;
+        players.push_back(std::move(entry));
+    }
+    return {
+        {"count", players.size()},
+        {"version", playersVersion_},
+        {"players", std::move(players)},
+        {"lastUpdate", lastUpdate_}
+    };
+}
+
+nlohmann::json SyncCache::universe() const {
+    std::shared_lock lock(mutex_);
+    return {
+        {"universeTime", universe_.value("universeTime", uint64_t{0})},
+        {"activePlayers", players_.size()},
+        {"globalEconomy", universe_.value("globalEconomy", nlohmann::json::object())},
+        {"factionRelations", universe_.value("factionRelations", nlohmann::json::object())},
+        {"lastUpdate", lastUpdate_}
+    };
+}
+
+nlohmann::json SyncCache::chat(size_t limit) const {
+    std::shared_lock lock(mutex_);
+    const auto count = std::min(limit, chat_.size());
+    auto messages = nlohmann::json::array();
+    for (auto it = chat_.end() - static_cast<std::ptrdiff_t>(count); it != chat_.end(); ++it) {
+        messages.push_back(*it);
+    }
+    return {
+        {"messages", std::move(messages)},
+        {"count", count},
+        {"latestSeq", chatSeq_},
+        {"lastUpdate", lastUpdate_}
+    };
+}
+
+void SyncCache::touch() {
+    lastUpdate_ = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,67 @@
+/*
+MIT License - Client Sync Cache for X4 Foundations Multiplayer
+
+The client's copy of the shared state: every player's state, the universe (time,
+economy, faction relations) and recent chat. Filled from one snapshot over REST and
+then kept current by the player_state, player_position, universe_update and chat_message
+events the server pushes over the WebSocket, so reads never go to the network.
+*/
+
+#pragma once
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <shared_mutex>
+#include <string>
+
+class SyncCache {
+public:
+    static constexpr size_t CHAT_HISTORY = 200; // messages kept
+
+    enum class Apply {
+        Applied,
+        Stale, // already have it
+        Gap    // changes before it are missing; catch up from playersVersion()
+    };
+
+    // Players: a full snapshot as of `version`, then every change after it in order
+    void resetPlayers(const nlohmann::json& players, uint64_t version);
+    // a change as listed by /mp/players/changes and sent in player_state events
+    Apply applyPlayerChange(const nlohmann::json& change);
+    uint64_t playersVersion() const;
+    bool hasPlayers() const;
+    // player_position event; positions are not versioned, the newest one wins
+    void updatePosition(const std::string& playerId, const nlohmann::json& position);
+
+    // /mp/universe response, then universe_update events with the fields they replace
+    void updateUniverse(const nlohmann::json& changes);
+
+    // /mp/chat message; ignored if its seq is already held
+    void addChatMessage(const nlohmann::json& message);
+    uint64_t latestChatSeq() const;
+
+    void clear();
+
+    // Same shapes as /mp/players, /mp/universe and /mp/chat, plus lastUpdate
+    nlohmann::json players() const;
+    nlohmann::json universe() const;
+    nlohmann::json chat(size_t limit) const;
+
+private:
+    struct Player {
+        nlohmann::json state;
+        uint64_t version = 0;
+    };
+
+    void touch();
+
+    std::map<std::string, Player> players_;
+    uint64_t playersVersion_ = 0;
+    bool hasPlayers_ = false;
+    nlohmann::json universe_ = nlohmann::json::object();
+    std::deque<nlohmann::json> chat_; // oldest first
+    uint64_t chatSeq_ = 0;
+    int64_t lastUpdate_ = 0; // unix seconds of the last change
+    mutable std::shared_mutex mutex_;
+};
@@ -0,0 +1,240 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+namespace {
+
+std::vector<std::unique_ptr<Benchmark>>& Registry() {
+    static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+std::chrono::nanoseconds CpuNow() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#else
+    return std::chrono::nanoseconds(
+        static_cast<int64_t>(static_cast<double>(std::clock()) * 1e9 / CLOCKS_PER_SEC));
+#endif
+}
+
+std::string HostName() {
+#ifndef _WIN32
+    char name[ 256 ] = {};
+    if (gethostname(name, sizeof(name) - 1) == 0) {
+        return name;
+    }
+#endif
+    return "";
+}
+
+std::string Now() {
+    const auto now = std::time(nullptr);
+    char buf[ 64 ];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    return buf;
+}
+
+struct Options {
+    std::regex filter{".*"};
+    double min_time = 0.5;
+    std::string out;
+    bool json_stdout = false;
+};
+
+Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[ i ];
+        const auto value = [ & ](const std::string& flag) -> const char* {
+            return arg.rfind(flag + "=", 0) == 0 ? arg.c_str() + flag.size() + 1 : nullptr;
+        };
+        if (const auto v = value("--benchmark_filter")) {
+            options.filter = std::regex(v);
+        }
+        else if (const auto v = value("--benchmark_min_time")) {
+            options.min_time = std::strtod(v, nullptr);
+        }
+        else if (const auto v = value("--benchmark_out")) {
+            options.out = v;
+        }
+        else if (const auto v = value("--benchmark_format")) {
+            options.json_stdout = std::string(v) == "json";
+        }
+        else {
+            std::cerr << "unknown argument " << arg << "\n";
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+void State::start() {
+    running_ = true;
+    wall_start_ = std::chrono::steady_clock::now();
+    cpu_start_ = CpuNow();
+}
+
+void State::finish() {
+    PauseTiming();
+}
+
+void State::PauseTiming() {
+    if (running_) {
+        elapsed_ += std::chrono::steady_clock::now() - wall_start_;
+        cpu_elapsed_ += CpuNow() - cpu_start_;
+        running_ = false;
+    }
+}
+
+void State::ResumeTiming() {
+    if (!running_) {
+        start();
+    }
+}
+
+Benchmark* Register(const std::string& name, Function fn) {
+    return Registry().emplace_back(std::make_unique<Benchmark>(name, std::move(fn))).get();
+}
+
+int RunAll(int argc, char** argv) {
+    const auto options = ParseOptions(argc, argv);
+    const auto min_time = std::chrono::duration<double>(options.min_time);
+
+    auto results = nlohmann::json::array();
+    // with json on stdout the table goes to stderr
+    const auto table = options.json_stdout ? stderr : stdout;
+    std::fprintf(table, "%-56s %14s %14s %12s\n", "Benchmark", "Time (ns)", "CPU (ns)",
+        "Iterations");
+
+    size_t family_index = 0;
+    for (const auto& benchmark : Registry()) {
+        auto instances = benchmark->args_;
+        if (instances.empty()) {
+            instances.push_back({});
+        }
+
+        bool ran = false;
+        for (size_t instance = 0; instance < instances.size(); instance++) {
+            auto name = benchmark->name_;
+            for (const auto arg : instances[ instance ]) {
+                name += "/" + std::to_string(arg);
+            }
+            if (!std::regex_search(name, options.filter)) {
+                continue;
+            }
+            ran = true;
+
+            // grow the iteration count until a run takes at least min_time
+            uint64_t iterations =
+                benchmark->fixed_iterations_ != 0 ? benchmark->fixed_iterations_ : 1;
+            for (;;) {
+                State state(iterations, instances[ instance ]);
+                benchmark->fn_(state);
+
+                const auto elapsed = std::chrono::duration<double>(state.elapsed());
+                if (benchmark->fixed_iterations_ == 0 && elapsed < min_time &&
+                    iterations < 1'000'000'000) {
+                    const auto multiplier =
+                        elapsed.count() <= 0
+                            ? 10.0
+                            : std::clamp(min_time / elapsed * 1.4, 2.0, 10.0);
+                    iterations = static_cast<uint64_t>(static_cast<double>(iterations) *
+                                                       multiplier);
+                    continue;
+                }
+
+                const auto per_iteration = [ & ](std::chrono::nanoseconds total) {
+                    return static_cast<double>(total.count()) /
+                           static_cast<double>(state.iterations());
+                };
+                nlohmann::json result = {
+                    {"name", name},
+                    {"family_index", family_index},
+                    {"per_family_instance_index", instance},
+                    {"run_name", name},
+                    {"run_type", "iteration"},
+                    {"repetitions", 1},
+                    {"repetition_index", 0},
+                    {"threads", 1},
+                    {"iterations", state.iterations()},
+                    {"real_time", per_iteration(state.elapsed())},
+                    {"cpu_time", per_iteration(state.cpuElapsed())},
+                    {"time_unit", "ns"},
+                };
+                if (state.itemsProcessed() > 0 && elapsed.count() > 0) {
+                    result[ "items_per_second" ] =
+                        static_cast<double>(state.itemsProcessed()) / elapsed.count();
+                }
+                if (!state.label().empty()) {
+                    result[ "label" ] = state.label();
+                }
+                std::fprintf(table, "%-56s %14.0f %14.0f %12llu %s\n", name.c_str(),
+                    result[ "real_time" ].get<double>(), result[ "cpu_time" ].get<double>(),
+                    static_cast<unsigned long long>(state.iterations()),
+                    state.label().c_str());
+                std::fflush(table);
+                results.push_back(std::move(result));
+                break;
+            }
+        }
+        if (ran) {
+            family_index++;
+        }
+    }
+
+    const nlohmann::json report = {
+        {"context",
+            {
+                {"date", Now()},
+                {"host_name", HostName()},
+                {"executable", argc > 0 ? argv[ 0 ] : ""},
+                {"num_cpus", std::thread::hardware_concurrency()},
+                {"mhz_per_cpu", 0},
+                {"cpu_scaling_enabled", false},
+#ifdef NDEBUG
+                {"library_build_type", "release"},
+#else
+                {"library_build_type", "debug"},
+#endif
+            }},
+        {"benchmarks", std::move(results)},
+    };
+    if (!options.out.empty()) {
+        std::ofstream(options.out) << report.dump(2) << "\n";
+    }
+    if (options.json_stdout) {
+        std::cout << report.dump(2) << "\n";
+    }
+    return 0;
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) { return bench::RunAll(argc, argv); }
@@ -0,0 +1,147 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Minimal benchmark harness. Mirrors the Google Benchmark API we need (ranged-for state,
+ * Arg, items processed) and writes results in its JSON format, so existing tooling
+ * (compare.py, CI dashboards) can read them.
+ *
+ *   static void BM_Foo(bench::State& state) {
+ *       for (auto _ : state) { bench::DoNotOptimize(foo(state.range(0))); }
+ *   }
+ *   BENCHMARK(BM_Foo)->Arg(10)->Arg(1000);
+ */
+namespace bench {
+
+class State {
+public:
+    State(uint64_t iterations, std::vector<int64_t> args)
+        : max_iterations_(iterations), args_(std::move(args)) {}
+
+    int64_t range(size_t i = 0) const { return args_.at(i); }
+    uint64_t iterations() const { return max_iterations_; }
+
+    void SetItemsProcessed(int64_t items) { items_processed_ = items; }
+    int64_t itemsProcessed() const { return items_processed_; }
+
+    void SetLabel(std::string label) { label_ = std::move(label); }
+    const std::string& label() const { return label_; }
+
+    // excludes setup inside the loop from the measurement
+    void PauseTiming();
+    void ResumeTiming();
+
+    std::chrono::nanoseconds elapsed() const { return elapsed_; }
+    std::chrono::nanoseconds cpuElapsed() const { return cpu_elapsed_; }
+
+    struct Iterator {
+        State* state;
+        uint64_t remaining;
+
+        bool operator!=(const Iterator&) const {
+            if (remaining != 0) {
+                return true;
+            }
+            state->finish();
+            return false;
+        }
+        Iterator& operator++() {
+            --remaining;
+            return *this;
+        }
+        int operator*() const { return 0; }
+    };
+
+    Iterator begin() {
+        start();
+        return {this, max_iterations_};
+    }
+    Iterator end() { return {this, 0}; }
+
+private:
+    void start();
+    void finish();
+
+    uint64_t max_iterations_;
+    std::vector<int64_t> args_;
+    int64_t items_processed_ = 0;
+    std::string label_;
+
+    bool running_ = false;
+    std::chrono::steady_clock::time_point wall_start_;
+    std::chrono::nanoseconds cpu_start_{};
+    std::chrono::nanoseconds elapsed_{};
+    std::chrono::nanoseconds cpu_elapsed_{};
+};
+
+using Function = std::function<void(State&)>;
+
+class Benchmark {
+public:
+    Benchmark(std::string name, Function fn) : name_(std::move(name)), fn_(std::move(fn)) {}
+
+    Benchmark* Arg(int64_t arg) {
+        args_.push_back({arg});
+        return this;
+    }
+    Benchmark* Args(std::vector<int64_t> args) {
+        args_.push_back(std::move(args));
+        return this;
+    }
+    // caps the iteration count, for benchmarks that wait on real time (network, frames)
+    Benchmark* Iterations(uint64_t iterations) {
+        fixed_iterations_ = iterations;
+        return this;
+    }
+
+private:
+    friend int RunAll(int argc, char** argv);
+
+    std::string name_;
+    Function fn_;
+    std::vector<std::vector<int64_t>> args_;
+    uint64_t fixed_iterations_ = 0;
+};
+
+Benchmark* Register(const std::string& name, Function fn);
+
+/**
+ * runs every registered benchmark matching --benchmark_filter=<regex>, prints a table and
+ * writes json to --benchmark_out=<file> (stdout with --benchmark_format=json)
+ */
+int RunAll(int argc, char** argv);
+
+template <typename T> inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(void*)) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+    else {
+        asm volatile("" : : "m"(value) : "memory");
+    }
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+} // namespace bench
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK(fn)                                                                          \
+    static ::bench::Benchmark* BENCH_CONCAT(bench_registration_, __LINE__) =                  \
+        ::bench::Register(#fn, fn)
@@ -0,0 +1,163 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Bench.h"
+
+#include <string>
+#include <thread>
+
+#include "ffi/FFIInvoke.h"
+#include "httpserver/HttpServer.h"
+#include "multiplayer/MultiplayerServer.h"
+
+// Round trips over loopback with a keep-alive client, so these include httplib's parsing
+// and socket overhead; compare routes against each other rather than against the
+// in-process benchmarks.
+
+namespace {
+
+constexpr int REST_PORT = 33002;
+constexpr int MP_PORT = 33003;
+// roughly the number of endpoints the plugin registers
+constexpr int FILLER_ENDPOINTS = 150;
+
+void WaitUntilUp(httplib::Client& client, const char* path) {
+    for (int i = 0; i < 500 && !client.Get(path); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+httplib::Client& RestClient() {
+    static auto& client = []() -> httplib::Client& {
+        const auto ok = [](const httplib::Request&, httplib::Response& res) {
+            SET_CONTENT(({{"ok", true}}));
+        };
+        for (int i = 0; i < FILLER_ENDPOINTS; i++) {
+            HttpServer::AddEndpoint({"/Filler" + std::to_string(i), HttpServer::GET, ok});
+        }
+        HttpServer::AddEndpoint({"/BenchLiteral", HttpServer::GET, ok});
+        HttpServer::AddEndpoint({R"(/BenchRegex/(\d+))", HttpServer::GET, ok});
+        HttpServer::AddEndpoint({"/BenchPost", HttpServer::POST, ok});
+
+        // never stopped; lives until the process exits
+        static FFIInvoke ffi_invoke;
+        static auto* server = new HttpServer(ffi_invoke);
+        std::thread([] { server->run(REST_PORT); }).detach();
+
+        static httplib::Client client("127.0.0.1", REST_PORT);
+        client.set_keep_alive(true);
+        WaitUntilUp(client, "/BenchLiteral");
+        return client;
+    }();
+    return client;
+}
+
+void BM_DispatchLiteralGet(bench::State& state) {
+    auto& client = RestClient();
+    for (auto _ : state) {
+        bench::DoNotOptimize(client.Get("/BenchLiteral"));
+    }
+}
+BENCHMARK(BM_DispatchLiteralGet);
+
+void BM_DispatchRegexGet(bench::State& state) {
+    auto& client = RestClient();
+    for (auto _ : state) {
+        bench::DoNotOptimize(client.Get("/BenchRegex/42"));
+    }
+}
+BENCHMARK(BM_DispatchRegexGet);
+
+void BM_DispatchPost(bench::State& state) {
+    auto& client = RestClient();
+    for (auto _ : state) {
+        bench::DoNotOptimize(client.Post("/BenchPost", "{}", "application/json"));
+    }
+}
+BENCHMARK(BM_DispatchPost);
+
+void BM_DispatchNotFound(bench::State& state) {
+    auto& client = RestClient();
+    for (auto _ : state) {
+        bench::DoNotOptimize(client.Get("/DoesNotExist"));
+    }
+}
+BENCHMARK(BM_DispatchNotFound);
+
+httplib::Client& MultiplayerClient() {
+    static auto& client = []() -> httplib::Client& {
+        // never stopped; lives until the process exits
+        static auto* server = new MultiplayerServer(MP_PORT);
+        server->start();
+        static httplib::Client client("127.0.0.1", MP_PORT);
+        client.set_keep_alive(true);
+        WaitUntilUp(client, "/mp/info");
+        return client;
+    }();
+    return client;
+}
+
+std::string PlayerId(int64_t i) { return "player" + std::to_string(i); }
+
+/**
+ * joins or removes players until exactly `count` are in the session
+ */
+void EnsurePlayers(httplib::Client& client, int64_t count) {
+    static int64_t joined = 0;
+    for (; joined > count; joined--) {
+        client.Post("/mp/leave", nlohmann::json{{"playerId", PlayerId(joined - 1)}}.dump(),
+            "application/json");
+    }
+    for (; joined < count; joined++) {
+        client.Post("/mp/join",
+            nlohmann::json{{"playerId", PlayerId(joined)}, {"playerName", PlayerId(joined)},
+                {"currentSector", "sector" + std::to_string(joined % 50)},
+                {"position", {{"x", 0}, {"y", 0}, {"z", 0}}}}
+                .dump(),
+            "application/json");
+    }
+}
+
+void BM_MultiplayerHeartbeat(bench::State& state) {
+    auto& client = MultiplayerClient();
+    EnsurePlayers(client, state.range(0));
+    int64_t i = 0;
+    for (auto _ : state) {
+        const auto body = nlohmann::json{{"playerId", PlayerId(i++ % state.range(0))},
+            {"position", {{"x", i}, {"y", 0}, {"z", 0}}}}
+                              .dump();
+        bench::DoNotOptimize(client.Post("/mp/heartbeat", body, "application/json"));
+    }
+}
+BENCHMARK(BM_MultiplayerHeartbeat)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_MultiplayerUpdate(bench::State& state) {
+    auto& client = MultiplayerClient();
+    EnsurePlayers(client, state.range(0));
+    int64_t i = 0;
+    for (auto _ : state) {
+        const auto body = nlohmann::json{{"playerId", PlayerId(i++ % state.range(0))},
+            {"currentSector", "sector1"}, {"position", {{"x", i}, {"y", 1}, {"z", 2}}},
+            {"playerData", {{"credits", i}, {"ship", "Marlin"}}}}
+                              .dump();
+        bench::DoNotOptimize(client.Put("/mp/player/update", body, "application/json"));
+    }
+}
+BENCHMARK(BM_MultiplayerUpdate)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_MultiplayerGetPlayers(bench::State& state) {
+    auto& client = MultiplayerClient();
+    EnsurePlayers(client, state.range(0));
+    for (auto _ : state) {
+        bench::DoNotOptimize(client.Get("/mp/players"));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_MultiplayerGetPlayers)->Arg(10)->Arg(100)->Arg(1000);
+
+} // namespace
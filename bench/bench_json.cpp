@@ -0,0 +1,97 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Bench.h"
+
+#include <string>
+#include <vector>
+
+#include "ffi/json_converters.h"
+
+namespace {
+
+std::vector<X4FFI::MessageInfo> MakeMessages(size_t count) {
+    std::vector<X4FFI::MessageInfo> messages(count);
+    for (size_t i = 0; i < count; i++) {
+        auto& m = messages[ i ];
+        m.id = i;
+        m.time = 1000.0 + static_cast<double>(i);
+        m.category = "general";
+        m.title = "Trade completed";
+        m.text = "Your ship Marlin (ABC-123) sold 4200 Energy Cells for 67200 Credits at "
+                 "Argon Prime Trading Station.";
+        m.source = "Marlin";
+        m.sourcecomponent = 0x1000 + i;
+        m.interaction = "";
+        m.interactioncomponent = 0;
+        m.interactiontext = "";
+        m.interactionshorttext = "";
+        m.cutscenekey = "";
+        m.entityname = "Captain Jane Doe";
+        m.factionname = "Argon Federation";
+        m.money = 67200;
+        m.bonus = 0;
+        m.highlighted = false;
+        m.isread = (i % 3) == 0;
+    }
+    return messages;
+}
+
+std::vector<X4FFI::RaceInfo> MakeRaces(size_t count) {
+    std::vector<X4FFI::RaceInfo> races(count);
+    for (auto& r : races) {
+        r = {"argon", "Argon", "ARG", "Humans descended from the crew of the Argon", "race_argon"};
+    }
+    return races;
+}
+
+void BM_MessageInfoToJson(bench::State& state) {
+    const auto messages = MakeMessages(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        const nlohmann::json j = messages;
+        bench::DoNotOptimize(j);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_MessageInfoToJson)->Arg(1)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_MessageInfoToJsonDump(bench::State& state) {
+    const auto messages = MakeMessages(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        const auto body = nlohmann::json{{"messages", messages}}.dump();
+        bench::DoNotOptimize(body);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_MessageInfoToJsonDump)->Arg(10)->Arg(100)->Arg(1000);
+
+void BM_MessageInfoProjection(bench::State& state) {
+    const auto messages = MakeMessages(static_cast<size_t>(state.range(0)));
+    FieldProjection<X4FFI::MessageInfo> projection;
+    std::string unknown;
+    FieldProjection<X4FFI::MessageInfo>::Resolve(
+        FieldList::Parse("id,isread"), projection, unknown);
+    for (auto _ : state) {
+        const auto body = projection.applyAll(messages).dump();
+        bench::DoNotOptimize(body);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_MessageInfoProjection)->Arg(100)->Arg(1000);
+
+void BM_RaceInfoToJson(bench::State& state) {
+    const auto races = MakeRaces(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        const auto body = nlohmann::json(races).dump();
+        bench::DoNotOptimize(body);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_RaceInfoToJson)->Arg(1)->Arg(10)->Arg(100);
+
+} // namespace
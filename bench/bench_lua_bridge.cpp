@@ -0,0 +1,81 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Bench.h"
+
+#include <atomic>
+#include <thread>
+
+#include "_lua_.h"
+
+// executeLua hands a script to the game thread and polls for the result. There is no game
+// here: a pump thread plays the game's frame loop and calls lua_getfield_hook("onUpdate")
+// with lua stubbed to return "{}" instantly, so what's measured is the handoff itself.
+
+namespace {
+
+std::atomic<int64_t> frame_period_us{1000};
+
+int StubLoadString(lua_State*, const char*) { return LUA_OK; }
+int StubPcall(lua_State*, int, int, int) { return LUA_OK; }
+const char* StubToLString(lua_State*, int, size_t* len) {
+    if (len != nullptr) {
+        *len = 2;
+    }
+    return "{}";
+}
+int StubGetTop(lua_State*) { return 0; }
+void StubSetTop(lua_State*, int) {}
+void StubGetField(lua_State*, int, const char*) {}
+
+void StartFramePump() {
+    static const bool started = [] {
+        static int fake_state;
+        luaL_loadstring = &StubLoadString;
+        lua_pcall = &StubPcall;
+        lua_tolstring = &StubToLString;
+        lua_gettop = &StubGetTop;
+        lua_settop = &StubSetTop;
+        lua_getfield = &StubGetField;
+        ui_lua_state = reinterpret_cast<lua_State*>(&fake_state);
+
+        std::thread([] {
+            for (;;) {
+                lua_getfield_hook(ui_lua_state, -1, "onUpdate");
+                std::this_thread::sleep_for(std::chrono::microseconds(frame_period_us.load()));
+            }
+        }).detach();
+        return true;
+    }();
+    bench::DoNotOptimize(started);
+}
+
+// range(0): frame period in us, range(1): prepend the json library like most endpoints do
+void BM_ExecuteLuaHandoff(bench::State& state) {
+    StartFramePump();
+    frame_period_us = state.range(0);
+    const bool include_json = state.range(1) != 0;
+    for (auto _ : state) {
+        bench::DoNotOptimize(executeLua("return '{}'", include_json));
+    }
+}
+BENCHMARK(BM_ExecuteLuaHandoff)
+    ->Args({0, 0})
+    ->Args({1000, 0})
+    ->Args({16667, 0})
+    ->Args({16667, 1})
+    ->Iterations(100);
+
+void BM_GetJsonLua(bench::State& state) {
+    for (auto _ : state) {
+        bench::DoNotOptimize(GetJsonLua(false) + "\nreturn '{}'");
+    }
+}
+BENCHMARK(BM_GetJsonLua);
+
+} // namespace
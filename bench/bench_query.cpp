@@ -0,0 +1,104 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#include "Bench.h"
+
+#include "httpserver/HttpServer.h"
+#include "lua_scripts/ComponentDataHelper.h"
+
+namespace {
+
+httplib::Request MakeRequest() {
+    httplib::Request req;
+    req.params.emplace("componentId", "1234567890123");
+    req.params.emplace("count", "50");
+    req.params.emplace("from", "-1");
+    req.params.emplace("unread", "true");
+    req.params.emplace("category", "upkeep");
+    req.params.emplace("fields", "id,isread,title");
+    return req;
+}
+
+void BM_ParseQueryParamUInt64(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        bench::DoNotOptimize(HttpServer::ParseQueryParam<uint64_t>(req, "componentId", 0));
+    }
+}
+BENCHMARK(BM_ParseQueryParamUInt64);
+
+void BM_ParseQueryParamInt(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        bench::DoNotOptimize(HttpServer::ParseQueryParam<int>(req, "from", 0));
+    }
+}
+BENCHMARK(BM_ParseQueryParamInt);
+
+void BM_ParseQueryParamBool(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        bench::DoNotOptimize(HttpServer::ParseQueryParam<bool>(req, "unread", false));
+    }
+}
+BENCHMARK(BM_ParseQueryParamBool);
+
+void BM_ParseQueryParamString(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        bench::DoNotOptimize(
+            HttpServer::ParseQueryParam<std::string>(req, "category", std::string("all")));
+    }
+}
+BENCHMARK(BM_ParseQueryParamString);
+
+void BM_ParseQueryParamMissing(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        bench::DoNotOptimize(HttpServer::ParseQueryParam<uint32_t>(req, "page", 1));
+    }
+}
+BENCHMARK(BM_ParseQueryParamMissing);
+
+void BM_QueryParamsMany(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        QueryParams params(req);
+        const auto id = params.required<uint64_t>("componentId");
+        const auto count = params.optional<uint32_t>("count", 10);
+        const auto from = params.optional<int>("from", 0);
+        const auto unread = params.optional<bool>("unread", false);
+        bench::DoNotOptimize(id);
+        bench::DoNotOptimize(count + from + unread);
+        bench::DoNotOptimize(params.ok());
+    }
+}
+BENCHMARK(BM_QueryParamsMany);
+
+void BM_FieldListParse(bench::State& state) {
+    const auto req = MakeRequest();
+    for (auto _ : state) {
+        const auto fields = FieldList::Parse(req.get_param_value("fields"));
+        bench::DoNotOptimize(fields);
+    }
+}
+BENCHMARK(BM_FieldListParse);
+
+// 0: first attribute, 1: last attribute, 2: unknown
+void BM_IsValidComponentData(bench::State& state) {
+    const std::string attribs[] = {
+        valid_component_data_attribs.front(), valid_component_data_attribs.back(), "nope"};
+    const auto& attrib = attribs[ state.range(0) ];
+    for (auto _ : state) {
+        bench::DoNotOptimize(is_valid_component_data(attrib));
+    }
+    state.SetLabel(attrib);
+}
+BENCHMARK(BM_IsValidComponentData)->Arg(0)->Arg(1)->Arg(2);
+
+} // namespace
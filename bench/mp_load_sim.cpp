@@ -0,0 +1,1237 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+// Load simulator for the multiplayer coordination server.
+//
+// Drives N synthetic players against MultiplayerServer / EnhancedMultiplayerServer, each
+// joining and then sending heartbeats, position updates, roster and chat polls, chat messages
+// and economy uploads on its own schedule, optionally with a WebSocket event subscription.
+// The player count is stepped up (--players=100,500,1000,...) and every step reports client
+// latency per action, server-side latency per route (scraped from /metrics), server CPU and
+// memory, and WebSocket fan-out lag. See --help.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "multiplayer/MultiplayerServer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+constexpr auto PASSWORD = "loadsim-password";
+
+// ---------------------------------------------------------------------------------------------
+// options
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 3003;
+    int ws_port = 3004;
+    std::vector<size_t> players = {100, 500, 1000, 2000};
+    double step_seconds = 30;
+    double ramp_seconds = 5;
+    size_t workers = 8;
+    bool keep_alive = false; // MultiplayerClient opens a connection per request
+    bool auth = false;
+    double ws_fraction = 0;
+    bool embedded = false;
+    int server_pid = 0;
+    size_t economy_wares = 200;
+    std::string out;
+
+    // seconds between actions per player, 0 disables the action
+    double heartbeat = 30;
+    double update = 5;
+    double roster = 10;
+    double universe = 60;
+    double chat_send = 120;
+    double chat_poll = 10;
+    double economy = 300;
+    double detailed_economy = 60;
+};
+
+void PrintUsage() {
+    std::cout <<
+        R"(x4_mp_loadsim [--option=value ...]
+
+  --host=127.0.0.1 --port=3003     multiplayer server (http)
+  --ws-port=3004                   EnhancedMultiplayerServer websocket port
+  --embedded                       run a MultiplayerServer in this process on --port
+  --server-pid=<pid>               sample cpu/memory of an external server from /proc
+  --players=100,500,1000,2000      player count per step (ascending; players persist)
+  --step-seconds=30                measurement window per step
+  --ramp-seconds=5                 new players join spread over this, not measured
+  --workers=8                      client threads, each with its own connection
+  --keep-alive                     reuse connections (the game client does not)
+  --auth                           register/login every player (enhanced server), enables
+                                   detailed economy uploads and authenticated websockets
+  --ws-fraction=0.1                share of players holding a websocket subscription
+  --economy-wares=200              wares in each economy upload
+  --out=result.json                write results as json
+
+  seconds between actions per player (0 disables):
+  --heartbeat=30 --update=5 --roster=10 --universe=60 --chat-send=120 --chat-poll=10
+  --economy=300 --detailed-economy=60
+)";
+}
+
+std::vector<size_t> ParseList(const char* value) {
+    std::vector<size_t> result;
+    std::string item;
+    for (const char* c = value;; c++) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) {
+                result.push_back(std::stoul(item));
+            }
+            item.clear();
+            if (*c == '\0') {
+                break;
+            }
+        }
+        else {
+            item += *c;
+        }
+    }
+    return result;
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[ i ];
+        const auto value = [ & ](const std::string& flag) -> const char* {
+            return arg.rfind(flag + "=", 0) == 0 ? arg.c_str() + flag.size() + 1 : nullptr;
+        };
+        const auto number = [ & ](const std::string& flag, double& target) {
+            const auto v = value(flag);
+            if (v) {
+                target = std::strtod(v, nullptr);
+            }
+            return v != nullptr;
+        };
+
+        if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return false;
+        }
+        if (arg == "--embedded") {
+            options.embedded = true;
+        }
+        else if (arg == "--keep-alive") {
+            options.keep_alive = true;
+        }
+        else if (arg == "--auth") {
+            options.auth = true;
+        }
+        else if (const auto v = value("--host")) {
+            options.host = v;
+        }
+        else if (const auto v = value("--port")) {
+            options.port = std::atoi(v);
+        }
+        else if (const auto v = value("--ws-port")) {
+            options.ws_port = std::atoi(v);
+        }
+        else if (const auto v = value("--server-pid")) {
+            options.server_pid = std::atoi(v);
+        }
+        else if (const auto v = value("--players")) {
+            options.players = ParseList(v);
+        }
+        else if (const auto v = value("--workers")) {
+            options.workers = std::max<size_t>(1, std::stoul(v));
+        }
+        else if (const auto v = value("--economy-wares")) {
+            options.economy_wares = std::stoul(v);
+        }
+        else if (const auto v = value("--out")) {
+            options.out = v;
+        }
+        else if (number("--step-seconds", options.step_seconds) ||
+                 number("--ramp-seconds", options.ramp_seconds) ||
+                 number("--ws-fraction", options.ws_fraction) ||
+                 number("--heartbeat", options.heartbeat) ||
+                 number("--update", options.update) || number("--roster", options.roster) ||
+                 number("--universe", options.universe) ||
+                 number("--chat-send", options.chat_send) ||
+                 number("--chat-poll", options.chat_poll) ||
+                 number("--economy", options.economy) ||
+                 number("--detailed-economy", options.detailed_economy)) {
+        }
+        else {
+            std::cerr << "unknown argument " << arg << "\n";
+            PrintUsage();
+            return false;
+        }
+    }
+    if (options.players.empty() || !std::is_sorted(options.players.begin(),
+                                       options.players.end())) {
+        std::cerr << "--players must be an ascending list\n";
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// actions
+
+enum class Action : uint8_t {
+    JOIN,
+    LOGIN,
+    HEARTBEAT,
+    UPDATE,
+    ROSTER,
+    UNIVERSE,
+    CHAT_SEND,
+    CHAT_POLL,
+    ECONOMY,
+    DETAILED_ECONOMY,
+    COUNT
+};
+constexpr size_t ACTIONS = static_cast<size_t>(Action::COUNT);
+
+constexpr std::array<const char*, ACTIONS> ACTION_NAMES = {"join", "login", "heartbeat",
+    "update", "roster", "universe", "chat_send", "chat_poll", "economy", "detailed_economy"};
+
+const char* Name(Action action) { return ACTION_NAMES[ static_cast<size_t>(action) ]; }
+
+double Interval(const Options& options, Action action) {
+    switch (action) {
+    case Action::HEARTBEAT:
+        return options.heartbeat;
+    case Action::UPDATE:
+        return options.update;
+    case Action::ROSTER:
+        return options.roster;
+    case Action::UNIVERSE:
+        return options.universe;
+    case Action::CHAT_SEND:
+        return options.chat_send;
+    case Action::CHAT_POLL:
+        return options.chat_poll;
+    case Action::ECONOMY:
+        return options.economy;
+    case Action::DETAILED_ECONOMY:
+        return options.auth ? options.detailed_economy : 0;
+    default:
+        return 0;
+    }
+}
+
+std::string PlayerId(size_t player) { return "loadsim-" + std::to_string(player); }
+
+// "loadsim-<n>" -> n, or -1
+int64_t PlayerIndex(const std::string& id) {
+    if (id.rfind("loadsim-", 0) != 0) {
+        return -1;
+    }
+    return std::strtoll(id.c_str() + 8, nullptr, 10);
+}
+
+double Percentile(std::vector<float>& samples, double q) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const auto index = std::min(samples.size() - 1,
+        static_cast<size_t>(q * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[ index ];
+}
+
+struct Samples {
+    std::array<std::vector<float>, ACTIONS> latency_ms;
+    std::array<uint64_t, ACTIONS> errors{};
+    // how late actions started compared to their schedule; if this grows the simulator,
+    // not the server, is the bottleneck
+    std::vector<float> schedule_lag_ms;
+
+    void merge(Samples& other) {
+        for (size_t i = 0; i < ACTIONS; i++) {
+            latency_ms[ i ].insert(latency_ms[ i ].end(), other.latency_ms[ i ].begin(),
+                other.latency_ms[ i ].end());
+            errors[ i ] += other.errors[ i ];
+        }
+        schedule_lag_ms.insert(schedule_lag_ms.end(), other.schedule_lag_ms.begin(),
+            other.schedule_lag_ms.end());
+    }
+};
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch())
+        .count();
+}
+
+std::chrono::nanoseconds ThreadCpu() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+// state shared by workers, the websocket reader and the step loop
+struct Shared {
+    explicit Shared(const Options& options)
+        : options(options), economy_sent_ns(options.players.back()),
+          tokens(options.players.back()) {}
+
+    const Options& options;
+    std::atomic<size_t> active{0};
+    std::atomic<bool> stop{false};
+    // when each player last sent a detailed economy update, to time websocket fan-out
+    std::vector<std::atomic<int64_t>> economy_sent_ns;
+
+    std::mutex tokens_mutex;
+    std::vector<std::string> tokens;
+};
+
+// ---------------------------------------------------------------------------------------------
+// synthetic players
+
+/**
+ * Owns players `index, index + workers, ...` and runs their actions from a schedule, over a
+ * single httplib client.
+ */
+class Worker {
+public:
+    Worker(Shared& shared, size_t index)
+        : shared_(shared), options_(shared.options), index_(index), rng_(index * 7919 + 1),
+          client_(options_.host, options_.port) {
+        client_.set_keep_alive(options_.keep_alive);
+        client_.set_connection_timeout(5);
+        client_.set_read_timeout(10);
+        thread_ = std::thread([ this ] { run(); });
+    }
+
+    ~Worker() {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    Samples take() {
+        Samples result;
+        const std::lock_guard<std::mutex> lock(samples_mutex_);
+        std::swap(result, samples_);
+        return result;
+    }
+
+    std::chrono::nanoseconds cpu() const { return std::chrono::nanoseconds(cpu_ns_.load()); }
+
+private:
+    struct Due {
+        Clock::time_point at;
+        uint32_t player;
+        Action action;
+
+        bool operator>(const Due& other) const { return at > other.at; }
+    };
+
+    void run() {
+        const auto workers = options_.workers;
+        size_t next_player = index_;
+        while (!shared_.stop) {
+            cpu_ns_ = ThreadCpu().count();
+
+            // newly activated players join spread over the ramp
+            const auto active = shared_.active.load();
+            for (; next_player < active; next_player += workers) {
+                schedule(next_player, Action::JOIN,
+                    Clock::now() + Jitter(options_.ramp_seconds));
+            }
+
+            if (queue_.empty()) {
+                std::this_thread::sleep_for(20ms);
+                continue;
+            }
+            const auto due = queue_.top();
+            const auto now = Clock::now();
+            if (due.at > now) {
+                std::this_thread::sleep_for(std::min<Clock::duration>(due.at - now, 20ms));
+                continue;
+            }
+            queue_.pop();
+            execute(due, now);
+        }
+    }
+
+    Clock::duration Jitter(double seconds) {
+        std::uniform_real_distribution<double> distribution(0, std::max(seconds, 0.001));
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(distribution(rng_)));
+    }
+
+    void schedule(size_t player, Action action, Clock::time_point at) {
+        queue_.push({at, static_cast<uint32_t>(player), action});
+    }
+
+    void execute(const Due& due, Clock::time_point now) {
+        const auto start = Clock::now();
+        const auto ok = perform(due.player, due.action);
+        const auto end = Clock::now();
+        {
+            const std::lock_guard<std::mutex> lock(samples_mutex_);
+            const auto action = static_cast<size_t>(due.action);
+            samples_.latency_ms[ action ].push_back(
+                std::chrono::duration<float, std::milli>(end - start).count());
+            if (!ok) {
+                samples_.errors[ action ]++;
+            }
+            samples_.schedule_lag_ms.push_back(
+                std::chrono::duration<float, std::milli>(now - due.at).count());
+        }
+
+        if (due.action == Action::JOIN) {
+            if (!ok) {
+                schedule(due.player, Action::JOIN, end + 5s);
+                return;
+            }
+            if (options_.auth) {
+                schedule(due.player, Action::LOGIN, end);
+            }
+            // periodic actions start at a random phase so players don't act in lockstep
+            for (size_t i = static_cast<size_t>(Action::HEARTBEAT); i < ACTIONS; i++) {
+                const auto action = static_cast<Action>(i);
+                const auto interval = Interval(options_, action);
+                if (interval > 0) {
+                    schedule(due.player, action, end + Jitter(interval));
+                }
+            }
+            return;
+        }
+        if (due.action == Action::LOGIN) {
+            if (!ok) {
+                schedule(due.player, Action::LOGIN, end + 5s);
+            }
+            return;
+        }
+        const auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(Interval(options_, due.action)));
+        // a late worker catches up instead of bursting
+        schedule(due.player, due.action, std::max(due.at + interval, end));
+    }
+
+    static bool Ok(const httplib::Result& result) {
+        return result && result->status >= 200 && result->status < 300;
+    }
+
+    bool perform(size_t player, Action action) {
+        const auto id = PlayerId(player);
+        switch (action) {
+        case Action::JOIN:
+            return Ok(client_.Post("/mp/join",
+                nlohmann::json{{"playerId", id}, {"playerName", "Pilot " + id},
+                    {"currentSector", sector(player)}, {"position", position()},
+                    {"playerData", playerData(player)}}
+                    .dump(),
+                "application/json"));
+        case Action::LOGIN:
+            return login(player);
+        case Action::HEARTBEAT:
+            return Ok(client_.Post("/mp/heartbeat",
+                nlohmann::json{
+                    {"playerId", id}, {"currentSector", sector(player)}, {"position", position()}}
+                    .dump(),
+                "application/json"));
+        case Action::UPDATE:
+            return Ok(client_.Put("/mp/player/update",
+                nlohmann::json{{"playerId", id}, {"playerName", "Pilot " + id},
+                    {"currentSector", sector(player)}, {"position", position()},
+                    {"playerData", playerData(player)}}
+                    .dump(),
+                "application/json"));
+        case Action::ROSTER:
+            // what a game client polls for: the players around it, not the whole server
+            return Ok(client_.Get("/mp/players?near=" + id));
+        case Action::UNIVERSE:
+            return Ok(client_.Get("/mp/universe"));
+        case Action::CHAT_SEND:
+            return Ok(client_.Post("/mp/chat",
+                nlohmann::json{{"playerId", id}, {"playerName", "Pilot " + id},
+                    {"message", "o7 from " + sector(player)}}
+                    .dump(),
+                "application/json"));
+        case Action::CHAT_POLL:
+            return Ok(client_.Get("/mp/chat?limit=50"));
+        case Action::ECONOMY:
+            return Ok(client_.Put("/mp/economy", economy(), "application/json"));
+        case Action::DETAILED_ECONOMY: {
+            const auto body = detailedEconomy();
+            shared_.economy_sent_ns[ player ] = NowNs();
+            return Ok(client_.Post("/mp/economy/detailed-update", authHeaders(player), body,
+                "application/json"));
+        }
+        default:
+            return false;
+        }
+    }
+
+    bool login(size_t player) {
+        const nlohmann::json credentials = {{"username", PlayerId(player)}, {"password", PASSWORD}};
+        // fails harmlessly when the user exists from an earlier run
+        client_.Post("/auth/register", credentials.dump(), "application/json");
+        const auto result = client_.Post("/auth/login", credentials.dump(), "application/json");
+        if (!Ok(result)) {
+            return false;
+        }
+        const auto token = nlohmann::json::parse(result->body, nullptr, false).value("token", "");
+        const std::lock_guard<std::mutex> lock(shared_.tokens_mutex);
+        shared_.tokens[ player ] = token;
+        return !token.empty();
+    }
+
+    httplib::Headers authHeaders(size_t player) {
+        const std::lock_guard<std::mutex> lock(shared_.tokens_mutex);
+        return {{"Authorization", "Bearer " + shared_.tokens[ player ]}};
+    }
+
+    // players drift between a fixed set of sectors and wander inside them
+    std::string sector(size_t player) {
+        if (std::uniform_int_distribution<int>(0, 99)(rng_) == 0) {
+            sector_offset_++;
+        }
+        return "sector-" + std::to_string((player * 31 + sector_offset_) % 200);
+    }
+
+    nlohmann::json position() {
+        std::uniform_real_distribution<double> coordinate(-250000, 250000);
+        return {{"x", coordinate(rng_)}, {"y", coordinate(rng_) / 50}, {"z", coordinate(rng_)}};
+    }
+
+    nlohmann::json playerData(size_t player) {
+        return {{"credits", std::uniform_int_distribution<int64_t>(0, 2'000'000'000)(rng_)},
+            {"ship", "ship_arg_m_fighter_01_a_macro"}, {"shipName", "Wing of " + PlayerId(player)},
+            {"hull", 1.0}, {"shield", 0.8}, {"faction", "player"}};
+    }
+
+    std::string economy() {
+        std::uniform_real_distribution<double> price(10, 5000);
+        auto wares = nlohmann::json::object();
+        for (size_t i = 0; i < options_.economy_wares; i++) {
+            wares[ "ware_" + std::to_string(i) ] = {
+                {"price", price(rng_)}, {"supply", price(rng_)}, {"demand", price(rng_)}};
+        }
+        return nlohmann::json{{"economyData", {{"wares", std::move(wares)}}},
+            {"universeTime", std::time(nullptr)}}
+            .dump();
+    }
+
+    std::string detailedEconomy() {
+        std::uniform_real_distribution<double> price(10, 5000);
+        auto prices = nlohmann::json::object();
+        for (size_t i = 0; i < std::min<size_t>(options_.economy_wares, 50); i++) {
+            prices[ "ware_" + std::to_string(i) ] = price(rng_);
+        }
+        return nlohmann::json{{"stations", nlohmann::json::array({{{"id", "station-1"}}})},
+            {"prices", std::move(prices)}, {"supply_demand", nlohmann::json::object()}}
+            .dump();
+    }
+
+    Shared& shared_;
+    const Options& options_;
+    size_t index_;
+    std::mt19937_64 rng_;
+    httplib::Client client_;
+    size_t sector_offset_ = 0;
+    std::priority_queue<Due, std::vector<Due>, std::greater<>> queue_;
+
+    std::mutex samples_mutex_;
+    Samples samples_;
+    std::atomic<int64_t> cpu_ns_{0};
+    std::thread thread_;
+};
+
+// ---------------------------------------------------------------------------------------------
+// websocket subscriptions
+
+std::string Base64(const unsigned char* data, size_t size) {
+    static constexpr char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        const uint32_t n = (data[ i ] << 16) | (i + 1 < size ? data[ i + 1 ] << 8 : 0) |
+                           (i + 2 < size ? data[ i + 2 ] : 0);
+        out += alphabet[ (n >> 18) & 63 ];
+        out += alphabet[ (n >> 12) & 63 ];
+        out += i + 1 < size ? alphabet[ (n >> 6) & 63 ] : '=';
+        out += i + 2 < size ? alphabet[ n & 63 ] : '=';
+    }
+    return out;
+}
+
+/**
+ * Minimal RFC 6455 client side for many idle subscriptions: blocking handshake, then one
+ * thread polls every socket and reads unfragmented frames. Enough for websocketpp's event
+ * pushes; not a general purpose client.
+ */
+class WsSubscribers {
+public:
+    struct Stats {
+        size_t connected = 0;
+        size_t failed = 0;
+        size_t closed = 0;
+        uint64_t messages = 0;
+        uint64_t economy_events = 0;
+        std::vector<float> lag_ms;
+    };
+
+    explicit WsSubscribers(Shared& shared) : shared_(shared) {
+        thread_ = std::thread([ this ] { run(); });
+    }
+
+    ~WsSubscribers() {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        for (const auto& connection : connections_) {
+            ::close(connection.fd);
+        }
+    }
+
+    /**
+     * opens a subscription, authenticating with `token` if given
+     */
+    bool connect(const std::string& token) {
+        auto connection = handshake();
+        if (connection.fd < 0) {
+            const std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.failed++;
+            return false;
+        }
+        if (!token.empty()) {
+            SendFrame(connection.fd, 0x1,
+                nlohmann::json{{"type", "auth"}, {"token", token}}.dump());
+        }
+        {
+            const std::lock_guard<std::mutex> lock(pending_mutex_);
+            pending_.push_back({connection.fd, std::move(connection.leftover)});
+        }
+        const std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.connected++;
+        total_++;
+        return true;
+    }
+
+    size_t total() const { return total_; }
+
+    Stats take() {
+        Stats result;
+        const std::lock_guard<std::mutex> lock(stats_mutex_);
+        std::swap(result, stats_);
+        return result;
+    }
+
+    std::chrono::nanoseconds cpu() const { return std::chrono::nanoseconds(cpu_ns_.load()); }
+
+private:
+    struct Connection {
+        int fd;
+        std::string buffer;
+        bool open = true;
+    };
+
+    struct Handshake {
+        int fd = -1;
+        std::string leftover;
+    };
+
+    Handshake handshake() {
+        const auto& options = shared_.options;
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* address = nullptr;
+        if (getaddrinfo(options.host.c_str(), std::to_string(options.ws_port).c_str(), &hints,
+                &address) != 0) {
+            return {};
+        }
+        const int fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        const auto connected = fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+        freeaddrinfo(address);
+        if (!connected) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return {};
+        }
+        timeval timeout{5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        unsigned char key[ 16 ];
+        for (auto& byte : key) {
+            byte = static_cast<unsigned char>(rng_());
+        }
+        const auto request = "GET / HTTP/1.1\r\nHost: " + options.host + ":" +
+                             std::to_string(options.ws_port) +
+                             "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                             "Sec-WebSocket-Key: " +
+                             Base64(key, sizeof(key)) + "\r\nSec-WebSocket-Version: 13\r\n\r\n";
+        std::string response;
+        if (!SendAll(fd, request.data(), request.size())) {
+            ::close(fd);
+            return {};
+        }
+        char buf[ 1024 ];
+        size_t header_end;
+        while ((header_end = response.find("\r\n\r\n")) == std::string::npos) {
+            const auto n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0 || response.size() > 16384) {
+                ::close(fd);
+                return {};
+            }
+            response.append(buf, n);
+        }
+        if (response.rfind("HTTP/1.1 101", 0) != 0) {
+            ::close(fd);
+            return {};
+        }
+        return {fd, response.substr(header_end + 4)};
+    }
+
+    static bool SendAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            const auto n = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    // client frames must be masked
+    void SendFrame(int fd, uint8_t opcode, const std::string& payload) {
+        std::string frame;
+        frame += static_cast<char>(0x80 | opcode);
+        if (payload.size() < 126) {
+            frame += static_cast<char>(0x80 | payload.size());
+        }
+        else {
+            frame += static_cast<char>(0x80 | 126);
+            frame += static_cast<char>((payload.size() >> 8) & 0xff);
+            frame += static_cast<char>(payload.size() & 0xff);
+        }
+        unsigned char mask[ 4 ];
+        {
+            const std::lock_guard<std::mutex> lock(rng_mutex_);
+            for (auto& byte : mask) {
+                byte = static_cast<unsigned char>(rng_());
+            }
+        }
+        frame.append(reinterpret_cast<const char*>(mask), 4);
+        for (size_t i = 0; i < payload.size(); i++) {
+            frame += static_cast<char>(payload[ i ] ^ mask[ i % 4 ]);
+        }
+        SendAll(fd, frame.data(), frame.size());
+    }
+
+    void run() {
+        std::vector<pollfd> fds;
+        char buf[ 65536 ];
+        while (!shared_.stop) {
+            cpu_ns_ = ThreadCpu().count();
+            {
+                const std::lock_guard<std::mutex> lock(pending_mutex_);
+                for (auto& connection : pending_) {
+                    connections_.push_back(std::move(connection));
+                }
+                pending_.clear();
+            }
+            for (auto& connection : connections_) {
+                if (connection.open && !connection.buffer.empty()) {
+                    parse(connection);
+                }
+            }
+
+            fds.clear();
+            for (const auto& connection : connections_) {
+                fds.push_back({connection.open ? connection.fd : -1, POLLIN, 0});
+            }
+            if (fds.empty()) {
+                std::this_thread::sleep_for(50ms);
+                continue;
+            }
+            if (::poll(fds.data(), fds.size(), 100) <= 0) {
+                continue;
+            }
+            for (size_t i = 0; i < fds.size(); i++) {
+                if ((fds[ i ].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+                    continue;
+                }
+                auto& connection = connections_[ i ];
+                const auto n = ::recv(connection.fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (n <= 0) {
+                    markClosed(connection);
+                    continue;
+                }
+                connection.buffer.append(buf, n);
+                parse(connection);
+            }
+        }
+    }
+
+    void markClosed(Connection& connection) {
+        if (connection.open) {
+            connection.open = false;
+            const std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.closed++;
+        }
+    }
+
+    void parse(Connection& connection) {
+        auto& buffer = connection.buffer;
+        while (buffer.size() >= 2) {
+            const auto byte = [ & ](size_t i) { return static_cast<uint8_t>(buffer[ i ]); };
+            const uint8_t opcode = byte(0) & 0x0f;
+            const bool masked = (byte(1) & 0x80) != 0;
+            uint64_t length = byte(1) & 0x7f;
+            size_t offset = 2;
+            if (length == 126) {
+                if (buffer.size() < 4) {
+                    return;
+                }
+                length = (byte(2) << 8) | byte(3);
+                offset = 4;
+            }
+            else if (length == 127) {
+                if (buffer.size() < 10) {
+                    return;
+                }
+                length = 0;
+                for (size_t i = 2; i < 10; i++) {
+                    length = (length << 8) | byte(i);
+                }
+                offset = 10;
+            }
+            const size_t mask_offset = offset;
+            if (masked) {
+                offset += 4;
+            }
+            if (buffer.size() < offset + length) {
+                return;
+            }
+            std::string payload = buffer.substr(offset, length);
+            if (masked) {
+                for (size_t i = 0; i < payload.size(); i++) {
+                    payload[ i ] ^= buffer[ mask_offset + i % 4 ];
+                }
+            }
+            buffer.erase(0, offset + length);
+
+            switch (opcode) {
+            case 0x1:
+                onText(payload);
+                break;
+            case 0x8:
+                SendFrame(connection.fd, 0x8, payload.substr(0, 2));
+                markClosed(connection);
+                return;
+            case 0x9:
+                SendFrame(connection.fd, 0xA, payload);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    void onText(const std::string& payload) {
+        const auto received = NowNs();
+        const auto message = nlohmann::json::parse(payload, nullptr, false);
+        const std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.messages++;
+        if (!message.is_object() || message.value("eventType", "") != "economy_update") {
+            return;
+        }
+        stats_.economy_events++;
+        const auto& data = message[ "data" ];
+        const auto player = data.is_object() ? PlayerIndex(data.value("playerId", "")) : -1;
+        if (player >= 0 && static_cast<size_t>(player) < shared_.economy_sent_ns.size()) {
+            // players upload far less often than the server fans out, so the last send is
+            // the one this event came from
+            const auto sent = shared_.economy_sent_ns[ player ].load();
+            if (sent > 0) {
+                stats_.lag_ms.push_back(static_cast<float>(received - sent) / 1e6f);
+            }
+        }
+    }
+
+    Shared& shared_;
+    std::mutex rng_mutex_;
+    std::mt19937 rng_{12345};
+
+    std::mutex pending_mutex_;
+    std::vector<Connection> pending_;
+    std::vector<Connection> connections_; // reader thread only
+
+    std::mutex stats_mutex_;
+    Stats stats_;
+    size_t total_ = 0;
+    std::atomic<int64_t> cpu_ns_{0};
+    std::thread thread_;
+};
+
+// ---------------------------------------------------------------------------------------------
+// server side
+
+// cumulative bucket counts per "METHOD /route", in le order
+using ServerHistograms = std::map<std::string, std::vector<std::pair<double, uint64_t>>>;
+
+std::string LabelValue(const std::string& line, const std::string& label) {
+    const auto start = line.find(label + "=\"");
+    if (start == std::string::npos) {
+        return "";
+    }
+    const auto value = start + label.size() + 2;
+    return line.substr(value, line.find('"', value) - value);
+}
+
+struct ServerScrape {
+    ServerHistograms durations;
+    double active_players = -1;
+};
+
+ServerScrape Scrape(httplib::Client& client) {
+    ServerScrape scrape;
+    const auto result = client.Get("/metrics");
+    if (!result || result->status != 200) {
+        return scrape;
+    }
+    std::istringstream lines(result->body);
+    std::string line;
+    constexpr std::string_view BUCKET = "x4mp_http_request_duration_seconds_bucket{";
+    while (std::getline(lines, line)) {
+        if (line.rfind("x4mp_active_players", 0) == 0) {
+            scrape.active_players = std::strtod(line.c_str() + line.rfind(' '), nullptr);
+        }
+        if (line.rfind(BUCKET, 0) != 0) {
+            continue;
+        }
+        const auto key = LabelValue(line, "method") + " " + LabelValue(line, "route");
+        const auto le = std::strtod(LabelValue(line, "le").c_str(), nullptr);
+        const auto count = std::strtoull(line.c_str() + line.rfind(' ') + 1, nullptr, 10);
+        scrape.durations[ key ].emplace_back(le, count);
+    }
+    return scrape;
+}
+
+struct RouteLatency {
+    uint64_t count = 0;
+    double p50_ms = 0;
+    double p99_ms = 0;
+};
+
+// bucket upper bounds, so these are "at most" values with power of two resolution
+std::map<std::string, RouteLatency> Diff(const ServerHistograms& before,
+    const ServerHistograms& after) {
+    std::map<std::string, RouteLatency> result;
+    for (const auto& [ route, buckets ] : after) {
+        const auto previous = before.find(route);
+        std::vector<std::pair<double, uint64_t>> delta;
+        for (size_t i = 0; i < buckets.size(); i++) {
+            const auto base = previous != before.end() && i < previous->second.size()
+                                  ? previous->second[ i ].second
+                                  : 0;
+            delta.emplace_back(buckets[ i ].first, buckets[ i ].second - base);
+        }
+        if (delta.empty() || delta.back().second == 0) {
+            continue;
+        }
+        RouteLatency latency;
+        latency.count = delta.back().second;
+        const auto quantile = [ & ](double q) {
+            for (const auto& [ le, cumulative ] : delta) {
+                if (static_cast<double>(cumulative) >= q * static_cast<double>(latency.count)) {
+                    return le * 1000;
+                }
+            }
+            return delta.back().first * 1000;
+        };
+        latency.p50_ms = quantile(0.5);
+        latency.p99_ms = quantile(0.99);
+        result[ route ] = latency;
+    }
+    return result;
+}
+
+struct ProcessStats {
+    double cpu_seconds = 0;
+    double rss_mb = 0;
+};
+
+ProcessStats ReadProcess(int pid) {
+    ProcessStats stats;
+    const auto base = "/proc/" + std::to_string(pid);
+    std::ifstream stat_file(base + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(stat_file)), {});
+    // fields after the parenthesised command name; utime and stime are 14 and 15
+    const auto rest = stat.rfind(')');
+    if (rest != std::string::npos) {
+        std::istringstream fields(stat.substr(rest + 2));
+        std::string field;
+        uint64_t ticks = 0;
+        for (int i = 3; i <= 15 && fields >> field; i++) {
+            if (i >= 14) {
+                ticks += std::stoull(field);
+            }
+        }
+        stats.cpu_seconds = static_cast<double>(ticks) / static_cast<double>(sysconf(_SC_CLK_TCK));
+    }
+    std::ifstream status(base + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            stats.rss_mb = std::strtod(line.c_str() + 6, nullptr) / 1024;
+        }
+    }
+    return stats;
+}
+
+nlohmann::json OptionsJson(const Options& options) {
+    return {{"host", options.host}, {"port", options.port}, {"wsPort", options.ws_port},
+        {"players", options.players}, {"stepSeconds", options.step_seconds},
+        {"rampSeconds", options.ramp_seconds}, {"workers", options.workers},
+        {"keepAlive", options.keep_alive}, {"auth", options.auth},
+        {"wsFraction", options.ws_fraction}, {"embedded", options.embedded},
+        {"economyWares", options.economy_wares},
+        {"intervals",
+            {{"heartbeat", options.heartbeat}, {"update", options.update},
+                {"roster", options.roster}, {"universe", options.universe},
+                {"chatSend", options.chat_send}, {"chatPoll", options.chat_poll},
+                {"economy", options.economy}, {"detailedEconomy", options.detailed_economy}}}};
+}
+
+void SleepFor(const Shared& shared, double seconds) {
+    const auto until = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                          std::chrono::duration<double>(seconds));
+    while (!shared.stop && Clock::now() < until) {
+        std::this_thread::sleep_for(50ms);
+    }
+}
+
+std::atomic<bool>* g_stop = nullptr;
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    if (options.embedded) {
+        // leaked: stopping waits out the heartbeat worker's sleep
+        auto* server = new MultiplayerServer(options.port);
+        server->start();
+        options.server_pid = getpid();
+    }
+
+    httplib::Client probe(options.host, options.port);
+    probe.set_connection_timeout(2);
+    for (int i = 0; i < 100 && !probe.Get("/mp/info"); i++) {
+        std::this_thread::sleep_for(100ms);
+    }
+    if (!probe.Get("/mp/info")) {
+        std::cerr << "no multiplayer server at " << options.host << ":" << options.port << "\n";
+        return 1;
+    }
+    if (options.auth) {
+        const auto validate = probe.Get("/auth/validate");
+        if (!validate || validate->status == 404) {
+            std::cerr << "server has no /auth endpoints (not an EnhancedMultiplayerServer), "
+                         "running without --auth\n";
+            options.auth = false;
+        }
+    }
+
+    Shared shared(options);
+    g_stop = &shared.stop;
+    std::signal(SIGINT, [](int) { g_stop->store(true); });
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t i = 0; i < options.workers; i++) {
+        workers.push_back(std::make_unique<Worker>(shared, i));
+    }
+    std::unique_ptr<WsSubscribers> subscribers;
+    if (options.ws_fraction > 0) {
+        subscribers = std::make_unique<WsSubscribers>(shared);
+    }
+
+    const auto simulator_cpu = [ & ] {
+        auto total = std::chrono::nanoseconds(0);
+        for (const auto& worker : workers) {
+            total += worker->cpu();
+        }
+        if (subscribers) {
+            total += subscribers->cpu();
+        }
+        return std::chrono::duration<double>(total).count();
+    };
+
+    std::printf("%8s %6s %9s %8s %9s %9s %9s %8s %10s\n", "players", "ws", "req/s", "errors",
+        "p50 ms", "p99 ms", "cpu %", "rss MB", "sched p99");
+    auto steps = nlohmann::json::array();
+
+    for (const auto players : options.players) {
+        if (shared.stop) {
+            break;
+        }
+        shared.active = players;
+        SleepFor(shared, options.ramp_seconds + 1);
+
+        if (subscribers) {
+            const auto wanted = static_cast<size_t>(options.ws_fraction * players);
+            for (size_t i = subscribers->total(); i < wanted && !shared.stop; i++) {
+                std::string token;
+                {
+                    const std::lock_guard<std::mutex> lock(shared.tokens_mutex);
+                    token = shared.tokens[ i ];
+                }
+                subscribers->connect(token);
+            }
+            subscribers->take();
+        }
+
+        // the ramp is not measured
+        for (const auto& worker : workers) {
+            worker->take();
+        }
+        const auto scrape_before = Scrape(probe);
+        const auto process_before =
+            options.server_pid > 0 ? ReadProcess(options.server_pid) : ProcessStats{};
+        const auto simulator_before = simulator_cpu();
+        const auto start = Clock::now();
+
+        SleepFor(shared, options.step_seconds);
+
+        const auto wall = std::chrono::duration<double>(Clock::now() - start).count();
+        Samples samples;
+        for (const auto& worker : workers) {
+            auto taken = worker->take();
+            samples.merge(taken);
+        }
+        const auto scrape_after = Scrape(probe);
+        const auto process_after =
+            options.server_pid > 0 ? ReadProcess(options.server_pid) : ProcessStats{};
+        auto server_cpu = process_after.cpu_seconds - process_before.cpu_seconds;
+        if (options.embedded) {
+            // same process: take out the simulator's own threads
+            server_cpu -= simulator_cpu() - simulator_before;
+        }
+        auto ws_stats = subscribers ? subscribers->take() : WsSubscribers::Stats{};
+
+        nlohmann::json actions = nlohmann::json::object();
+        std::vector<float> all;
+        uint64_t errors = 0;
+        for (size_t i = 0; i < ACTIONS; i++) {
+            auto& latency = samples.latency_ms[ i ];
+            if (latency.empty()) {
+                continue;
+            }
+            all.insert(all.end(), latency.begin(), latency.end());
+            errors += samples.errors[ i ];
+            actions[ ACTION_NAMES[ i ] ] = {{"count", latency.size()},
+                {"errors", samples.errors[ i ]}, {"p50Ms", Percentile(latency, 0.5)},
+                {"p99Ms", Percentile(latency, 0.99)},
+                {"maxMs", *std::max_element(latency.begin(), latency.end())}};
+        }
+
+        nlohmann::json server = nlohmann::json::object();
+        for (const auto& [ route, latency ] :
+            Diff(scrape_before.durations, scrape_after.durations)) {
+            server[ route ] = {
+                {"count", latency.count}, {"p50Ms", latency.p50_ms}, {"p99Ms", latency.p99_ms}};
+        }
+
+        const auto requests_per_second = static_cast<double>(all.size()) / wall;
+        const auto cpu_percent = options.server_pid > 0 ? server_cpu / wall * 100 : -1;
+        nlohmann::json step = {{"players", players}, {"seconds", wall},
+            {"requests", all.size()}, {"requestsPerSecond", requests_per_second},
+            {"errors", errors}, {"p50Ms", Percentile(all, 0.5)}, {"p99Ms", Percentile(all, 0.99)},
+            {"scheduleLagP99Ms", Percentile(samples.schedule_lag_ms, 0.99)},
+            {"actions", std::move(actions)}, {"server", std::move(server)}};
+        if (scrape_after.active_players >= 0) {
+            step[ "serverActivePlayers" ] = scrape_after.active_players;
+        }
+        if (options.server_pid > 0) {
+            step[ "serverCpuPercent" ] = cpu_percent;
+            step[ "serverRssMb" ] = process_after.rss_mb;
+        }
+        if (subscribers) {
+            step[ "websocket" ] = {{"subscribers", subscribers->total()},
+                {"failed", ws_stats.failed}, {"closed", ws_stats.closed},
+                {"messagesPerSecond", static_cast<double>(ws_stats.messages) / wall},
+                {"economyEvents", ws_stats.economy_events},
+                {"lagP50Ms", Percentile(ws_stats.lag_ms, 0.5)},
+                {"lagP99Ms", Percentile(ws_stats.lag_ms, 0.99)}};
+        }
+
+        std::printf("%8zu %6zu %9.1f %8llu %9.2f %9.2f %9.1f %8.1f %10.2f\n", players,
+            subscribers ? subscribers->total() : 0, requests_per_second,
+            static_cast<unsigned long long>(errors), step[ "p50Ms" ].get<double>(),
+            step[ "p99Ms" ].get<double>(), cpu_percent, process_after.rss_mb,
+            step[ "scheduleLagP99Ms" ].get<double>());
+        for (const auto& [ name, action ] : step[ "actions" ].items()) {
+            std::printf("         %-18s %8llu calls %6llu err  p50 %8.2f  p99 %8.2f  max %8.2f ms\n",
+                name.c_str(), action[ "count" ].get<unsigned long long>(),
+                action[ "errors" ].get<unsigned long long>(), action[ "p50Ms" ].get<double>(),
+                action[ "p99Ms" ].get<double>(), action[ "maxMs" ].get<double>());
+        }
+        if (subscribers) {
+            const auto& ws = step[ "websocket" ];
+            std::printf("         %-18s %8.1f msg/s %6zu fail  lag p50 %8.2f  p99 %8.2f ms\n",
+                "websocket", ws[ "messagesPerSecond" ].get<double>(), ws_stats.failed,
+                ws[ "lagP50Ms" ].get<double>(), ws[ "lagP99Ms" ].get<double>());
+        }
+        std::fflush(stdout);
+        steps.push_back(std::move(step));
+    }
+
+    if (!options.out.empty()) {
+        std::ofstream(options.out)
+            << nlohmann::json{{"options", OptionsJson(options)}, {"steps", std::move(steps)}}
+                   .dump(2)
+            << "\n";
+    }
+
+    shared.stop = true;
+    workers.clear();
+    subscribers.reset();
+    std::fflush(stdout);
+    // an embedded server is still running; don't tear down statics under it
+    std::quick_exit(0);
+}
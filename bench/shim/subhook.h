@@ -0,0 +1,29 @@
+/*
+Copyright 2021-2023 Peter Repukat - FlatspotSoftware
+
+Use of this source code is governed by the MIT
+license that can be found in the LICENSE file or at
+https://opensource.org/licenses/MIT.
+*/
+
+#pragma once
+
+// Stand-in for subhook in benchmarks: _lua_.h declares its hooks globally, but nothing is
+// ever installed outside the game, and the hook functions are called directly.
+namespace subhook {
+
+enum class HookFlags { HookFlag64BitOffset = 1 };
+
+class Hook {
+public:
+    bool Install(void*, void*, HookFlags = HookFlags::HookFlag64BitOffset) { return true; }
+    bool Install() { return true; }
+    bool Remove() { return true; }
+};
+
+class ScopedHookRemove {
+public:
+    explicit ScopedHookRemove(Hook*) {}
+};
+
+} // namespace subhook
@@ -0,0 +1,411 @@
+#!/usr/bin/env python3
+"""
+X4 REST Server load generator
+
+Replays a request collection (the HAR, Insomnia or Postman export shipped with this repo)
+against a running server and reports throughput, latency percentiles and error rates per
+route. Only the python standard library is needed.
+
+Examples:
+    # 60s against the game, 8 connections, reads only
+    python load_test.py Request_collection.har --duration 60 --concurrency 8
+
+    # fixed rate of 200 req/s, messages weighted 5x
+    python load_test.py X4_Rest_Reloaded.postman_collection.json --rate 200 \\
+        --weight "/GetMessages=5" --json results.json
+
+    # capacity test without the game: built-in stub backend that behaves like the
+    # plugin (one lua call at a time, each waiting for the next frame)
+    python load_test.py Request_collection_insomnia.json --stub --concurrency 32
+
+Non-GET requests are skipped unless --allow-writes is given, since they change game state.
+"""
+
+import argparse
+import http.client
+import json
+import random
+import re
+import sys
+import threading
+import time
+from collections import defaultdict
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlencode, urlsplit
+
+TEMPLATE_VARIABLE = re.compile(r"\{\{\s*(?:_\.)?(\w+)\s*\}\}")
+
+
+class Request:
+    def __init__(self, method, path, body=None, headers=None):
+        self.method = method.upper()
+        self.path = path
+        self.body = body or None
+        self.headers = headers or {}
+        self.weight = 1.0
+
+    @property
+    def route(self):
+        return f"{self.method} {self.path.split('?', 1)[0]}"
+
+
+def _path_of(url, variables):
+    """strips scheme and host so requests can be sent to --base-url"""
+    url = TEMPLATE_VARIABLE.sub(lambda m: variables.get(m.group(1), ""), url)
+    if "://" not in url:
+        url = "http://placeholder" + (url if url.startswith("/") else "/" + url)
+    parts = urlsplit(url)
+    path = parts.path or "/"
+    return path + ("?" + parts.query if parts.query else "")
+
+
+def _with_query(path, params):
+    params = [(p["name"], p.get("value", "")) for p in params if not p.get("disabled")]
+    if not params:
+        return path
+    return path + ("&" if "?" in path else "?") + urlencode(params)
+
+
+def _headers(headers):
+    return {h["name" if "name" in h else "key"]: h.get("value", "")
+            for h in headers if not h.get("disabled")}
+
+
+def load_har(data, variables):
+    requests = []
+    for entry in data["log"]["entries"]:
+        r = entry["request"]
+        path = _path_of(r["url"], variables)
+        if "?" not in path:
+            path = _with_query(path, r.get("queryString", []))
+        body = (r.get("postData") or {}).get("text")
+        requests.append(Request(r["method"], path, body, _headers(r.get("headers", []))))
+    return requests
+
+
+def load_insomnia(data, variables):
+    requests = []
+    for r in data["resources"]:
+        if r.get("_type") != "request":
+            continue
+        path = _with_query(_path_of(r["url"], variables), r.get("parameters", []))
+        body = (r.get("body") or {}).get("text")
+        requests.append(Request(r["method"], path, body, _headers(r.get("headers", []))))
+    return requests
+
+
+def load_postman(data, variables):
+    variables = dict(variables)
+    for v in data.get("variable", []):
+        variables.setdefault(v["key"], v.get("value", ""))
+
+    requests = []
+
+    def walk(items):
+        for item in items:
+            if "item" in item:  # folder
+                walk(item["item"])
+                continue
+            r = item["request"]
+            url = r["url"]
+            if isinstance(url, dict):
+                path = _path_of(url.get("raw", ""), variables)
+                if "?" not in path:
+                    query = [{"name": q["key"], **q} for q in url.get("query", [])]
+                    path = _with_query(path, query)
+            else:
+                path = _path_of(url, variables)
+            body = (r.get("body") or {}).get("raw")
+            requests.append(Request(r["method"], path, body, _headers(r.get("header", []))))
+
+    walk(data["item"])
+    return requests
+
+
+def load_collection(filename, variables):
+    with open(filename, encoding="utf-8") as f:
+        data = json.load(f)
+    if "log" in data:
+        return load_har(data, variables)
+    if data.get("_type") == "export" or "resources" in data:
+        return load_insomnia(data, variables)
+    if "item" in data:
+        return load_postman(data, variables)
+    raise ValueError(f"{filename}: not a HAR, Insomnia or Postman collection")
+
+
+class RateLimiter:
+    """shared token bucket; rate 0 = unlimited (closed loop)"""
+
+    def __init__(self, rate):
+        self.interval = 1.0 / rate if rate > 0 else 0
+        self.lock = threading.Lock()
+        self.next = time.perf_counter()
+
+    def wait(self):
+        if self.interval == 0:
+            return
+        with self.lock:
+            now = time.perf_counter()
+            self.next = max(self.next + self.interval, now)
+            delay = self.next - now
+        if delay > 0:
+            time.sleep(delay)
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = defaultdict(list)
+        self.errors = defaultdict(int)
+        self.statuses = defaultdict(lambda: defaultdict(int))
+        self.bytes = defaultdict(int)
+
+    def record(self, route, latency, status, size, error):
+        with self.lock:
+            self.latencies[route].append(latency)
+            self.statuses[route][status] += 1
+            self.bytes[route] += size
+            if error:
+                self.errors[route] += 1
+
+
+def percentile(sorted_values, q):
+    if not sorted_values:
+        return 0.0
+    rank = max(0, min(len(sorted_values) - 1, int(round(q * len(sorted_values) + 0.5)) - 1))
+    return sorted_values[rank]
+
+
+def worker(host, port, requests, weights, limiter, stats, stop_at, warmup_until, budget,
+           timeout):
+    connection = http.client.HTTPConnection(host, port, timeout=timeout)
+    rnd = random.Random()
+    while time.perf_counter() < stop_at:
+        if budget is not None:
+            with budget["lock"]:
+                if budget["left"] <= 0:
+                    break
+                budget["left"] -= 1
+        request = rnd.choices(requests, weights)[0]
+        limiter.wait()
+        start = time.perf_counter()
+        status, size, error = 0, 0, False
+        try:
+            connection.request(request.method, request.path,
+                               body=request.body.encode() if request.body else None,
+                               headers=request.headers)
+            response = connection.getresponse()
+            size = len(response.read())
+            status = response.status
+            error = status >= 400
+        except (OSError, http.client.HTTPException):
+            error = True
+            connection.close()
+            connection = http.client.HTTPConnection(host, port, timeout=timeout)
+        latency = time.perf_counter() - start
+        if start >= warmup_until:
+            stats.record(request.route, latency, status, size, error)
+    connection.close()
+
+
+def report(stats, elapsed):
+    routes = []
+    all_latencies = []
+    total_errors = 0
+    for route, latencies in sorted(stats.latencies.items()):
+        latencies.sort()
+        all_latencies.extend(latencies)
+        total_errors += stats.errors[route]
+        routes.append({
+            "route": route,
+            "requests": len(latencies),
+            "errors": stats.errors[route],
+            "errorRate": stats.errors[route] / len(latencies),
+            "throughput": len(latencies) / elapsed,
+            "bytes": stats.bytes[route],
+            "statuses": {str(k): v for k, v in sorted(stats.statuses[route].items())},
+            "latencyMs": {
+                "mean": sum(latencies) / len(latencies) * 1000,
+                "p50": percentile(latencies, 0.50) * 1000,
+                "p90": percentile(latencies, 0.90) * 1000,
+                "p99": percentile(latencies, 0.99) * 1000,
+                "max": latencies[-1] * 1000,
+            },
+        })
+    all_latencies.sort()
+    total = len(all_latencies)
+    return {
+        "durationSeconds": elapsed,
+        "requests": total,
+        "errors": total_errors,
+        "errorRate": total_errors / total if total else 0,
+        "throughput": total / elapsed if elapsed > 0 else 0,
+        "latencyMs": {
+            "p50": percentile(all_latencies, 0.50) * 1000,
+            "p90": percentile(all_latencies, 0.90) * 1000,
+            "p99": percentile(all_latencies, 0.99) * 1000,
+            "max": (all_latencies[-1] if all_latencies else 0) * 1000,
+        },
+        "routes": routes,
+    }
+
+
+def print_report(result):
+    print(f"\n{'route':<48} {'req':>7} {'err%':>6} {'req/s':>8} "
+          f"{'p50ms':>8} {'p90ms':>8} {'p99ms':>8} {'maxms':>8}")
+    for r in result["routes"]:
+        lat = r["latencyMs"]
+        print(f"{r['route'][:48]:<48} {r['requests']:>7} {r['errorRate'] * 100:>6.1f} "
+              f"{r['throughput']:>8.1f} {lat['p50']:>8.1f} {lat['p90']:>8.1f} "
+              f"{lat['p99']:>8.1f} {lat['max']:>8.1f}")
+    lat = result["latencyMs"]
+    print(f"\ntotal: {result['requests']} requests in {result['durationSeconds']:.1f}s, "
+          f"{result['throughput']:.1f} req/s, {result['errorRate'] * 100:.2f}% errors, "
+          f"p50 {lat['p50']:.1f}ms p90 {lat['p90']:.1f}ms p99 {lat['p99']:.1f}ms")
+
+
+def start_stub(port, frame_ms, execute_ms):
+    """
+    stand-in for the game: every request takes the (single) lua lock, waits for the next
+    frame and "executes" for execute_ms, like executeLua does
+    """
+    lua_lock = threading.Lock()
+    epoch = time.perf_counter()
+    frame = frame_ms / 1000.0
+
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def _handle(self):
+            length = int(self.headers.get("Content-Length") or 0)
+            if length:
+                self.rfile.read(length)
+            with lua_lock:
+                if frame > 0:
+                    now = time.perf_counter() - epoch
+                    time.sleep(frame - (now % frame))
+                if execute_ms > 0:
+                    time.sleep(execute_ms / 1000.0)
+            body = json.dumps({"stub": True, "path": self.path}).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        do_GET = do_POST = do_PUT = do_PATCH = do_DELETE = _handle
+
+        def log_message(self, *args):
+            pass
+
+    server = ThreadingHTTPServer(("127.0.0.1", port), Handler)
+    server.daemon_threads = True
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def parse_weights(specs):
+    weights = []
+    for spec in specs:
+        pattern, _, weight = spec.rpartition("=")
+        if not pattern:
+            raise argparse.ArgumentTypeError(f"--weight expects <regex>=<weight>, got {spec}")
+        weights.append((re.compile(pattern), float(weight)))
+    return weights
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Replay a HAR/Insomnia/Postman collection as load against the X4 REST server",
+        formatter_class=argparse.RawDescriptionHelpFormatter, epilog=__doc__)
+    parser.add_argument("collection", help="HAR, Insomnia or Postman export")
+    parser.add_argument("--base-url", default="http://localhost:3002")
+    parser.add_argument("--concurrency", type=int, default=4, help="parallel connections")
+    parser.add_argument("--rate", type=float, default=0,
+                        help="total requests per second, 0 = as fast as responses come back")
+    parser.add_argument("--duration", type=float, default=30, help="seconds")
+    parser.add_argument("--requests", type=int, default=None, help="stop after this many")
+    parser.add_argument("--warmup", type=float, default=0, help="seconds excluded from stats")
+    parser.add_argument("--timeout", type=float, default=10)
+    parser.add_argument("--include", action="append", default=[],
+                        help="only routes matching this regex (repeatable)")
+    parser.add_argument("--exclude", action="append", default=[],
+                        help="skip routes matching this regex (repeatable)")
+    parser.add_argument("--weight", action="append", default=[],
+                        help="<regex>=<weight>, relative share of matching routes (default 1)")
+    parser.add_argument("--allow-writes", action="store_true",
+                        help="also replay POST/PUT/PATCH/DELETE requests")
+    parser.add_argument("--var", action="append", default=[],
+                        help="<name>=<value> for {{ _.name }} placeholders in the collection")
+    parser.add_argument("--json", help="write the report to this file")
+    parser.add_argument("--stub", action="store_true",
+                        help="run against a built-in stub backend instead of the game")
+    parser.add_argument("--stub-port", type=int, default=3099)
+    parser.add_argument("--stub-frame-ms", type=float, default=16.7)
+    parser.add_argument("--stub-execute-ms", type=float, default=0.5)
+    args = parser.parse_args()
+
+    if args.stub:
+        start_stub(args.stub_port, args.stub_frame_ms, args.stub_execute_ms)
+        args.base_url = f"http://127.0.0.1:{args.stub_port}"
+
+    variables = {"baseUrl": args.base_url}
+    variables.update(v.split("=", 1) for v in args.var)
+
+    requests = load_collection(args.collection, variables)
+    includes = [re.compile(p) for p in args.include]
+    excludes = [re.compile(p) for p in args.exclude]
+    requests = [r for r in requests
+                if (args.allow_writes or r.method == "GET")
+                and (not includes or any(p.search(r.route) for p in includes))
+                and not any(p.search(r.route) for p in excludes)]
+    if not requests:
+        sys.exit("no requests left to replay (see --include/--exclude/--allow-writes)")
+
+    weight_rules = parse_weights(args.weight)
+    for r in requests:
+        for pattern, weight in weight_rules:
+            if pattern.search(r.route):
+                r.weight = weight
+    weights = [r.weight for r in requests]
+
+    target = urlsplit(args.base_url)
+    print(f"replaying {len(requests)} requests from {args.collection} against {args.base_url} "
+          f"({args.concurrency} connections, "
+          f"{'%g req/s' % args.rate if args.rate else 'closed loop'}, {args.duration:g}s)")
+
+    stats = Stats()
+    limiter = RateLimiter(args.rate)
+    budget = {"left": args.requests, "lock": threading.Lock()} if args.requests else None
+    start = time.perf_counter()
+    warmup_until = start + args.warmup
+    stop_at = start + args.warmup + args.duration
+    threads = [threading.Thread(target=worker, daemon=True,
+                                args=(target.hostname, target.port or 80, requests, weights,
+                                      limiter, stats, stop_at, warmup_until, budget, args.timeout))
+               for _ in range(args.concurrency)]
+    for t in threads:
+        t.start()
+    try:
+        for t in threads:
+            t.join()
+    except KeyboardInterrupt:
+        print("interrupted, reporting what was collected")
+    elapsed = time.perf_counter() - max(start, warmup_until)
+
+    result = report(stats, elapsed)
+    result["config"] = {
+        "collection": args.collection, "baseUrl": args.base_url,
+        "concurrency": args.concurrency, "rate": args.rate, "duration": args.duration,
+        "warmup": args.warmup, "stub": args.stub,
+    }
+    print_report(result)
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as f:
+            json.dump(result, f, indent=2)
+    sys.exit(1 if result["requests"] == 0 else 0)
+
+
+if __name__ == "__main__":
+    main()